@@ -0,0 +1,89 @@
+#pragma once
+#include <boost/asio/buffer.hpp>
+#include <boost/container/small_vector.hpp>
+#include <algorithm>
+
+namespace core
+{
+    // flat const_buffer sequence with prefix sums of buffer sizes, locating the buffer
+    // holding a byte offset is a binary search rather than a walk over list nodes
+    class buffer_vector final
+    {
+    public:
+        static constexpr inline size_t inline_capacity = 8;
+
+        using value_type = boost::asio::const_buffer;
+        using container_type = boost::container::small_vector<value_type, inline_capacity>;
+        using const_iterator = container_type::const_iterator;
+
+    private:
+        container_type buffers_;
+        // offsets_[i] is where buffers_[i] begins, back element is total size
+        boost::container::small_vector<int64_t, inline_capacity + 1> offsets_;
+
+    public:
+        buffer_vector() {
+            offsets_.push_back(0);
+        }
+
+        // empty buffers are skipped so each offset belongs to exactly one buffer
+        void push_back(value_type buffer) {
+            if (buffer.size() == 0) {
+                return;
+            }
+            buffers_.push_back(buffer);
+            offsets_.push_back(offsets_.back() + static_cast<int64_t>(buffer.size()));
+        }
+
+        template <typename ConstBufferSequence>
+        void append(const ConstBufferSequence& sequence) {
+            std::for_each(boost::asio::buffer_sequence_begin(sequence),
+                          boost::asio::buffer_sequence_end(sequence),
+                          [this](const auto& buffer) {
+                              push_back(value_type{ buffer });
+                          });
+        }
+
+        void reserve(size_t count) {
+            buffers_.reserve(count);
+            offsets_.reserve(count + 1);
+        }
+
+        // index of buffer holding byte offset, size() once offset reaches total size
+        size_t locate(int64_t offset) const {
+            if (offset < 0) {
+                return 0;
+            }
+            const auto iterator = std::upper_bound(offsets_.begin(), offsets_.end(), offset);
+            return static_cast<size_t>(std::distance(offsets_.begin(), iterator)) - 1;
+        }
+
+        int64_t offset(size_t index) const {
+            return offsets_.at(index);
+        }
+
+        int64_t total_size() const noexcept {
+            return offsets_.back();
+        }
+
+        const value_type& operator[](size_t index) const {
+            return buffers_[index];
+        }
+
+        size_t size() const noexcept {
+            return buffers_.size();
+        }
+
+        bool empty() const noexcept {
+            return buffers_.empty();
+        }
+
+        const_iterator begin() const noexcept {
+            return buffers_.begin();
+        }
+
+        const_iterator end() const noexcept {
+            return buffers_.end();
+        }
+    };
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include <folly/Function.h>
+#include <boost/asio/buffer.hpp>
+#include <boost/beast/core/multi_buffer.hpp>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <optional>
+
+namespace core
+{
+    // growing byte sequence, network thread appends body chunks while reader consumes
+    // from front, reader blocks until more data arrives or producer closes the stream
+    class chunk_stream final
+    {
+        mutable std::mutex mutex_;
+        std::condition_variable readable_condition_;
+        boost::beast::multi_buffer buffer_;
+        folly::Function<void()> notify_;
+        std::optional<int64_t> content_size_;
+        int64_t append_size_ = 0;
+        bool closed_ = false;
+        std::exception_ptr exception_;
+
+    public:
+        explicit chunk_stream(std::optional<int64_t> content_size = std::nullopt)
+            : content_size_{ content_size } {}
+
+        chunk_stream(const chunk_stream&) = delete;
+        chunk_stream(chunk_stream&&) = delete;
+        chunk_stream& operator=(const chunk_stream&) = delete;
+        chunk_stream& operator=(chunk_stream&&) = delete;
+        ~chunk_stream() = default;
+
+        void append(boost::asio::const_buffer chunk) {
+            if (chunk.size() == 0) {
+                return;
+            }
+            std::lock_guard<std::mutex> lock{ mutex_ };
+            const auto copy_size = boost::asio::buffer_copy(buffer_.prepare(chunk.size()), chunk);
+            buffer_.commit(copy_size);
+            append_size_ += copy_size;
+            readable_condition_.notify_all();
+            if (notify_) {
+                notify_();
+            }
+        }
+
+        // exception is rethrown to reader once buffered data is drained
+        void close(std::exception_ptr exception = nullptr) {
+            std::lock_guard<std::mutex> lock{ mutex_ };
+            if (std::exchange(closed_, true)) {
+                return;
+            }
+            exception_ = exception;
+            readable_condition_.notify_all();
+            if (notify_) {
+                notify_();
+            }
+        }
+
+        // blocks until any data readable, returns 0 once closed and drained
+        size_t read(boost::asio::mutable_buffer buffer) {
+            std::unique_lock<std::mutex> lock{ mutex_ };
+            readable_condition_.wait(lock, [this] {
+                return buffer_.size() > 0 || closed_;
+            });
+            if (buffer_.size() == 0 && exception_) {
+                std::rethrow_exception(exception_);
+            }
+            const auto copy_size = boost::asio::buffer_copy(buffer, buffer_.data());
+            buffer_.consume(copy_size);
+            return copy_size;
+        }
+
+        // never blocks, returns 0 if nothing readable yet, exception is left to read
+        size_t try_read(boost::asio::mutable_buffer buffer) {
+            std::lock_guard<std::mutex> lock{ mutex_ };
+            const auto copy_size = boost::asio::buffer_copy(buffer, buffer_.data());
+            buffer_.consume(copy_size);
+            return copy_size;
+        }
+
+        // invoked under stream lock on every append and close, must not reenter the stream
+        void notify_by(folly::Function<void()> notify) {
+            std::lock_guard<std::mutex> lock{ mutex_ };
+            notify_ = std::move(notify);
+        }
+
+        size_t readable_size() const {
+            std::lock_guard<std::mutex> lock{ mutex_ };
+            return buffer_.size();
+        }
+
+        int64_t append_size() const {
+            std::lock_guard<std::mutex> lock{ mutex_ };
+            return append_size_;
+        }
+
+        std::optional<int64_t> content_size() const noexcept {
+            return content_size_;
+        }
+
+        bool closed() const {
+            std::lock_guard<std::mutex> lock{ mutex_ };
+            return closed_;
+        }
+    };
+}
@@ -11,6 +11,7 @@
 #include <variant>
 #include "core/meta/type_trait.hpp"
 #include "core/meta/meta.hpp"
+#include "core/buffer_vector.hpp"
 
 namespace core
 {
@@ -18,21 +19,12 @@ namespace core
     typename std::enable_if<
         boost::asio::is_const_buffer_sequence<
             decltype(std::declval<BufferSequence>().data())>::value,
-        std::list<boost::asio::const_buffer>
+        buffer_vector
     >::type
     split_buffer_sequence(BufferSequence&& sequence, TailSequence&& ...tails) {
-        std::list<boost::asio::const_buffer> buffer_list;
-        auto sequence_data = std::forward<BufferSequence>(sequence).data();
-        std::transform(boost::asio::buffer_sequence_begin(sequence_data),
-                       boost::asio::buffer_sequence_end(sequence_data),
-                       std::back_inserter(buffer_list),
-                       [](const auto& buffer) {
-                           return boost::asio::const_buffer{ buffer };
-                       });
-        if constexpr (sizeof...(TailSequence) > 0) {
-            buffer_list.splice(buffer_list.end(),
-                               split_buffer_sequence(std::forward<TailSequence>(tails)...));
-        }
+        buffer_vector buffer_list;
+        buffer_list.append(std::forward<BufferSequence>(sequence).data());
+        (buffer_list.append(std::forward<TailSequence>(tails).data()), ...);
         return buffer_list;
     }
 
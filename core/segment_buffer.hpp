@@ -0,0 +1,211 @@
+#pragma once
+#include <boost/asio/buffer.hpp>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+namespace core
+{
+    // size classed free lists of contiguous blocks, later segments of a tile reuse
+    // blocks released by earlier ones instead of going through allocator again
+    class segment_pool final
+    {
+    public:
+        using block_pointer = std::unique_ptr<char[]>;
+
+        static constexpr inline size_t min_block_size = 64 * 1024;
+        static constexpr inline size_t class_count = 12;
+        static constexpr inline size_t default_class_capacity = 4;
+        static constexpr inline size_t max_block_size = min_block_size << (class_count - 1);
+
+    private:
+        std::mutex mutex_;
+        std::array<std::vector<block_pointer>, class_count> free_blocks_;
+        const size_t class_capacity_;
+        std::atomic<int64_t> hit_count_{ 0 };
+        std::atomic<int64_t> miss_count_{ 0 };
+
+    public:
+        explicit segment_pool(size_t class_capacity = default_class_capacity)
+            : class_capacity_{ class_capacity } {}
+
+        segment_pool(const segment_pool&) = delete;
+        segment_pool(segment_pool&&) = delete;
+        segment_pool& operator=(const segment_pool&) = delete;
+        segment_pool& operator=(segment_pool&&) = delete;
+        ~segment_pool() = default;
+
+        // power of two capacity from min_block_size, larger blocks are exact sized and never pooled
+        static size_t class_size(size_t size) noexcept {
+            if (size > max_block_size) {
+                return size;
+            }
+            auto block_size = min_block_size;
+            while (block_size < size) {
+                block_size <<= 1;
+            }
+            return block_size;
+        }
+
+        std::pair<block_pointer, size_t> acquire(size_t size) {
+            const auto block_size = class_size(size);
+            if (const auto index = class_index(block_size); index < class_count) {
+                std::lock_guard<std::mutex> lock{ mutex_ };
+                if (auto& blocks = free_blocks_[index]; !blocks.empty()) {
+                    auto block = std::move(blocks.back());
+                    blocks.pop_back();
+                    hit_count_.fetch_add(1, std::memory_order_relaxed);
+                    return { std::move(block), block_size };
+                }
+            }
+            miss_count_.fetch_add(1, std::memory_order_relaxed);
+            return { block_pointer{ new char[block_size] }, block_size };
+        }
+
+        void release(block_pointer block, size_t block_size) {
+            if (const auto index = class_index(block_size); index < class_count) {
+                std::lock_guard<std::mutex> lock{ mutex_ };
+                if (auto& blocks = free_blocks_[index]; blocks.size() < class_capacity_) {
+                    blocks.push_back(std::move(block));
+                }
+            }
+        }
+
+        int64_t hit_count() const noexcept {
+            return hit_count_.load(std::memory_order_relaxed);
+        }
+
+        int64_t miss_count() const noexcept {
+            return miss_count_.load(std::memory_order_relaxed);
+        }
+
+    private:
+        static size_t class_index(size_t block_size) noexcept {
+            size_t index = 0;
+            while (index < class_count && min_block_size << index < block_size) {
+                ++index;
+            }
+            return (min_block_size << index) == block_size ? index : class_count;
+        }
+    };
+
+    // contiguous dynamic buffer holding one segment payload, storage block is taken
+    // from the pool if any and returned to it on destruction
+    class segment_buffer final
+    {
+        std::shared_ptr<segment_pool> pool_;
+        segment_pool::block_pointer block_;
+        size_t capacity_ = 0;
+        size_t begin_ = 0;
+        size_t end_ = 0;
+
+    public:
+        using const_buffers_type = boost::asio::const_buffer;
+        using mutable_buffers_type = boost::asio::mutable_buffer;
+
+        segment_buffer() = default;
+
+        explicit segment_buffer(std::shared_ptr<segment_pool> pool)
+            : pool_{ std::move(pool) } {}
+
+        // unpooled copy of buffer sequence
+        template <typename ConstBufferSequence,
+                  typename = std::enable_if_t<boost::asio::is_const_buffer_sequence<ConstBufferSequence>::value>>
+        explicit segment_buffer(const ConstBufferSequence& buffers) {
+            const auto size = boost::asio::buffer_size(buffers);
+            commit(boost::asio::buffer_copy(prepare(size), buffers));
+        }
+
+        segment_buffer(const segment_buffer&) = delete;
+        segment_buffer& operator=(const segment_buffer&) = delete;
+
+        segment_buffer(segment_buffer&& that) noexcept
+            : pool_{ std::move(that.pool_) }
+            , block_{ std::move(that.block_) }
+            , capacity_{ std::exchange(that.capacity_, 0) }
+            , begin_{ std::exchange(that.begin_, 0) }
+            , end_{ std::exchange(that.end_, 0) } {}
+
+        segment_buffer& operator=(segment_buffer&& that) noexcept {
+            if (this != &that) {
+                release_block();
+                pool_ = std::move(that.pool_);
+                block_ = std::move(that.block_);
+                capacity_ = std::exchange(that.capacity_, 0);
+                begin_ = std::exchange(that.begin_, 0);
+                end_ = std::exchange(that.end_, 0);
+            }
+            return *this;
+        }
+
+        ~segment_buffer() {
+            release_block();
+        }
+
+        // readable bytes are kept, e.g. reserved once from Content-Length before reading body
+        void reserve(size_t size) {
+            if (capacity_ - end_ >= size) {
+                return;
+            }
+            const auto readable_size = this->size();
+            if (capacity_ - readable_size >= size) {
+                std::memmove(block_.get(), block_.get() + begin_, readable_size);
+            } else {
+                auto [block, block_size] = pool_ != nullptr
+                                               ? pool_->acquire(readable_size + size)
+                                               : std::make_pair(segment_pool::block_pointer{
+                                                                    new char[readable_size + size]
+                                                                }, readable_size + size);
+                if (readable_size > 0) {
+                    std::memcpy(block.get(), block_.get() + begin_, readable_size);
+                }
+                release_block();
+                block_ = std::move(block);
+                capacity_ = block_size;
+            }
+            begin_ = 0;
+            end_ = readable_size;
+        }
+
+        mutable_buffers_type prepare(size_t size) {
+            reserve(size);
+            return { block_.get() + end_, size };
+        }
+
+        void commit(size_t size) noexcept {
+            end_ += std::min(size, capacity_ - end_);
+        }
+
+        const_buffers_type data() const noexcept {
+            return { block_.get() + begin_, size() };
+        }
+
+        void consume(size_t size) noexcept {
+            begin_ += std::min(size, this->size());
+            if (begin_ == end_) {
+                begin_ = end_ = 0;
+            }
+        }
+
+        size_t size() const noexcept {
+            return end_ - begin_;
+        }
+
+        size_t capacity() const noexcept {
+            return capacity_;
+        }
+
+    private:
+        void release_block() noexcept {
+            if (block_ != nullptr && pool_ != nullptr) {
+                pool_->release(std::move(block_), capacity_);
+            }
+            block_.reset();
+            capacity_ = begin_ = end_ = 0;
+        }
+    };
+}
@@ -1,5 +1,6 @@
 ﻿#include "stdafx.h"
 #include "graphic.h"
+#include "multimedia/plane.kernel.h"
 #include "unity/IUnityGraphicsD3D11.h"
 #include <folly/Conv.h>
 #pragma warning(disable: 4267)
@@ -161,11 +162,13 @@ inline namespace plugin
 
     void graphic::map_texture_data(ID3D11DeviceContext& context,
                                    ID3D11Texture2D* texture,
-                                   void* data, size_t size) {
+                                   const uint8_t* data, const int linesize,
+                                   const int width, const int height) {
         D3D11_MAPPED_SUBRESOURCE mapped_resource{};
         context.Map(texture, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped_resource);
-        std::copy_n(static_cast<uint8_t*>(data), size,
-                    static_cast<uint8_t*>(mapped_resource.pData));
+        media::kernel::copy_plane(static_cast<uint8_t*>(mapped_resource.pData),
+                                  static_cast<int>(mapped_resource.RowPitch),
+                                  data, linesize, width, height);
         context.Unmap(texture, 0);
     }
 
@@ -216,17 +219,16 @@ inline namespace plugin
                 auto* frame_planar_data = frame->data[index];
                 assert(stretch(frame->width) == desc.Width);
                 assert(stretch(frame->height) == desc.Height);
-                assert(stretch(frame->width) == frame->linesize[index]);
+                assert(stretch(frame->width) <= frame->linesize[index]);
                 switch (desc.Usage) {
                     case D3D11_USAGE_DEFAULT:
                         context.UpdateSubresource(texture, 0, nullptr,
-                                                  frame_planar_data, desc.Width, 0);
+                                                  frame_planar_data, frame->linesize[index], 0);
                         break;
-                    case D3D11_USAGE_DYNAMIC: {
-                        const auto planar_size = desc.Width * desc.Height;
-                        map_texture_data(context, texture, frame_planar_data, planar_size);
+                    case D3D11_USAGE_DYNAMIC:
+                        map_texture_data(context, texture, frame_planar_data, frame->linesize[index],
+                                         desc.Width, desc.Height);
                         break;
-                    }
                     default:
                         assert(!"unexpected texture usage");
                 }
@@ -75,9 +75,11 @@ inline namespace plugin
         ID3D11Texture2D* make_dynamic_texture(int width, int height, void* data) const;
         ID3D11Texture2D* make_default_texture(int width, int height, void* data) const;
         ID3D11ShaderResourceView* make_shader_resource(ID3D11Texture2D* texture) const;
+        // mapped row pitch and frame linesize may both be padded beyond width
         static void map_texture_data(ID3D11DeviceContext& context,
                                      ID3D11Texture2D* texture,
-                                     void* data, size_t size);
+                                     const uint8_t* data, int linesize,
+                                     int width, int height);
     };
 
     struct update_batch final
@@ -0,0 +1,58 @@
+#pragma once
+#include <folly/lang/Align.h>
+#include <atomic>
+#include <cassert>
+#include <memory>
+
+namespace plugin
+{
+    // per frame index count of tiles which decoded that frame, newest index counted by
+    // every tile is published as assembled, tiles decode in order so assembled only grows
+    class frame_assembly final
+    {
+        const int tile_count_;
+        const size_t window_;
+        // slot of frame index is reused window frames later, fastest tile never leads
+        // slowest one by window since its decode ring is bounded
+        std::unique_ptr<std::atomic<int>[]> counters_;
+        alignas(folly::hardware_destructive_interference_size) std::atomic<int64_t> assembled_{ -1 };
+
+    public:
+        frame_assembly(int tile_count, size_t window)
+            : tile_count_{ tile_count }
+            , window_{ window }
+            , counters_{ std::make_unique<std::atomic<int>[]>(window) } {
+            for (size_t index = 0; index < window_; ++index) {
+                counters_[index].store(0, std::memory_order_relaxed);
+            }
+        }
+
+        frame_assembly(const frame_assembly&) = delete;
+        frame_assembly(frame_assembly&&) = delete;
+        frame_assembly& operator=(const frame_assembly&) = delete;
+        frame_assembly& operator=(frame_assembly&&) = delete;
+        ~frame_assembly() = default;
+
+        // tile finished writing frame of index into its decode ring
+        void complete(int64_t frame_index) {
+            assert(frame_index > assembled_.load(std::memory_order_relaxed) - static_cast<int64_t>(window_));
+            auto& counter = counters_[frame_index % window_];
+            if (counter.fetch_add(1, std::memory_order_acq_rel) + 1 < tile_count_) {
+                return;
+            }
+            counter.store(0, std::memory_order_relaxed);
+            auto assembled = assembled_.load(std::memory_order_relaxed);
+            while (assembled < frame_index
+                && !assembled_.compare_exchange_weak(assembled, frame_index, std::memory_order_release)) {}
+        }
+
+        // -1 until every tile decoded first frame
+        int64_t assembled() const noexcept {
+            return assembled_.load(std::memory_order_acquire);
+        }
+
+        size_t window() const noexcept {
+            return window_;
+        }
+    };
+}
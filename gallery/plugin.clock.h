@@ -0,0 +1,93 @@
+#pragma once
+#include <absl/time/time.h>
+#include <optional>
+#include <utility>
+
+namespace plugin
+{
+    // maps wall time onto stream timeline anchored at first scheduled frame, timeline
+    // halts while next frame is not decoded by every tile so a network stall is not
+    // turned into drops
+    class presentation_clock final
+    {
+    public:
+        enum class decision
+        {
+            present, drop, wait,
+        };
+
+    private:
+        const absl::Duration default_interval_;
+        std::optional<absl::Time> tick_time_;
+        std::optional<absl::Duration> media_time_;
+        int64_t present_count_ = 0;
+        int64_t drop_count_ = 0;
+        int64_t repeat_count_ = 0;
+
+    public:
+        explicit presentation_clock(absl::Duration default_interval = absl::Seconds(1) / 30)
+            : default_interval_{ default_interval } {}
+
+        presentation_clock(const presentation_clock&) = delete;
+        presentation_clock& operator=(const presentation_clock&) = delete;
+        ~presentation_clock() = default;
+
+        // advances timeline by wall time elapsed since last tick unless starved
+        void tick(absl::Time now, bool starved) {
+            const auto last_tick_time = std::exchange(tick_time_, now);
+            if (media_time_.has_value() && last_tick_time.has_value() && !starved) {
+                *media_time_ += now - *last_tick_time;
+            }
+        }
+
+        // frame without timestamp is presented in decode order
+        decision schedule(absl::Duration time, absl::Duration duration) {
+            if (time == absl::InfiniteDuration()) {
+                return count(decision::present);
+            }
+            if (!media_time_.has_value()) {
+                media_time_ = time;
+            }
+            if (duration <= absl::ZeroDuration()) {
+                duration = default_interval_;
+            }
+            if (time + duration <= *media_time_) {
+                return count(decision::drop);
+            }
+            return time <= *media_time_ ? count(decision::present) : decision::wait;
+        }
+
+        // nothing new is presented this tick, textures keep previous picture
+        void repeat() {
+            if (media_time_.has_value()) {
+                ++repeat_count_;
+            }
+        }
+
+        std::optional<absl::Duration> media_time() const noexcept {
+            return media_time_;
+        }
+
+        int64_t present_count() const noexcept {
+            return present_count_;
+        }
+
+        int64_t drop_count() const noexcept {
+            return drop_count_;
+        }
+
+        int64_t repeat_count() const noexcept {
+            return repeat_count_;
+        }
+
+    private:
+        decision count(decision result) {
+            if (result == decision::present) {
+                ++present_count_;
+            } else if (result == decision::drop) {
+                ++drop_count_;
+            }
+            return result;
+        }
+    };
+}
@@ -40,12 +40,21 @@ namespace plugin
             {
                 size_t capacity = 30;
                 bool enable = true;
+                bool schedule = true;
             } decode;
 
             struct render
             {
                 size_t capacity = 1;
             } render;
+
+            struct prefetch
+            {
+                unsigned window = 3;
+                int64_t budget = 256 * 1024 * 1024;
+                // demux media segment while its body is still downloading
+                bool stream = true;
+            } prefetch;
         } system;
 
     private:
@@ -81,6 +90,7 @@ namespace plugin
             alternate<unsigned> network{ std::thread::hardware_concurrency() };
             alternate<unsigned> executor{ std::thread::hardware_concurrency() };
             alternate<unsigned> decoder{ 2u };
+            alternate<unsigned> connection{ 8u };
         } concurrency;
     };
 
@@ -100,5 +110,9 @@ namespace plugin
         json.at("System").at("DecodeCapacity").get_to(config.system.decode.capacity);
         json.at("System").at("RenderCapacity").get_to(config.system.render.capacity);
         json.at("System").at("TexturePoolSize").get_to(config.system.texture_pool_size);
+        config.concurrency.connection = json.at("Dash").value("MaxConnections", static_cast<unsigned>(config.concurrency.connection));
+        config.system.prefetch.window = json.at("System").value("PrefetchWindow", config.system.prefetch.window);
+        config.system.prefetch.budget = json.at("System").value("PrefetchBudget", config.system.prefetch.budget);
+        config.system.prefetch.stream = json.at("System").value("PrefetchStream", config.system.prefetch.stream);
     }
 }
@@ -1,9 +1,10 @@
 #pragma once
 #include "core/spatial.hpp"
 #include "multimedia/media.h"
-#include <folly/MPMCQueue.h>
-#include <readerwriterqueue/readerwriterqueue.h>
+#include "plugin.ring.h"
 #include <bitset>
+#include <condition_variable>
+#include <mutex>
 
 namespace plugin
 {
@@ -44,9 +45,15 @@ namespace plugin
     struct stream_context final : stream_base
     {
         using decode_frame = std::variant<media::frame, std::exception_ptr>;
+        // decoder writes, poll update commits and render callback pops, decode capacity
+        // plus render capacity bounds frames held between decoder and texture upload
         struct decode_event final
         {
-            folly::MPMCQueue<decode_frame> queue;
+            frame_ring<decode_frame> queue;
+            // decoder thread parked on a full ring waits on released, scheduled decoder
+            // is notified through decode scheduler instead
+            std::mutex mutex;
+            std::condition_variable released;
             int64_t enqueue = 0;
 
             explicit decode_event(const size_t capacity)
@@ -58,6 +65,7 @@ namespace plugin
         {
             int64_t dequeue_try = 0;
             int64_t dequeue_success = 0;
+            int64_t dequeue_discard = 0;
             int64_t render_finish = 0;
             absl::Time render_time;
             std::bitset<3> texture_state{ 0 };
@@ -66,18 +74,13 @@ namespace plugin
         struct render_event final
         {
             media::frame* frame = nullptr;
-            moodycamel::ReaderWriterQueue<media::frame> queue;
             int64_t begin = 0;
             int64_t end = 0;
-
-            explicit render_event(const size_t capacity)
-                : queue{ capacity } {}
         } render;
 
         explicit stream_context(stream_options options)
             : stream_base{ options.index, options.coordinate, options.offset }
-            , decode{ { options.decode_capacity } }
-            , render{ options.render_capacity } { }
+            , decode{ options.decode_capacity + options.render_capacity } { }
 
         stream_context() = delete;
         stream_context(const stream_context&) = delete;
@@ -4,15 +4,20 @@
 #include "plugin.context.h"
 #include "plugin.util.h"
 #include "plugin.logger.h"
+#include "plugin.scheduler.h"
+#include "plugin.assembly.h"
+#include "plugin.clock.h"
 #include "network/dash.manager.h"
 #include "multimedia/media.h"
-#include "multimedia/io.segmentor.h"
+#include "multimedia/io.session.h"
+#include "multimedia/frame.pool.h"
 #include "core/core.h"
 #include "core/exception.hpp"
 
 #pragma warning(disable:4722)
 
 #include <folly/Uri.h>
+#include <folly/executors/InlineExecutor.h>
 #include <folly/executors/ThreadedExecutor.h>
 #include <boost/container/small_vector.hpp>
 #include <boost/logic/tribool.hpp>
@@ -21,8 +26,10 @@
 #include <boost/multi_index_container.hpp>
 #include <boost/process/environment.hpp>
 #include <nlohmann/json.hpp>
+#include <condition_variable>
 #include <filesystem>
 #include <fstream>
+#include <mutex>
 #include <folly/Lazy.h>
 #include <fmt/ostream.h>
 #include <absl/strings/str_split.h>
@@ -36,6 +43,7 @@ using plugin::stream_base;
 using plugin::stream_context;
 using plugin::stream_options;
 using plugin::logger_type;
+using plugin::decode_scheduler;
 
 using namespace std::literals;
 
@@ -44,6 +52,12 @@ inline namespace resource
     std::shared_ptr<folly::ThreadPoolExecutor> compute_executor;
     std::shared_ptr<folly::ThreadedExecutor> stream_executor;
     std::shared_ptr<folly::ThreadedExecutor> update_executor;
+    std::shared_ptr<media::frame_pool> frame_pool;
+    std::shared_ptr<decode_scheduler> tile_scheduler;
+    std::shared_ptr<plugin::frame_assembly> tile_assembly;
+    std::optional<plugin::presentation_clock> frame_clock;
+    int64_t clock_frame_index = 0;
+    std::vector<decode_scheduler::task_id> tile_task_cache;
     std::vector<stream_context*> tile_stream_cache;
 
     struct index_key final { };
@@ -117,6 +131,48 @@ auto tile_coordinate = [](int index) constexpr {
     return std::make_pair(x, y);
 };
 
+// decode ring is bounded, decoder thread waits until a slot is freed or plugin stops
+auto write_until_cancelled = [](stream_context& tile_stream, stream_context::decode_frame&& frame,
+                                const folly::CancellationToken& running_token) {
+    auto& decode = tile_stream.decode;
+    folly::CancellationCallback cancel_wait{
+        running_token, [&decode] {
+            std::lock_guard<std::mutex> lock{ decode.mutex };
+            decode.released.notify_all();
+        }
+    };
+    auto written = false;
+    std::unique_lock<std::mutex> lock{ decode.mutex };
+    decode.released.wait(lock, [&] {
+        // frame is moved only on success
+        written = decode.queue.write(std::move(frame));
+        return written || running_token.isCancellationRequested();
+    });
+    return written;
+};
+
+// decoder parked on a full ring resumes once a slot is freed
+auto notify_decoder = [](stream_context& tile_stream) {
+    if (tile_scheduler) {
+        tile_scheduler->notify(tile_task_cache.at(tile_stream.index - 1));
+        return;
+    }
+    std::lock_guard<std::mutex> lock{ tile_stream.decode.mutex };
+    tile_stream.decode.released.notify_one();
+};
+
+auto pop_decode_frame = [](stream_context& tile_stream) {
+    tile_stream.decode.queue.pop();
+    notify_decoder(tile_stream);
+};
+
+// nothing is uploaded with decode disabled, poll update frees slot without committing
+// and render callback never reads the ring, so it keeps a single consumer
+auto discard_decode_frame = [](stream_context& tile_stream) {
+    tile_stream.decode.queue.discard();
+    notify_decoder(tile_stream);
+};
+
 auto rate_adaptation_algorithms = folly::lazy([] {
     std::vector<std::function<double(int, int)>> rate_adaptation_list;
     rate_adaptation_list.push_back([=](const int tile_col,
@@ -159,6 +215,9 @@ namespace unity
                 sink = std::make_shared<spdlog::sinks::null_sink_st>();
             }
             manager.trace_by(std::move(sink));
+            manager.prefetch_by(configs->system.prefetch.window, configs->system.prefetch.budget);
+            manager.stream_by(configs->system.prefetch.stream);
+            manager.connect_by(configs->concurrency.connection);
             if (configs->adaptation.enable) {
                 manager.predict_by(
                     rate_adaptation_algorithms().at(configs->adaptation.algorithm_index));
@@ -226,50 +285,48 @@ namespace unity
             auto& logger = logger_manager->get(logger_type::decode);
             const auto tile_stream_id = tile_stream.index;
             logger->info("stream {} working, thread {}", tile_stream_id, std::this_thread::get_id());
-            try {
-                while (!running_token.isCancellationRequested()) {
+            media::decode_session decode_session{
+                [&]() -> media::decode_session::segment {
+                    if (running_token.isCancellationRequested()) {
+                        core::aborted_error::throw_directly();
+                    }
                     auto buffer_sequence = std::move(future_buffer).get();
                     logger->info("stream {} buffer {} available, download time {} ms",
-                                 tile_stream_id, buffer_id, absl::ToDoubleMilliseconds(buffer_sequence.duration));
+                                 tile_stream_id, buffer_id++, absl::ToDoubleMilliseconds(buffer_sequence.duration));
                     future_buffer = buffer_streamer();
-                    media::frame_segmentor frame_segmentor{
-                        core::split_buffer_sequence(buffer_sequence.initial, buffer_sequence.data),
-                        configs->concurrency.decoder
+                    return {
+                        buffer_sequence.initial, std::move(buffer_sequence.data), std::move(buffer_sequence.stream)
                     };
-                    logger->info("stream {} buffer {} parsed", tile_stream_id, buffer_id);
-                    buffer_id++;
-                    const auto decode_disable = !configs->system.decode.enable;
-                    assert(frame_segmentor.context_valid());
-                    while (frame_segmentor.codec_available()) {
-                        auto running = false;
-                        auto frame_list = frame_segmentor.try_consume(decode_disable);
-
-                        for (auto& frame : frame_list) {
-                            if (!decode_disable) {
-                                assert(frame->width > 200 && frame->height > 100);
-                            }
-                            logger->info("stream {} decode frame {} duration {}",
-                                         tile_stream_id, tile_stream.decode.enqueue,
-                                         absl::ToDoubleMilliseconds(frame.process_duration()));
-                            logger->info("stream {} decode queue size {} ",
-                                         tile_stream_id, tile_stream.decode.queue.size());
-                            do {
-                                running = !running_token.isCancellationRequested();
-                            } while (running && !tile_stream.decode.queue
-                                                            .tryWriteUntil(std::chrono::steady_clock::now() + 100ms,
-                                                                           std::move(frame)));
-                            if (!running) {
-                                core::aborted_error::throw_directly();
-                            }
-                            logger->info("stream {} decode frame {} enqueue",
-                                         tile_stream_id, tile_stream.decode.enqueue);
-                            tile_stream.decode.enqueue++;
+                },
+                configs->concurrency.decoder,
+                resource::frame_pool
+            };
+            try {
+                const auto decode_disable = !configs->system.decode.enable;
+                while (!running_token.isCancellationRequested()) {
+                    auto running = false;
+                    auto frame_list = decode_session.try_consume(
+                        decode_disable ? media::decode_session::discard::all : media::decode_session::discard::none);
+                    for (auto& frame : frame_list) {
+                        if (!decode_disable) {
+                            assert(frame->width > 200 && frame->height > 100);
+                        }
+                        logger->info("stream {} decode frame {} duration {}",
+                                     tile_stream_id, tile_stream.decode.enqueue,
+                                     absl::ToDoubleMilliseconds(frame.process_duration()));
+                        logger->info("stream {} decode queue size {} ",
+                                     tile_stream_id, tile_stream.decode.queue.size());
+                        running = write_until_cancelled(tile_stream, std::move(frame), running_token);
+                        if (!running) {
+                            core::aborted_error::throw_directly();
                         }
-                        if (decode_disable && frame_list.empty()) break;
+                        logger->info("stream {} decode frame {} enqueue",
+                                     tile_stream_id, tile_stream.decode.enqueue);
+                        tile_assembly->complete(tile_stream.decode.enqueue++);
                     }
                 }
             } catch (core::bad_response_error e) {
-                tile_stream.decode.queue.blockingWrite(std::make_exception_ptr(e));
+                write_until_cancelled(tile_stream, std::make_exception_ptr(e), running_token);
                 logger->warn("stream {} write last decoded frame", tile_stream_id);
             } catch (core::aborted_error) {
                 const auto running = !running_token.isCancellationRequested();
@@ -281,20 +338,237 @@ namespace unity
                 assert(!"stream_executor catch unexpected exception");
                 logger->error("stream {} abnormally stopped", tile_stream_id);
             }
-            logger->info("stream {} exiting, thread {}", tile_stream_id, std::this_thread::get_id());
+            logger->info("stream {} exiting, segment {} switch {}, thread {}", tile_stream_id,
+                         decode_session.segment_count(), decode_session.switch_count(),
+                         std::this_thread::get_id());
+        };
+    };
+
+    // nearer tiles to field of view are dispatched first, columns wrap around the panorama
+    auto tile_priority = [](core::coordinate coordinate) {
+        return [coordinate]() -> int8_t {
+            using description::frame_grid;
+            const auto field_of_view = std::atomic_load(&state::field_of_view);
+            const auto col_offset = std::abs(coordinate.col - field_of_view.col);
+            const auto row_offset = std::abs(coordinate.row - field_of_view.row);
+            const auto offset = std::max(std::min(col_offset, frame_grid.col - col_offset), row_offset);
+            if (offset == 0) {
+                return folly::Executor::HI_PRI;
+            }
+            return offset == 1 ? folly::Executor::MID_PRI : folly::Executor::LO_PRI;
         };
     };
 
+    // decodes one packet per scheduled step, parks instead of blocking a worker while
+    // next segment is downloading or decode queue is full
+    struct tile_decoder final : std::enable_shared_from_this<tile_decoder>
+    {
+        stream_context& tile_stream;
+        folly::CancellationToken running_token;
+        folly::Function<folly::SemiFuture<net::buffer_sequence>()> buffer_streamer;
+        folly::Future<folly::Unit> buffer_request = folly::Future<folly::Unit>::makeEmpty();
+        // filled by download callback, guarded by buffer_mutex
+        std::optional<folly::Try<net::buffer_sequence>> buffer;
+        std::mutex buffer_mutex;
+        std::condition_variable buffer_condition;
+        bool buffer_requested = false;
+        int buffer_id = 0;
+        media::decode_session decode_session;
+        media::detail::vector<media::frame> frame_list;
+        size_t frame_offset = 0;
+        // response failure held until ring has room to pass it on as end of stream
+        std::exception_ptr end_of_stream;
+        decode_scheduler::task_id task_id = 0;
+        std::shared_ptr<spdlog::logger> logger;
+
+        tile_decoder(stream_context& tile_stream, net::dash_manager& dash_manager)
+            : tile_stream{ tile_stream }
+            , running_token{ state::stream::running_token_source->getToken() }
+            , buffer_streamer{ dash_manager.tile_streamer(tile_stream.coordinate) }
+            , decode_session{
+                [this] {
+                    return next_segment();
+                },
+                configs->concurrency.decoder,
+                resource::frame_pool
+            }
+            , logger{ logger_manager->get(logger_type::decode) } {}
+
+        media::decode_session::segment next_segment() {
+            if (running_token.isCancellationRequested()) {
+                core::aborted_error::throw_directly();
+            }
+            if (!buffer_requested) {
+                request_buffer();
+            }
+            // step is parked on segment_demand until download callback notifies, so this waits
+            // only if demuxer runs past a whole segment, plugin release wakes it up
+            folly::CancellationCallback cancel_wait{
+                running_token, [this] {
+                    std::lock_guard<std::mutex> lock{ buffer_mutex };
+                    buffer_condition.notify_all();
+                }
+            };
+            std::unique_lock<std::mutex> lock{ buffer_mutex };
+            buffer_condition.wait(lock, [this] {
+                return buffer.has_value() || running_token.isCancellationRequested();
+            });
+            if (!buffer.has_value()) {
+                core::aborted_error::throw_directly();
+            }
+            auto buffer_sequence = std::move(*buffer).value();
+            buffer.reset();
+            lock.unlock();
+            buffer_requested = false;
+            logger->info("stream {} buffer {} available, download time {} ms",
+                         tile_stream.index, buffer_id++, absl::ToDoubleMilliseconds(buffer_sequence.duration));
+            request_buffer();
+            if (buffer_sequence.stream != nullptr) {
+                // parked on a partially downloaded segment until more body arrives
+                buffer_sequence.stream->notify_by(
+                    [id = task_id, scheduler = std::weak_ptr{ resource::tile_scheduler }] {
+                        if (auto tile_scheduler = scheduler.lock()) {
+                            tile_scheduler->notify(id);
+                        }
+                    });
+            }
+            return {
+                buffer_sequence.initial, std::move(buffer_sequence.data), std::move(buffer_sequence.stream)
+            };
+        }
+
+        void request_buffer() {
+            buffer_requested = true;
+            buffer_request = buffer_streamer()
+                             .via(&folly::InlineExecutor::instance())
+                             .thenTry([self = shared_from_this(),
+                                          scheduler = std::weak_ptr{ resource::tile_scheduler }](
+                                 folly::Try<net::buffer_sequence>&& buffer) {
+                                     {
+                                         std::lock_guard<std::mutex> lock{ self->buffer_mutex };
+                                         self->buffer.emplace(std::move(buffer));
+                                     }
+                                     self->buffer_condition.notify_all();
+                                     if (auto tile_scheduler = scheduler.lock()) {
+                                         tile_scheduler->notify(self->task_id);
+                                     }
+                                 });
+        }
+
+        bool buffer_ready() {
+            std::lock_guard<std::mutex> lock{ buffer_mutex };
+            return buffer.has_value();
+        }
+
+        // off-screen tile whose decode queue runs low is behind, it skips non-reference
+        // frames and consumer repeats last picture, visible tiles always decode in full
+        media::decode_session::discard discard_policy() const {
+            using discard = media::decode_session::discard;
+            if (!configs->system.decode.enable) {
+                return discard::all;
+            }
+            const auto visible = tile_priority(tile_stream.coordinate)() != folly::Executor::LO_PRI;
+            const auto behind = tile_stream.decode.queue.pending_size() * 4 <= configs->system.decode.capacity;
+            return !visible && behind ? discard::nonreference : discard::none;
+        }
+
+        decode_scheduler::step operator()(decode_scheduler::task_id id) {
+            task_id = id;
+            try {
+                if (running_token.isCancellationRequested()) {
+                    core::aborted_error::throw_directly();
+                }
+                if (end_of_stream) {
+                    return write_end_of_stream();
+                }
+                for (; frame_offset < frame_list.size(); ++frame_offset) {
+                    auto& frame = frame_list[frame_offset];
+                    // frame is moved only on success, slot owner notifies once it pops
+                    if (!tile_stream.decode.queue.write(std::move(frame))) {
+                        return decode_scheduler::step::blocked;
+                    }
+                    logger->info("stream {} decode frame {} enqueue", tile_stream.index, tile_stream.decode.enqueue);
+                    tile_assembly->complete(tile_stream.decode.enqueue++);
+                }
+                if (decode_session.stream_demand()) {
+                    return decode_scheduler::step::blocked;
+                }
+                if (decode_session.segment_demand() && !buffer_ready()) {
+                    if (!buffer_requested) {
+                        request_buffer();
+                    }
+                    return decode_scheduler::step::blocked;
+                }
+                frame_list = decode_session.try_consume(discard_policy());
+                frame_offset = 0;
+                for (auto& frame : frame_list) {
+                    logger->info("stream {} decode frame duration {}",
+                                 tile_stream.index, absl::ToDoubleMilliseconds(frame.process_duration()));
+                }
+                return decode_scheduler::step::progress;
+            } catch (core::bad_response_error e) {
+                end_of_stream = std::make_exception_ptr(e);
+                return write_end_of_stream();
+            } catch (core::aborted_error) {
+                logger->warn("stream {} aborted", tile_stream.index);
+            } catch (...) {
+                assert(!"decode_scheduler catch unexpected exception");
+                logger->error("stream {} abnormally stopped", tile_stream.index);
+            }
+            return finish();
+        }
+
+        // parks on a full ring like a decoded frame does, woken by slot owner
+        decode_scheduler::step write_end_of_stream() {
+            if (!tile_stream.decode.queue.write(end_of_stream)) {
+                return decode_scheduler::step::blocked;
+            }
+            logger->warn("stream {} write last decoded frame", tile_stream.index);
+            return finish();
+        }
+
+        decode_scheduler::step finish() {
+            logger->info("stream {} exiting, segment {} switch {} discard {}", tile_stream.index,
+                         decode_session.segment_count(), decode_session.switch_count(),
+                         decode_session.discard_count());
+            return decode_scheduler::step::finished;
+        }
+    };
+
     void _nativeDashPrefetch() {
         using description::frame_grid;
+        using description::tile_count;
         logger_manager->get(logger_type::plugin)
                       ->info("_nativeDashPrefetch tile_stream_table size {}", tile_stream_table.size());
         assert(tile_stream_table.size() == frame_grid.col * frame_grid.row);
         assert(dash_manager.hasValue());
         assert(state::stream::available());
         logger_manager->get(logger_type::decode);
+        // tiles of equal resolution share one slab, each tile holds frames in
+        // decode ring and decoder threads
+        frame_pool = std::make_shared<media::frame_pool>(
+            description::tile_count * (configs->system.decode.capacity + configs->system.render.capacity
+                                       + configs->concurrency.decoder + 2));
+        // a tile leads slowest one by at most its ring capacity, counters are doubled for margin
+        tile_assembly = std::make_shared<plugin::frame_assembly>(
+            tile_count, 2 * (configs->system.decode.capacity + configs->system.render.capacity));
+        frame_clock.emplace();
+        clock_frame_index = 0;
+        if (!configs->system.decode.schedule) {
+            for (auto& tile_stream : tile_stream_table.get<coordinate_key>()) {
+                stream_executor->add(stream_mpeg_dash(core::as_mutable(tile_stream)));
+            }
+            return;
+        }
+        tile_scheduler = std::make_shared<decode_scheduler>();
+        tile_task_cache.assign(tile_count, 0);
         for (auto& tile_stream : tile_stream_table.get<coordinate_key>()) {
-            stream_executor->add(stream_mpeg_dash(core::as_mutable(tile_stream)));
+            auto decoder = std::make_shared<tile_decoder>(core::as_mutable(tile_stream), dash_manager.value());
+            tile_task_cache.at(tile_stream.index - 1) = tile_scheduler->submit(
+                [decoder](decode_scheduler::task_id id) {
+                    return (*decoder)(id);
+                },
+                tile_priority(tile_stream.coordinate));
         }
     }
 
@@ -320,29 +594,131 @@ namespace unity
     INT _nativeDashTilePtrPollUpdate(HANDLE instance, INT64 frame_index, INT64 batch_index) {
         auto& tile_stream = *reinterpret_cast<stream_context*>(instance);
         tile_stream.update.dequeue_try++;
-        stream_context::decode_frame decode_frame{ nullptr };
-        if (tile_stream.decode.queue.read(decode_frame)) {
-            tile_stream.update.dequeue_success++;
-            if (std::holds_alternative<std::exception_ptr>(decode_frame)) {
+        if (auto* decode_frame = tile_stream.decode.queue.pending_front()) {
+            if (std::holds_alternative<std::exception_ptr>(*decode_frame)) {
                 stream_context::update_frame stop_frame{ nullptr };
                 state::stream::available(&stop_frame);
                 return -1;
             }
-            if (configs->system.decode.enable) {
-                auto& update_frame = std::get<stream_context::update_frame>(decode_frame);
-                assert(!update_frame.empty());
-                logger_manager->get(logger_type::plugin)
-                              ->info("update stream {}, frame {} dequeue",
-                                     tile_stream.index, tile_stream.update.dequeue_success);
-                [[maybe_unused]] const auto enqueue_success =
-                    tile_stream.render.queue.enqueue(std::move(update_frame));
-                assert(enqueue_success && "poll_update_frame enqueue render queue failed");
+            tile_stream.update.dequeue_success++;
+            if (!configs->system.decode.enable) {
+                discard_decode_frame(tile_stream);
+                return 0;
+            }
+            const auto discard = std::get<stream_context::update_frame>(*decode_frame).empty();
+            tile_stream.decode.queue.commit();
+            if (discard) {
+                // discarded non-reference frame, texture keeps previous picture and
+                // render callback skips the slot
+                tile_stream.update.dequeue_discard++;
                 return 1;
             }
+            logger_manager->get(logger_type::plugin)
+                          ->info("update stream {}, frame {} dequeue",
+                                 tile_stream.index, tile_stream.update.dequeue_success);
+            return 1;
         }
         return 0;
     }
 
+    INT _nativeDashTilePtrPollUpdateBatch(HANDLE* instances, INT* results, const INT count,
+                                          INT64 frame_index, INT64 batch_index) {
+        auto ready_count = 0;
+        auto end_of_stream = false;
+        for (auto index = 0; index < count; ++index) {
+            results[index] = _nativeDashTilePtrPollUpdate(instances[index], frame_index, batch_index);
+            end_of_stream |= results[index] < 0;
+            ready_count += results[index] > 0;
+        }
+        return end_of_stream ? -1 : ready_count;
+    }
+
+    // a tile wrote its last frame, no later frame index is ever assembled
+    auto tile_end_of_stream = [] {
+        return std::any_of(
+            tile_stream_cache.begin(), tile_stream_cache.end(),
+            [](stream_context* tile_stream) {
+                auto* decode_frame = tile_stream->decode.queue.pending_front();
+                return decode_frame != nullptr && std::holds_alternative<std::exception_ptr>(*decode_frame);
+            });
+    };
+
+    INT _nativeDashFramePollUpdate(const INT64 frame_index, INT64& assembled_index) {
+        assembled_index = tile_assembly->assembled();
+        if (assembled_index < frame_index) {
+            if (tile_end_of_stream()) {
+                stream_context::update_frame stop_frame{ nullptr };
+                state::stream::available(&stop_frame);
+                return -1;
+            }
+            return 0;
+        }
+        // every tile holds frame of index at pending front, all are committed together
+        for (auto* tile_stream : tile_stream_cache) {
+            [[maybe_unused]] const auto poll_result = _nativeDashTilePtrPollUpdate(tile_stream, frame_index, 0);
+            assert(poll_result >= 0 && "_nativeDashFramePollUpdate assembled frame holds exception");
+        }
+        return 1;
+    }
+
+    // tiles commit in lock step, so once clock frame is assembled pending front of every
+    // tile holds it and one decision covers the whole frame, tiles never mix instants
+    INT _nativeDashClockPollUpdate(INT* results, const INT count) {
+        assert(static_cast<size_t>(count) == tile_stream_cache.size());
+        std::fill_n(results, count, 0);
+        const auto assembled = [] {
+            return tile_assembly->assembled() >= clock_frame_index;
+        };
+        frame_clock->tick(absl::Now(), !assembled());
+        auto update = false;
+        auto present = false;
+        while (!present && assembled()) {
+            auto decision = plugin::presentation_clock::decision::present;
+            // discarded placeholders carry no timestamp, any decoded tile stands for the frame
+            const auto reference = std::find_if(
+                tile_stream_cache.begin(), tile_stream_cache.end(),
+                [](stream_context* tile_stream) {
+                    return !std::get<stream_context::update_frame>(
+                        *tile_stream->decode.queue.pending_front()).empty();
+                });
+            if (reference != tile_stream_cache.end()) {
+                auto& frame = std::get<stream_context::update_frame>(*(*reference)->decode.queue.pending_front());
+                decision = frame_clock->schedule(frame.presentation_time(), frame.presentation_duration());
+                if (decision == plugin::presentation_clock::decision::wait) {
+                    break;
+                }
+                present = decision == plugin::presentation_clock::decision::present;
+            }
+            for (auto* tile_stream : tile_stream_cache) {
+                tile_stream->update.dequeue_success++;
+                if (!configs->system.decode.enable) {
+                    discard_decode_frame(*tile_stream);
+                    continue;
+                }
+                if (!present) {
+                    // late frame is emptied in place, render callback skips its slot
+                    std::get<stream_context::update_frame>(*tile_stream->decode.queue.pending_front())
+                        = stream_context::update_frame{ nullptr };
+                }
+                tile_stream->decode.queue.commit();
+            }
+            clock_frame_index++;
+            update = true;
+        }
+        if (!present && tile_end_of_stream()) {
+            stream_context::update_frame stop_frame{ nullptr };
+            state::stream::available(&stop_frame);
+            return -1;
+        }
+        if (!present) {
+            frame_clock->repeat();
+        }
+        if (update) {
+            std::fill_n(results, count, 1);
+        }
+        return update ? count : 0;
+    }
+
     void _nativeDashTileFieldOfView(INT col, INT row) {
         std::atomic_store(&state::field_of_view, { col, row });
     }
@@ -360,6 +736,21 @@ namespace unity
             executor = configs->concurrency.executor;
         }
 
+        void _nativeTestDecodeScheduleStore(BOOL enable) {
+            configs->system.decode.schedule = enable;
+        }
+
+        void _nativeTestFramePoolCounter(INT64& hit, INT64& miss) {
+            hit = frame_pool ? frame_pool->hit_count() : 0;
+            miss = frame_pool ? frame_pool->miss_count() : 0;
+        }
+
+        void _nativeTestPresentCounter(INT64& present, INT64& drop, INT64& repeat) {
+            present = frame_clock ? frame_clock->present_count() : 0;
+            drop = frame_clock ? frame_clock->drop_count() : 0;
+            repeat = frame_clock ? frame_clock->repeat_count() : 0;
+        }
+
         LPSTR _nativeTestString() {
             return util::unmanaged_string("Hello World Test"s);
         }
@@ -425,7 +816,9 @@ namespace unity
 
     auto reset_resource = [] {
         tile_stream_table.clear();
+        frame_pool = nullptr;
         tile_stream_cache.clear();
+        tile_task_cache.clear();
         state::stream::available(nullptr);
         std::atomic_store(&state::field_of_view, { 0, 0 });
     };
@@ -454,7 +847,28 @@ namespace unity
         auto already_cancelled = state::stream::running_token_source->requestCancellation();
         assert(!already_cancelled);
         stream_executor = nullptr; // join 1-1
+        if (tile_scheduler) {
+            tile_scheduler->notify_all();
+            tile_scheduler->join(); // join 1-2
+            logger_manager->get(logger_type::plugin)
+                          ->info("event=decode_scheduler.release,step={},block={}",
+                                 tile_scheduler->step_count(), tile_scheduler->block_count());
+        }
+        tile_scheduler = nullptr;
+        tile_assembly = nullptr;
+        if (frame_clock) {
+            logger_manager->get(logger_type::plugin)
+                          ->info("event=presentation_clock.release,present={},drop={},repeat={}",
+                                 frame_clock->present_count(), frame_clock->drop_count(),
+                                 frame_clock->repeat_count());
+        }
+        frame_clock.reset();
         render_logger = nullptr;
+        if (frame_pool) {
+            logger_manager->get(logger_type::plugin)
+                          ->info("event=frame_pool.release,hit={},miss={},slab={}",
+                                 frame_pool->hit_count(), frame_pool->miss_count(), frame_pool->slab_count());
+        }
         logger_manager->get(logger_type::plugin)->info("event=library.release");
         logger_manager.reset();
         dash_manager = folly::Future<net::dash_manager>::makeEmpty(); // join 2
@@ -512,6 +926,20 @@ namespace
     }
 #endif
 
+    // frame is read in place from ring, slots of discarded frames are skipped
+    media::frame* front_render_frame(stream_context& stream) {
+        if (!configs->system.decode.enable) {
+            return nullptr;
+        }
+        while (auto* decode_frame = stream.decode.queue.committed_front()) {
+            if (auto& frame = std::get<stream_context::update_frame>(*decode_frame); !frame.empty()) {
+                return &frame;
+            }
+            pop_decode_frame(stream);
+        }
+        return nullptr;
+    }
+
     void __stdcall on_texture_update_event(int event_id, void* data) {
         const auto params = reinterpret_cast<UnityRenderingExtTextureUpdateParamsV2*>(data);
         const auto stream_index = params->userData / 3;
@@ -525,29 +953,32 @@ namespace
                     assert(planar_index == 0);
                     assert(stream.render.frame == nullptr);
                     stream.update.render_time = absl::Now();
-                    stream.render.frame = stream.render.queue.peek();
+                    stream.render.frame = front_render_frame(stream);
                     if (!state::stream::available(stream.render.frame)) {
                         return;
                     }
                     render_logger->info("stream {} begin update texture {} planar {}",
                                         stream_index, stream.update.render_finish, planar_index);
                 }
-                assert(stream.render.frame != nullptr);
                 stream.render.begin++;
                 assert(!stream.update.texture_state.test(planar_index));
                 assert(params->format == UnityRenderingExtTextureFormat::kUnityRenderingExtFormatA8_UNorm);
                 stream.update.texture_state.set(planar_index);
-                params->texData = (*stream.render.frame)->data[planar_index];
+                if (stream.render.frame != nullptr) {
+                    // null texData leaves texture holding previous picture
+                    params->texData = (*stream.render.frame)->data[planar_index];
+                }
                 break;
             }
         case kUnityRenderingExtEventUpdateTextureEndV2:
             {
-                assert(stream.render.frame != nullptr);
                 stream.render.end++;
                 assert(stream.render.end <= stream.render.begin);
                 assert(stream.update.texture_state.test(planar_index));
                 if (stream.update.texture_state.all()) {
-                    stream.render.queue.pop();
+                    if (stream.render.frame != nullptr) {
+                        pop_decode_frame(stream);
+                    }
                     stream.update.texture_state.reset();
                     stream.render.frame = nullptr;
                     assert(planar_index == 2);
@@ -18,6 +18,9 @@ namespace unity
         void DLL_EXPORT __stdcall _nativeTestGraphicCreate();
         void DLL_EXPORT __stdcall _nativeTestConcurrencyStore(UINT codec, UINT net = 8);
         void DLL_EXPORT __stdcall _nativeTestConcurrencyLoad(UINT& codec, UINT& net, UINT& executor);
+        void DLL_EXPORT __stdcall _nativeTestDecodeScheduleStore(BOOL enable);
+        void DLL_EXPORT __stdcall _nativeTestFramePoolCounter(INT64& hit, INT64& miss);
+        void DLL_EXPORT __stdcall _nativeTestPresentCounter(INT64& present, INT64& drop, INT64& repeat);
         LPSTR DLL_EXPORT __stdcall _nativeTestString();
     }
 
@@ -29,6 +32,10 @@ namespace unity
     BOOL DLL_EXPORT __stdcall _nativeDashAvailable();
     INT DLL_EXPORT __stdcall _nativeDashTilePollUpdate(INT col, INT row, INT64 frame_index, INT64 batch_index);
     INT DLL_EXPORT __stdcall _nativeDashTilePtrPollUpdate(HANDLE instance, INT64 frame_index, INT64 batch_index);
+    INT DLL_EXPORT __stdcall _nativeDashTilePtrPollUpdateBatch(HANDLE* instances, INT* results, INT count,
+                                                               INT64 frame_index, INT64 batch_index);
+    INT DLL_EXPORT __stdcall _nativeDashFramePollUpdate(INT64 frame_index, INT64& assembled_index);
+    INT DLL_EXPORT __stdcall _nativeDashClockPollUpdate(INT* results, INT count);
     void DLL_EXPORT __stdcall _nativeDashTileFieldOfView(INT col, INT row);
 
     void DLL_EXPORT __stdcall _nativeGraphicSetTextures(HANDLE tex_y, HANDLE tex_u, HANDLE tex_v, BOOL temp);
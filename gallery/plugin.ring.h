@@ -0,0 +1,110 @@
+#pragma once
+#include <folly/lang/Align.h>
+#include <atomic>
+#include <cassert>
+#include <memory>
+#include <optional>
+
+namespace plugin
+{
+    // fixed capacity single producer ring handing decoded frames to render callback,
+    // poll update commits pending slots in order and render callback reads committed
+    // slots in place, so a frame is never moved once decoder wrote it
+    template <typename T>
+    class frame_ring final
+    {
+        struct alignas(folly::hardware_destructive_interference_size) position final
+        {
+            std::atomic<size_t> value{ 0 };
+        };
+
+        const size_t capacity_;
+        std::unique_ptr<std::optional<T>[]> slots_;
+        position write_;  // owned by decoder
+        position commit_; // owned by poll update
+        position read_;   // owned by render callback
+
+    public:
+        explicit frame_ring(size_t capacity)
+            : capacity_{ capacity }
+            , slots_{ std::make_unique<std::optional<T>[]>(capacity) } {}
+
+        frame_ring(const frame_ring&) = delete;
+        frame_ring(frame_ring&&) = delete;
+        frame_ring& operator=(const frame_ring&) = delete;
+        frame_ring& operator=(frame_ring&&) = delete;
+        ~frame_ring() = default;
+
+        //-- producer
+
+        // false if ring is full, arguments are left untouched in that case
+        template <typename ...Args>
+        bool write(Args&&... args) {
+            const auto write = write_.value.load(std::memory_order_relaxed);
+            if (write - read_.value.load(std::memory_order_acquire) == capacity_) {
+                return false;
+            }
+            slots_[write % capacity_].emplace(std::forward<Args>(args)...);
+            write_.value.store(write + 1, std::memory_order_release);
+            return true;
+        }
+
+        //-- committer
+
+        T* pending_front() {
+            const auto commit = commit_.value.load(std::memory_order_relaxed);
+            if (commit == write_.value.load(std::memory_order_acquire)) {
+                return nullptr;
+            }
+            return &*slots_[commit % capacity_];
+        }
+
+        void commit() {
+            commit_.value.fetch_add(1, std::memory_order_release);
+        }
+
+        // frees pending front without handing it to reader, committer acts as the only
+        // consumer then, so it is valid only while reader never touches the ring
+        void discard() {
+            const auto commit = commit_.value.load(std::memory_order_relaxed);
+            assert(commit == read_.value.load(std::memory_order_relaxed) && "discard with committed slots");
+            slots_[commit % capacity_].reset();
+            commit_.value.store(commit + 1, std::memory_order_release);
+            read_.value.store(commit + 1, std::memory_order_release);
+        }
+
+        //-- reader
+
+        T* committed_front() {
+            const auto read = read_.value.load(std::memory_order_relaxed);
+            if (read == commit_.value.load(std::memory_order_acquire)) {
+                return nullptr;
+            }
+            return &*slots_[read % capacity_];
+        }
+
+        // slot is reset before release so producer never observes a live value
+        void pop() {
+            const auto read = read_.value.load(std::memory_order_relaxed);
+            slots_[read % capacity_].reset();
+            read_.value.store(read + 1, std::memory_order_release);
+        }
+
+        //-- observer
+
+        // written but not yet committed, trailing index is loaded first to never underflow
+        size_t pending_size() const noexcept {
+            const auto commit = commit_.value.load(std::memory_order_acquire);
+            return write_.value.load(std::memory_order_acquire) - commit;
+        }
+
+        size_t size() const noexcept {
+            const auto read = read_.value.load(std::memory_order_acquire);
+            return write_.value.load(std::memory_order_acquire) - read;
+        }
+
+        size_t capacity() const noexcept {
+            return capacity_;
+        }
+    };
+}
@@ -0,0 +1,156 @@
+#pragma once
+#include "core/core.h"
+#include <folly/executors/CPUThreadPoolExecutor.h>
+#include <folly/executors/thread_factory/NamedThreadFactory.h>
+#include <folly/Function.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+namespace plugin
+{
+    // multiplexes tile decoders onto a fixed worker pool, each task runs one step per
+    // dispatch and is parked when blocked until notified by its producer or consumer
+    class decode_scheduler final
+    {
+    public:
+        enum class step
+        {
+            progress, blocked, finished,
+        };
+
+        using task_id = size_t;
+        using task = folly::Function<step(task_id)>;
+        using priority = folly::Function<int8_t()>;
+
+    private:
+        enum class state
+        {
+            queued, running, blocked, finished,
+        };
+
+        struct task_entry final
+        {
+            task run;
+            priority rank;
+            state current = state::queued;
+            bool notified = false;
+        };
+
+        std::mutex mutex_;
+        std::condition_variable finish_condition_;
+        std::deque<task_entry> tasks_;
+        size_t running_count_ = 0;
+        std::atomic<int64_t> step_count_{ 0 };
+        std::atomic<int64_t> block_count_{ 0 };
+        std::shared_ptr<folly::CPUThreadPoolExecutor> executor_;
+
+    public:
+        // folly::Executor::LO_PRI, MID_PRI and HI_PRI map to separate queues
+        static constexpr inline int8_t priority_count = 3;
+
+        explicit decode_scheduler(unsigned concurrency = std::thread::hardware_concurrency())
+            : executor_{
+                std::make_shared<folly::CPUThreadPoolExecutor>(
+                    std::max(1u, concurrency), priority_count,
+                    std::make_shared<folly::NamedThreadFactory>("PluginDecode"))
+            } {}
+
+        decode_scheduler(const decode_scheduler&) = delete;
+        decode_scheduler(decode_scheduler&&) = delete;
+        decode_scheduler& operator=(const decode_scheduler&) = delete;
+        decode_scheduler& operator=(decode_scheduler&&) = delete;
+
+        ~decode_scheduler() {
+            join();
+            executor_->join();
+        }
+
+        task_id submit(task run, priority rank) {
+            std::unique_lock<std::mutex> lock{ mutex_ };
+            const auto id = tasks_.size();
+            tasks_.push_back(task_entry{ std::move(run), std::move(rank) });
+            running_count_++;
+            dispatch(id, lock);
+            return id;
+        }
+
+        // wakes a blocked task, a running task is dispatched again once its step returns
+        void notify(task_id id) {
+            std::unique_lock<std::mutex> lock{ mutex_ };
+            auto& entry = tasks_.at(id);
+            if (entry.current == state::blocked) {
+                entry.current = state::queued;
+                dispatch(id, lock);
+            } else if (entry.current == state::running) {
+                entry.notified = true;
+            }
+        }
+
+        void notify_all() {
+            for (task_id id = 0; id < task_count(); ++id) {
+                notify(id);
+            }
+        }
+
+        void join() {
+            std::unique_lock<std::mutex> lock{ mutex_ };
+            finish_condition_.wait(lock, [this] {
+                return running_count_ == 0;
+            });
+        }
+
+        size_t task_count() {
+            std::lock_guard<std::mutex> lock{ mutex_ };
+            return tasks_.size();
+        }
+
+        int64_t step_count() const noexcept {
+            return step_count_.load(std::memory_order_relaxed);
+        }
+
+        int64_t block_count() const noexcept {
+            return block_count_.load(std::memory_order_relaxed);
+        }
+
+    private:
+        void dispatch(task_id id, std::unique_lock<std::mutex>& lock) {
+            assert(lock.owns_lock());
+            executor_->addWithPriority([this, id] { execute(id); }, tasks_[id].rank());
+        }
+
+        void execute(task_id id) {
+            std::unique_lock<std::mutex> lock{ mutex_ };
+            // deque never relocates elements on push_back
+            auto& entry = tasks_[id];
+            assert(entry.current == state::queued);
+            entry.current = state::running;
+            entry.notified = false;
+            lock.unlock();
+            const auto result = entry.run(id);
+            step_count_.fetch_add(1, std::memory_order_relaxed);
+            lock.lock();
+            switch (result) {
+                case step::progress:
+                    entry.current = state::queued;
+                    dispatch(id, lock);
+                    break;
+                case step::blocked:
+                    block_count_.fetch_add(1, std::memory_order_relaxed);
+                    // notified while running, wake-up must not be lost
+                    entry.current = std::exchange(entry.notified, false) ? state::queued : state::blocked;
+                    if (entry.current == state::queued) {
+                        dispatch(id, lock);
+                    }
+                    break;
+                case step::finished:
+                    entry.current = state::finished;
+                    entry.run = nullptr;
+                    if (--running_count_ == 0) {
+                        finish_condition_.notify_all();
+                    }
+                    break;
+            }
+        }
+    };
+}
@@ -2,6 +2,8 @@
 #include "command.h"
 #include "media.h"
 #include "context.h"
+#include "tile.transcoder.h"
+#include "command.manifest.h"
 #include "core/core.h"
 #include "core/exception.hpp"
 #include "core/verify.hpp"
@@ -14,8 +16,12 @@
 #include <re2/re2.h>
 #include <fmt/format.h>
 #include <folly/Lazy.h>
+#include <folly/ScopeGuard.h>
 #include <folly/String.h>
-#include <range/v3/view/iota.hpp>
+#include <folly/executors/ThreadPoolExecutor.h>
+#include <folly/futures/Future.h>
+#include <folly/futures/FutureSplitter.h>
+#include <mutex>
 #include <numeric>
 
 using boost::process::system;
@@ -91,7 +97,7 @@ namespace media
         if (const auto regex_iter = cache_mesh_regex.find(cache_key); regex_iter != cache_mesh_regex.end()) {
             return (regex_iter->second);
         }
-        const auto regex_content = fmt::format(R"({}x{}_qp(\d+))", filter.wcrop, filter.hcrop);
+        const auto regex_content = fmt::format(R"({}x{}_(?:qp)?(\d+))", filter.wcrop, filter.hcrop);
         return (cache_mesh_regex.try_emplace(cache_key, regex_content)
                                 .first->second);
     };
@@ -106,7 +112,7 @@ namespace media
     };
 
     auto tile_mpd_coordinate = [](std::string_view filename) {
-        static const RE2 mpd_regex{ R"(\w+_c(\d+)r(\d+)_qp\d+.mpd)" };
+        static const RE2 mpd_regex{ R"(\w+_c(\d+)r(\d+)_(?:qp\d+|\d+kbps).mpd)" };
         auto col = 0, row = 0;
         if (RE2::FullMatch(filename.data(), mpd_regex, &col, &row)) {
             return std::make_pair(col, row);
@@ -162,93 +168,228 @@ namespace media
             });
     };
 
-    void command::crop_scale_transcode(const std::filesystem::path input,
-                                       const rate_control rate,
-                                       const pace_control pace) {
-        if (pace.offset < wcrop * hcrop) {
-            std::vector<std::string> cmd_params{ "ffmpeg", "-i", input.string() };
-            std::string crop_scale_map;
-            {
-                const auto [width, height] = media::format_context{
-                    media::source::path{ input.string().data() }
-                }.demux(media::type::video).scale();
-                const auto scale = fmt::format("scale={}:{}",
-                                               ceil_even(width / wcrop / wscale),
-                                               ceil_even(height / hcrop / hscale));
-                for (auto i = 0; i != wcrop; ++i) {
-                    for (auto j = 0; j != hcrop; ++j) {
-                        if (i * hcrop + j < pace.offset || i * hcrop + j >= pace.offset + pace.stride) {
-                            continue;
-                        }
-                        const auto crop = fmt::format("crop={}:{}:{}:{}",
-                                                      width / wcrop, height / hcrop,
-                                                      width * i / wcrop, height * j / hcrop);
-                        crop_scale_map += fmt::format("[0:v]{},{}[v{}:{}];", crop, scale, i, j);
-                    }
-                }
-                crop_scale_map.pop_back();
+    // external command of one graph node, outputs are skipped when fresh in manifest of their mesh
+    struct command_step final
+    {
+        std::filesystem::path manifest_directory;
+        std::vector<std::filesystem::path> outputs;
+        std::vector<std::filesystem::path> inputs;
+        std::string command_line;
+        // files written beside outputs under names known only after command ran
+        folly::Function<std::vector<std::filesystem::path>() const> products;
+    };
+
+    // pool follows command::concurrency at every use, workers are resized in place so
+    // steps already queued keep their executor
+    auto command_executor = []() -> folly::Executor* {
+        static std::mutex mutex;
+        static std::shared_ptr<folly::ThreadPoolExecutor> executor;
+        const auto concurrency = command::concurrency > 0 ? command::concurrency : command::default_concurrency;
+        std::lock_guard<std::mutex> lock{ mutex };
+        if (executor == nullptr) {
+            executor = core::make_pool_executor(static_cast<int>(concurrency), "MediaCommand");
+        } else if (executor->numThreads() != concurrency) {
+            executor->setNumThreads(concurrency);
+        }
+        return executor.get();
+    };
+
+    // resolves false if every output was fresh and the command was not run
+    auto schedule_step = [](command_step step) {
+        return folly::via(command_executor(), [step = std::move(step)] {
+            auto& manifest = command_manifest::of(step.manifest_directory);
+            if (std::all_of(step.outputs.begin(), step.outputs.end(),
+                            [&manifest, &step](const std::filesystem::path& output) {
+                                return manifest.fresh(output, step.inputs, step.command_line);
+                            })) {
+                return false;
             }
-            cmd_params.emplace_back(fmt::format("-filter_complex \"{}\"", crop_scale_map));
-            const auto [file_stem, file_output_dir] = output_h264_directory(input.string(),
-                                                                            mesh_description({ wcrop, hcrop }, rate));
-            {
-                auto make_success = false;
-                if (pace.offset) {
-                    make_success = create_directories(file_output_dir);
-                } else {
-                    std::tie(std::ignore, make_success) = core::make_empty_directory(file_output_dir);
-                    assert(make_success);
-                }
+            if (system(step.command_line) != 0) {
+                core::aborted_error::throw_directly();
+            }
+            const auto products = step.products ? step.products() : std::vector<std::filesystem::path>{};
+            for (auto& output : step.outputs) {
+                manifest.record(output, step.inputs, step.command_line, products);
             }
-            const auto crop_tile_path = [&file_stem, &file_output_dir, &rate](int i, int j) {
-                return (file_output_dir / fmt::format("{}_c{}r{}_{}kbps.264", file_stem, i, j, rate.bit_rate)).generic_string();
-            };
+            return true;
+        });
+    };
+
+    // blocks until every step settles, rethrows first failure
+    auto wait_steps = [](std::vector<folly::Future<bool>>& steps) {
+        const auto results = folly::collectAll(steps).get();
+        for (auto& result : results) {
+            result.throwIfFailed();
+        }
+        return std::count_if(results.begin(), results.end(),
+                             [](const folly::Try<bool>& result) {
+                                 return result.value();
+                             });
+    };
+
+    auto transcode_steps = [](const std::filesystem::path& input,
+                              const rate_control rate,
+                              const command::pace_control pace) {
+        const auto wcrop = command::wcrop;
+        const auto hcrop = command::hcrop;
+        const auto [width, height] = media::format_context{
+            media::source::path{ input.string().data() }
+        }.demux(media::type::video).scale();
+        const auto scale = fmt::format("scale={}:{}",
+                                       ceil_even(width / wcrop / command::wscale),
+                                       ceil_even(height / hcrop / command::hscale));
+        const auto file_stem = input.stem().generic_string();
+        const auto file_output_dir = output_h264_directory(input.string(),
+                                                           mesh_description({ wcrop, hcrop }, rate)).second;
+        create_directories(file_output_dir);
+        std::vector<command_step> steps;
+        for (auto offset = pace.offset; offset < wcrop * hcrop; offset += pace.stride) {
+            command_step step{ file_output_dir.parent_path(), {}, { input }, {} };
+            std::string crop_scale_map;
+            std::vector<std::string> output_params;
             for (auto i = 0; i != wcrop; ++i) {
                 for (auto j = 0; j != hcrop; ++j) {
-                    if (i * hcrop + j < pace.offset || i * hcrop + j >= pace.offset + pace.stride) {
+                    if (i * hcrop + j < offset || i * hcrop + j >= offset + pace.stride) {
                         continue;
                     }
-                    cmd_params.emplace_back(fmt::format("-map [v{}:{}]", i, j));
-                    cmd_params.emplace_back("-c:v libx264");
-                    cmd_params.emplace_back("-preset slow");
-                    cmd_params.emplace_back("-x264-params");
-                    cmd_params.emplace_back(x264_encode_param(rate));
-                    cmd_params.emplace_back("-f h264");
-                    cmd_params.emplace_back(crop_tile_path(i, j));
+                    const auto crop = fmt::format("crop={}:{}:{}:{}",
+                                                  width / wcrop, height / hcrop,
+                                                  width * i / wcrop, height * j / hcrop);
+                    crop_scale_map += fmt::format("[0:v]{},{}[v{}:{}];", crop, scale, i, j);
+                    step.outputs.push_back(
+                        file_output_dir / fmt::format("{}_c{}r{}_{}kbps.264", file_stem, i, j, rate.bit_rate));
+                    output_params.emplace_back(fmt::format("-map [v{}:{}]", i, j));
+                    output_params.emplace_back("-c:v libx264");
+                    output_params.emplace_back("-preset slow");
+                    output_params.emplace_back("-x264-params");
+                    output_params.emplace_back(x264_encode_param(rate));
+                    output_params.emplace_back("-f h264");
+                    output_params.emplace_back(step.outputs.back().generic_string());
                 }
             }
+            crop_scale_map.pop_back();
+            std::vector<std::string> cmd_params{ "ffmpeg", "-i", input.string() };
+            cmd_params.emplace_back(fmt::format("-filter_complex \"{}\"", crop_scale_map));
+            std::move(output_params.begin(), output_params.end(), std::back_inserter(cmd_params));
             cmd_params.emplace_back("-y");
-            system(folly::join(' ', cmd_params));
-            crop_scale_transcode(input, rate, { pace.stride, pace.offset + pace.stride });
+            step.command_line = folly::join(' ', cmd_params);
+            steps.push_back(std::move(step));
         }
+        return steps;
+    };
+
+    // mp4box appends tracks to an existing file, -new recreates it when inputs changed
+    auto package_step = [](const std::filesystem::path& h264_path, const rate_control rate) {
+        const auto mesh_directory = h264_path.parent_path().parent_path();
+        auto mp4_path = (mesh_directory / "mp4" / h264_path.filename()).replace_extension(".mp4");
+        create_directories(mp4_path.parent_path());
+        auto command_line = folly::join(' ', std::vector<std::string>{
+                                            mp4box_path().string(),
+                                            "-add", h264_path.generic_string(),
+                                            "-fps", fmt::to_string(rate.frame_rate),
+                                            "-new", mp4_path.generic_string()
+                                        });
+        return command_step{ mesh_directory, { std::move(mp4_path) }, { h264_path }, std::move(command_line) };
+    };
+
+    auto dash_step = [](const std::filesystem::path& mp4_path,
+                        const std::filesystem::path& dash_directory,
+                        const std::chrono::milliseconds duration) {
+        create_directories(dash_directory);
+        auto dash_path = (dash_directory / mp4_path.filename()).replace_extension(".mpd");
+        std::vector<std::string> cmd_params{ "mp4box" };
+        cmd_params.emplace_back(fmt::format("-dash {}", duration.count()));
+        cmd_params.emplace_back(fmt::format("-frag {}", duration.count()));
+        cmd_params.emplace_back("-profile live");
+        cmd_params.emplace_back("-rap");
+        cmd_params.emplace_back(fmt::format("-out {}", dash_path.generic_string()));
+        cmd_params.emplace_back(mp4_path.generic_string());
+        // init and media segments are named after mp4 stem, a deleted segment makes mpd stale
+        auto segment_prefix = mp4_path.stem().string() + "_dash";
+        return command_step{
+            dash_directory.parent_path(), { std::move(dash_path) }, { mp4_path }, folly::join(' ', cmd_params),
+            [dash_directory, segment_prefix = std::move(segment_prefix)] {
+                return core::filter_directory_entry(
+                    dash_directory,
+                    [&segment_prefix](const std::filesystem::directory_entry& entry) {
+                        return entry.is_regular_file()
+                            && entry.path().filename().string().rfind(segment_prefix, 0) == 0;
+                    });
+            }
+        };
+    };
+
+    auto tile_mp4_path = [](const std::filesystem::path& input, const tile_transcoder::tile& position) {
+        const auto file_stem = input.stem().string();
+        return output_mp4_directory(input.string(), mesh_description({ command::wcrop, command::hcrop }, position.qp))
+               .second / fmt::format("{}_c{}r{}_qp{}.mp4", file_stem, position.col, position.row, position.qp);
+    };
+
+    auto tile_transcode_params = [](const int qp) {
+        return fmt::format("tile_transcoder crop={}x{} qp={}", command::wcrop, command::hcrop, qp);
+    };
+
+    void command::crop_scale_transcode(const std::filesystem::path input,
+                                       const rate_control rate,
+                                       const pace_control pace) {
+        std::vector<folly::Future<bool>> steps;
+        for (auto& step : transcode_steps(input, rate, pace)) {
+            steps.push_back(schedule_step(std::move(step)));
+        }
+        wait_steps(steps);
     }
 
     void command::crop_scale_package(std::filesystem::path input, int qp) {
-        for (auto row : ranges::view::ints(0, hcrop)) {
-            for (auto col : ranges::view::ints(0, wcrop)) {
-                std::vector<std::string> cmd_params{
-                    ffmpeg_path().string(), fmt::format("-i {}", input.string())
-                };
-                auto iw = fmt::format("iw/{}", wcrop);
-                auto ih = fmt::format("ih/{}", hcrop);
-                cmd_params.emplace_back(fmt::format("-vf crop={}:{}:{}*{}:{}*{}",
-                                                    iw, ih, col, iw, row, ih));
-                cmd_params.emplace_back("-c:v libx264");
-                cmd_params.emplace_back(fmt::format("-qp {}", qp));
-                cmd_params.emplace_back("-x264-params keyint=30:min-keyint=30:scenecut=0:no-scenecut=1");
-                cmd_params.emplace_back("-an");
-                cmd_params.emplace_back("-f mp4");
-                const auto [file_stem, file_output_dir] = output_mp4_directory(
-                    input.string(), mesh_description({ wcrop, hcrop }, qp));
-                create_directories(file_output_dir);
-                const auto filename = fmt::format("{}_c{}r{}_qp{}.mp4", input.stem().string(), col, row, qp);
-                cmd_params.emplace_back((file_output_dir / filename).string());
-                cmd_params.emplace_back("-y");
-                const auto cmd = folly::join(' ', cmd_params);
-                system(cmd);
+        crop_scale_package(std::move(input), std::vector<int>{ qp });
+    }
+
+    void command::crop_scale_package(std::filesystem::path input,
+                                     std::vector<int> qp_ladder,
+                                     unsigned concurrency) {
+        const auto tile_positions = [](const int qp) {
+            std::vector<tile_transcoder::tile> positions;
+            for (auto row = 0; row < hcrop; ++row) {
+                for (auto col = 0; col < wcrop; ++col) {
+                    positions.push_back({ col, row, qp });
+                }
+            }
+            return positions;
+        };
+        const auto manifest_directory = [&input](const tile_transcoder::tile& position) {
+            return tile_mp4_path(input, position).parent_path().parent_path();
+        };
+        // a qp already packaged from unchanged input is left out of the decode entirely
+        const auto ladder_end = std::remove_if(
+            qp_ladder.begin(), qp_ladder.end(),
+            [&](const int qp) {
+                const auto positions = tile_positions(qp);
+                return std::all_of(positions.begin(), positions.end(),
+                                   [&](const tile_transcoder::tile& position) {
+                                       return command_manifest::of(manifest_directory(position))
+                                           .fresh(tile_mp4_path(input, position), { input },
+                                                  tile_transcode_params(qp));
+                                   });
+            });
+        qp_ladder.erase(ladder_end, qp_ladder.end());
+        if (qp_ladder.empty()) {
+            return;
+        }
+        tile_transcoder transcoder{
+            input, wcrop, hcrop, qp_ladder,
+            [&input](const tile_transcoder::tile& position) {
+                auto tile_path = tile_mp4_path(input, position);
+                create_directories(tile_path.parent_path());
+                return tile_path;
+            },
+            concurrency
+        };
+        transcoder.transcode();
+        for (const auto qp : qp_ladder) {
+            for (auto& position : tile_positions(qp)) {
+                command_manifest::of(manifest_directory(position))
+                    .record(tile_mp4_path(input, position), { input }, tile_transcode_params(qp));
             }
         }
-
     }
 
     auto mesh_rate_directory = [](const filter_param filter) {
@@ -272,69 +413,100 @@ namespace media
     };
 
     void command::package_container(const rate_control rate) {
+        std::vector<folly::Future<bool>> steps;
         for (auto& mesh_entry : mesh_rate_directory({ wcrop, hcrop })) {
             assert(is_directory(mesh_entry));
             const auto h264_directory = mesh_entry / "h264";
-            const auto mp4_directory = mesh_entry / "mp4";
             assert(is_directory(h264_directory));
-            const auto [remove_count, make_success] = core::make_empty_directory(mp4_directory);
-            assert(make_success);
             for (auto& h264_entry : std::filesystem::directory_iterator{ h264_directory }) {
-                auto h264_path = h264_entry.path();
-                assert(h264_path.extension() == ".264");
-                auto mp4_path = (mp4_directory / h264_path.filename()).replace_extension(".mp4");
-                system(
-                    exe = mp4box_path(),
-                    args = {
-                        "-add", h264_path.generic_string(),
-                        "-fps", fmt::to_string(rate.frame_rate),
-                        mp4_path.generic_string()
-                    }
-                );
+                assert(h264_entry.path().extension() == ".264");
+                steps.push_back(schedule_step(package_step(h264_entry.path(), rate)));
             }
         }
+        wait_steps(steps);
     }
 
     void command::dash_segment(const std::chrono::milliseconds duration) {
-
+        std::vector<folly::Future<bool>> steps;
         for (auto& mesh_path : mesh_qp_directory({ wcrop, hcrop })) {
             assert(is_directory(mesh_path));
             const auto mp4_directory = mesh_path / "mp4";
-            const auto dash_directory = mesh_path / "dash";
             assert(is_directory(mp4_directory));
-            const auto [remove_count, make_success] = core::make_empty_directory(dash_directory);
-            assert(make_success);
             for (auto& mp4_entry : std::filesystem::directory_iterator{ mp4_directory }) {
-                auto mp4_path = mp4_entry.path();
-                assert(std::filesystem::is_regular_file(mp4_path));
-                assert(mp4_path.extension() == ".mp4");
-                auto dash_path = (dash_directory / mp4_path.filename()).replace_extension(".mpd");
-                std::vector<std::string> cmd_params{ "mp4box" };
-                cmd_params.emplace_back(fmt::format("-dash {}", duration.count()));
-                cmd_params.emplace_back(fmt::format("-frag {}", duration.count()));
-                cmd_params.emplace_back("-profile live");
-                cmd_params.emplace_back("-rap");
-                cmd_params.emplace_back(fmt::format("-out {}", dash_path.generic_string()));
-                cmd_params.emplace_back(mp4_path.generic_string());
-                system(folly::join(' ', cmd_params));
+                assert(std::filesystem::is_regular_file(mp4_entry.path()));
+                assert(mp4_entry.path().extension() == ".mp4");
+                steps.push_back(schedule_step(dash_step(mp4_entry.path(), mesh_path / "dash", duration)));
             }
         }
+        wait_steps(steps);
     }
 
     void command::dash_segment(std::filesystem::path input,
                                std::chrono::milliseconds duration) {
         assert(std::filesystem::is_regular_file(input));
         assert(input.extension() == ".mp4");
-        auto dash_path = std::filesystem::path{ input }.replace_extension(".mpd");
-        std::vector<std::string> cmd_params{ "mp4box" };
-        cmd_params.emplace_back(fmt::format("-dash {}", duration.count()));
-        cmd_params.emplace_back(fmt::format("-frag {}", duration.count()));
-        cmd_params.emplace_back("-profile live");
-        cmd_params.emplace_back("-rap");
-        cmd_params.emplace_back(fmt::format("-out {}", dash_path.generic_string()));
-        cmd_params.emplace_back(input.generic_string());
-        system(folly::join(' ', cmd_params));
+        std::vector<folly::Future<bool>> steps;
+        steps.push_back(schedule_step(dash_step(input, input.parent_path(), duration)));
+        wait_steps(steps);
+    }
 
+    // mesh directories of input live under its stem, merge resolves them from output directory
+    auto merge_input_dash_mpd = [](const std::filesystem::path& input) {
+        const auto root_directory = std::exchange(command::output_directory,
+                                                  output_file_directory(input.string()));
+        const auto restore_directory = folly::makeGuard([&root_directory] {
+            command::output_directory = root_directory;
+        });
+        return command::merge_dash_mpd();
+    };
+
+    std::filesystem::path command::package_rate_ladder(std::filesystem::path input,
+                                                       std::vector<rate_control> rates,
+                                                       std::chrono::milliseconds duration,
+                                                       pace_control pace) {
+        // transcode -> package -> dash per tile, a tile waits only for the stride producing it
+        std::vector<folly::Future<bool>> steps;
+        for (const auto rate : rates) {
+            for (auto& transcode : transcode_steps(input, rate, pace)) {
+                const auto h264_paths = transcode.outputs;
+                folly::FutureSplitter<bool> transcoded{ schedule_step(std::move(transcode)) };
+                for (auto& h264_path : h264_paths) {
+                    steps.push_back(
+                        transcoded.getSemiFuture()
+                                  .via(command_executor())
+                                  .thenValue([h264_path, rate](bool) {
+                                      return schedule_step(package_step(h264_path, rate));
+                                  })
+                                  .thenValue([h264_path, duration](bool) {
+                                      const auto mesh_directory = h264_path.parent_path().parent_path();
+                                      const auto mp4_path = (mesh_directory / "mp4" / h264_path.filename())
+                                          .replace_extension(".mp4");
+                                      return schedule_step(dash_step(mp4_path, mesh_directory / "dash", duration));
+                                  }));
+                }
+            }
+        }
+        wait_steps(steps);
+        return merge_input_dash_mpd(input);
+    }
+
+    std::filesystem::path command::package_qp_ladder(std::filesystem::path input,
+                                                     std::vector<int> qp_ladder,
+                                                     std::chrono::milliseconds duration) {
+        auto ladder = qp_ladder;
+        crop_scale_package(input, std::move(ladder));
+        std::vector<folly::Future<bool>> steps;
+        for (const auto qp : qp_ladder) {
+            for (auto row = 0; row < hcrop; ++row) {
+                for (auto col = 0; col < wcrop; ++col) {
+                    const auto mp4_path = tile_mp4_path(input, { col, row, qp });
+                    steps.push_back(schedule_step(
+                        dash_step(mp4_path, mp4_path.parent_path().parent_path() / "dash", duration)));
+                }
+            }
+        }
+        wait_steps(steps);
+        return merge_input_dash_mpd(input);
     }
 
     using tinyxml2::XMLNode;
@@ -1,5 +1,6 @@
 #pragma once
 #include <filesystem>
+#include <vector>
 
 namespace media
 {
@@ -38,6 +39,10 @@ namespace media
         static inline auto hcrop = 0;
         static inline auto wscale = 1;
         static inline auto hscale = 1;
+        // workers running external commands, read at every schedule, 0 picks default,
+        // ffmpeg and mp4box are multithreaded themselves so few workers saturate cores
+        static inline auto concurrency = 0u;
+        static constexpr inline auto default_concurrency = 2u;
 
         static void resize(std::string_view input,
                            size_param size);
@@ -49,6 +54,11 @@ namespace media
         static void crop_scale_package(std::filesystem::path input,
                                        int qp);
 
+        // decodes input once per pass of qp rungs, every tile of every qp in a pass is encoded in parallel
+        static void crop_scale_package(std::filesystem::path input,
+                                       std::vector<int> qp_ladder,
+                                       unsigned concurrency = 0);
+
         static void package_container(rate_control rate);
 
         static void dash_segment(std::chrono::milliseconds duration);
@@ -59,5 +69,15 @@ namespace media
         static std::filesystem::path merge_dash_mpd();
 
         static std::vector<std::filesystem::path> tile_path_list();
+
+        // transcode -> package -> dash -> merge graph, outputs fresh in mesh manifest are skipped
+        static std::filesystem::path package_rate_ladder(std::filesystem::path input,
+                                                         std::vector<rate_control> rates,
+                                                         std::chrono::milliseconds duration,
+                                                         pace_control pace = {});
+
+        static std::filesystem::path package_qp_ladder(std::filesystem::path input,
+                                                       std::vector<int> qp_ladder,
+                                                       std::chrono::milliseconds duration);
     };
 }
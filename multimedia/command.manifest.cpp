@@ -0,0 +1,124 @@
+#include "stdafx.h"
+#include "command.manifest.h"
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <memory>
+
+namespace media
+{
+    namespace
+    {
+        // null for missing input, never equal to a recorded one
+        auto input_fingerprint = [](const std::filesystem::path& input) {
+            std::error_code error;
+            const auto size = std::filesystem::file_size(input, error);
+            if (error) {
+                return nlohmann::json{};
+            }
+            const auto write_time = std::filesystem::last_write_time(input, error);
+            if (error) {
+                return nlohmann::json{};
+            }
+            return nlohmann::json{
+                { "path", input.generic_string() },
+                { "size", size },
+                { "mtime", write_time.time_since_epoch().count() },
+            };
+        };
+
+        auto input_fingerprints = [](const std::vector<std::filesystem::path>& inputs) {
+            auto fingerprints = nlohmann::json::array();
+            for (auto& input : inputs) {
+                fingerprints.push_back(input_fingerprint(input));
+            }
+            return fingerprints;
+        };
+    }
+
+    command_manifest::command_manifest(std::filesystem::path path)
+        : path_{ std::move(path) }
+        , document_(nlohmann::json::object()) {
+        if (std::ifstream manifest_stream{ path_ }; manifest_stream.is_open()) {
+            try {
+                manifest_stream >> document_;
+            } catch (const nlohmann::json::exception&) {
+                document_ = nlohmann::json::object();
+            }
+        }
+        if (!document_.is_object()) {
+            document_ = nlohmann::json::object();
+        }
+    }
+
+    bool command_manifest::fresh(const std::filesystem::path& output,
+                                 const std::vector<std::filesystem::path>& inputs,
+                                 const std::string_view params) const {
+        if (!std::filesystem::exists(output)) {
+            return false;
+        }
+        const auto fingerprints = input_fingerprints(inputs);
+        if (std::any_of(fingerprints.begin(), fingerprints.end(),
+                        [](const nlohmann::json& fingerprint) {
+                            return fingerprint.is_null();
+                        })) {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock{ mutex_ };
+        const auto entry = document_.find(output.generic_string());
+        if (entry == document_.end()
+            || entry->value("params", std::string{}) != params
+            || entry->value("inputs", nlohmann::json{}) != fingerprints) {
+            return false;
+        }
+        const auto products = entry->value("products", nlohmann::json::array());
+        return std::all_of(products.begin(), products.end(),
+                           [](const nlohmann::json& product) {
+                               return product.is_object()
+                                   && input_fingerprint(product.value("path", std::string{})) == product;
+                           });
+    }
+
+    void command_manifest::record(const std::filesystem::path& output,
+                                  const std::vector<std::filesystem::path>& inputs,
+                                  const std::string_view params,
+                                  const std::vector<std::filesystem::path>& products) {
+        auto fingerprints = input_fingerprints(inputs);
+        auto product_fingerprints = input_fingerprints(products);
+        std::lock_guard<std::mutex> lock{ mutex_ };
+        document_[output.generic_string()] = {
+            { "params", std::string{ params } },
+            { "inputs", std::move(fingerprints) },
+            { "products", std::move(product_fingerprints) },
+        };
+        // replaced by rename so a reader never sees a half written manifest
+        auto temp_path = path_;
+        temp_path += ".tmp";
+        {
+            std::ofstream manifest_stream{ temp_path, std::ios::trunc };
+            manifest_stream << document_.dump(2);
+        }
+        std::filesystem::rename(temp_path, path_);
+    }
+
+    void command_manifest::invalidate(const std::filesystem::path& output) {
+        std::lock_guard<std::mutex> lock{ mutex_ };
+        document_.erase(output.generic_string());
+    }
+
+    const std::filesystem::path& command_manifest::path() const noexcept {
+        return path_;
+    }
+
+    command_manifest& command_manifest::of(const std::filesystem::path& directory) {
+        static std::mutex mutex;
+        static std::map<std::string, std::unique_ptr<command_manifest>> manifests;
+        auto manifest_path = (directory / default_filename).lexically_normal();
+        std::lock_guard<std::mutex> lock{ mutex };
+        auto& manifest = manifests[manifest_path.generic_string()];
+        if (manifest == nullptr) {
+            manifest = std::make_unique<command_manifest>(std::move(manifest_path));
+        }
+        return *manifest;
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <nlohmann/json.hpp>
+#include <filesystem>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+namespace media
+{
+    // records which inputs and parameters every command output was produced from, stored as
+    // json beside the outputs so a rerun skips the outputs whose inputs are unchanged
+    class command_manifest final
+    {
+        const std::filesystem::path path_;
+        mutable std::mutex mutex_;
+        nlohmann::json document_;
+
+    public:
+        static constexpr inline std::string_view default_filename = "manifest.json";
+
+        explicit command_manifest(std::filesystem::path path);
+        command_manifest(const command_manifest&) = delete;
+        command_manifest(command_manifest&&) = delete;
+        command_manifest& operator=(const command_manifest&) = delete;
+        command_manifest& operator=(command_manifest&&) = delete;
+        ~command_manifest() = default;
+
+        // output exists, every input keeps size and last write time it was produced from
+        // and every product recorded beside output is still in place unchanged
+        bool fresh(const std::filesystem::path& output,
+                   const std::vector<std::filesystem::path>& inputs,
+                   std::string_view params) const;
+
+        // persisted immediately, a crash between outputs only redoes the unfinished ones,
+        // products are files the command wrote beside output whose names are known only
+        // after it ran, like dash segments of a manifest
+        void record(const std::filesystem::path& output,
+                    const std::vector<std::filesystem::path>& inputs,
+                    std::string_view params,
+                    const std::vector<std::filesystem::path>& products = {});
+
+        void invalidate(const std::filesystem::path& output);
+
+        const std::filesystem::path& path() const noexcept;
+
+        // one shared instance per directory, steps of a graph may record concurrently
+        static command_manifest& of(const std::filesystem::path& directory);
+    };
+}
@@ -2,8 +2,11 @@
 #include "context.h"
 #include "core/core.h"
 #include "core/verify.hpp"
+#include <map>
+#include <mutex>
 
 extern "C" {
+#include <libavutil/mathematics.h>
 #include <libavutil/opt.h>
 }
 
@@ -11,25 +14,91 @@ namespace media
 {
     using namespace detail;
 
+    namespace
+    {
+        class staging_page_pool final
+        {
+            std::mutex mutex_;
+            std::multimap<size_t, uint8_t*> pages_;
+            size_t pooled_size_ = 0;
+
+        public:
+            static constexpr size_t max_pooled_size = 64 * 1024 * 1024;
+
+            staging_page_pool() = default;
+            staging_page_pool(const staging_page_pool&) = delete;
+            staging_page_pool& operator=(const staging_page_pool&) = delete;
+
+            ~staging_page_pool() {
+                for (auto& [size, page] : pages_) {
+                    av_free(page);
+                }
+            }
+
+            std::pair<uint8_t*, size_t> acquire(size_t size) {
+                {
+                    std::lock_guard<std::mutex> lock{ mutex_ };
+                    const auto page_iter = pages_.lower_bound(size);
+                    if (page_iter != pages_.end() && page_iter->first <= size * 2) {
+                        const auto page = *page_iter;
+                        pages_.erase(page_iter);
+                        pooled_size_ -= page.first;
+                        return { page.second, page.first };
+                    }
+                }
+                return { static_cast<uint8_t*>(av_malloc(size)), size };
+            }
+
+            void release(uint8_t* page, size_t size) {
+                {
+                    std::lock_guard<std::mutex> lock{ mutex_ };
+                    if (pooled_size_ + size <= max_pooled_size) {
+                        pages_.emplace(size, page);
+                        pooled_size_ += size;
+                        return;
+                    }
+                }
+                av_free(page);
+            }
+        };
+
+        staging_page_pool& staging_pages() {
+            static staging_page_pool pool;
+            return pool;
+        }
+    }
+
     void io_context::deleter::operator()(pointer context) const {
+        // avio may have replaced the page while probing, the original one is freed then
+        if (pooled && context->buffer == page) {
+            staging_pages().release(std::exchange(context->buffer, nullptr), page_size);
+        }
         av_freep(&context->buffer);
         av_freep(&context);
     }
 
-    io_context::io_context(std::unique_ptr<io_base> io)
-        : io_base_{ std::move(io) }
-        , io_handle_{
-              avio_alloc_context(
-                  static_cast<uint8_t*>(av_malloc(default_cache_page_size)),
-                  default_cache_page_size, default_buffer_writable,
-                  io_base_.get(),
-                  io_base_->readable() ? on_read_buffer : nullptr,
-                  io_base_->writable() ? on_write_buffer : nullptr,
-                  io_base_->seekable() ? on_seek_stream : nullptr),
-              deleter{}
-          } {
+    io_context::io_context(std::unique_ptr<io_base> io, bool direct_access, page_policy policy)
+        : io_base_{ std::move(io) } {
         assert(io_base_ != nullptr);
+        // direct reads skip the page, a larger page only adds copies then
+        assert(!direct_access || policy == page_policy::fixed);
+        const auto pooled = policy == page_policy::staging;
+        const auto expect_size = page_size(*io_base_, policy);
+        const auto [page, size] = pooled
+                                      ? staging_pages().acquire(expect_size)
+                                      : std::make_pair(static_cast<uint8_t*>(av_malloc(expect_size)), expect_size);
+        io_handle_ = {
+            avio_alloc_context(
+                page, folly::to<int>(size), default_buffer_writable,
+                io_base_.get(),
+                io_base_->readable() ? on_read_buffer : nullptr,
+                io_base_->writable() ? on_write_buffer : nullptr,
+                io_base_->seekable() ? on_seek_stream : nullptr),
+            deleter{ page, size, pooled }
+        };
         assert(io_handle_ != nullptr);
+        // avio_read bypasses the cache page, demuxer reads packet payload straight from cursor
+        io_handle_->direct = direct_access ? 1 : 0;
     }
 
     io_context::io_context(read_context&& read, write_context&& write, seek_context&& seek)
@@ -59,22 +128,48 @@ namespace media
     }
 
     void format_context::deleter::operator()(pointer context) const {
-        avformat_close_input(&context);
+        if (context->oformat == nullptr) {
+            avformat_close_input(&context);
+            return;
+        }
+        if (!(context->oformat->flags & AVFMT_NOFILE)) {
+            avio_closep(&context->pb);
+        }
+        avformat_free_context(context);
     }
 
-    format_context::format_context(io_context& io, source::format iformat)
-        : io_handle_(io) {
+    auto open_input = [](io_context& io, source::format iformat) {
         auto format = avformat_alloc_context();
-        format->pb = io_handle_.get().operator->();
+        format->pb = io.operator->();
         [[maybe_unused]] const auto success =
             avformat_open_input(&format, nullptr,
                                 iformat.empty() ? nullptr : av_find_input_format(iformat.data()), nullptr);
         assert(success == 0);
         assert(format != nullptr);
+        return format;
+    };
+
+    format_context::format_context(io_context& io, source::format iformat)
+        : io_handle_(io) {
+        const auto format = open_input(io, iformat);
         format_handle_ = { format, deleter{} };
         core::verify(avformat_find_stream_info(format, nullptr));
     }
 
+    format_context::format_context(io_context& io, source::format iformat,
+                                   const codec_parameters& parameters)
+        : io_handle_(io) {
+        const auto format = open_input(io, iformat);
+        format_handle_ = { format, deleter{} };
+        // parameters come from the init segment of same representation, no need to decode for probing
+        std::for_each_n(format->streams, format->nb_streams,
+                        [&parameters](AVStream* stream) {
+                            if (stream->codecpar->codec_type == parameters->codec_type) {
+                                core::verify(avcodec_parameters_copy(stream->codecpar, parameters.operator->()));
+                            }
+                        });
+    }
+
     format_context::format_context(io_context& io, sink::format oformat)
         : io_handle_{ io } {
         core::not_implemented_error::throw_directly();
@@ -94,7 +189,12 @@ namespace media
 
     format_context::format_context(sink::path opath)
         : io_handle_{ core::make_null_reference_wrapper<io_context>() } {
-        core::not_implemented_error::throw_directly();
+        pointer format = nullptr;
+        core::verify(avformat_alloc_output_context2(&format, nullptr, nullptr, opath.data()));
+        format_handle_ = { format, deleter{} };
+        if (!(format->oformat->flags & AVFMT_NOFILE)) {
+            core::verify(avio_open(&format->pb, opath.data(), AVIO_FLAG_WRITE));
+        }
     }
 
     format_context::pointer format_context::operator->() const {
@@ -105,6 +205,27 @@ namespace media
         return io_base_ != nullptr && io_base_->available();
     }
 
+    bool io_context::direct_access() const noexcept {
+        return io_handle_ != nullptr && io_handle_->direct != 0;
+    }
+
+    size_t io_context::page_size() const noexcept {
+        return io_handle_ != nullptr ? io_handle_->buffer_size : 0;
+    }
+
+    size_t io_context::page_size(const io_base& cursor, page_policy policy) {
+        if (policy == page_policy::fixed || !cursor.sizable()) {
+            return default_cache_page_size;
+        }
+        const auto granularity = policy == page_policy::staging
+                                     ? staging_page_granularity
+                                     : default_cache_page_size;
+        const auto remain_size = folly::to<size_t>(std::max(cursor.remain_size(), 0i64));
+        const auto size = std::max((remain_size + granularity - 1) / granularity * granularity,
+                                   default_cache_page_size);
+        return policy == page_policy::adaptive ? std::min(size, max_cache_page_size) : size;
+    }
+
     format_context::operator bool() const {
         return format_handle_ != nullptr;
     }
@@ -156,12 +277,41 @@ namespace media
         return packets;
     }
 
+    stream format_context::mux(const codec_context& encoder) const {
+        const auto output_stream = avformat_new_stream(format_handle_.get(), nullptr);
+        core::verify(output_stream);
+        core::verify(avcodec_parameters_from_context(output_stream->codecpar, encoder.operator->()));
+        output_stream->time_base = encoder->time_base;
+        return stream{ output_stream };
+    }
+
+    bool format_context::global_header() const {
+        return format_handle_->oformat != nullptr
+            && (format_handle_->oformat->flags & AVFMT_GLOBALHEADER) != 0;
+    }
+
+    void format_context::write_header() const {
+        core::verify(avformat_write_header(format_handle_.get(), nullptr));
+    }
+
+    void format_context::write(const packet& compressed, const stream& target, AVRational time_base) const {
+        av_packet_rescale_ts(compressed.operator->(), time_base, target->time_base);
+        compressed->stream_index = target.index();
+        core::verify(av_interleaved_write_frame(format_handle_.get(), compressed.operator->()));
+    }
+
+    void format_context::write_trailer() const {
+        core::verify(av_write_trailer(format_handle_.get()));
+    }
+
     void codec_context::deleter::operator()(pointer context) const {
         avcodec_free_context(&context);
     }
 
-    codec_context::codec_context(codec codec, stream stream, unsigned threads)
-        : codec_handle_{
+    codec_context::codec_context(codec codec, stream stream, unsigned threads,
+                                 std::shared_ptr<frame_pool> pool)
+        : frame_pool_{ std::move(pool) }
+        , codec_handle_{
               avcodec_alloc_context3(core::get_pointer(codec)),
               deleter{}
           }
@@ -169,12 +319,39 @@ namespace media
         core::verify(avcodec_parameters_to_context(codec_handle_.get(), format_stream_->codecpar));
         core::verify(av_opt_set_int(codec_handle_.get(), "refcounted_frames", 1, 0));
         core::verify(av_opt_set_int(codec_handle_.get(), "threads", threads, 0));
+        if (frame_pool_) {
+            codec_handle_->opaque = frame_pool_.get();
+            codec_handle_->get_buffer2 = frame_pool::on_get_buffer;
+            codec_handle_->thread_safe_callbacks = 1;
+        }
         core::verify(avcodec_open2(codec_handle_.get(), core::get_pointer(codec), nullptr));
     }
 
-    codec_context::codec_context(format_context& format, type media_type, unsigned threads) {
+    codec_context::codec_context(format_context& format, type media_type, unsigned threads,
+                                 std::shared_ptr<frame_pool> pool) {
         auto [codec, stream] = format.demux_with_codec(media_type);
-        *this = codec_context{ codec, stream, threads };
+        *this = codec_context{ codec, stream, threads, std::move(pool) };
+    }
+
+    codec_context::codec_context(codec codec, const encode_param& param, unsigned threads)
+        : codec_handle_{
+            avcodec_alloc_context3(core::get_pointer(codec)),
+            deleter{}
+        } {
+        core::verify(codec_handle_.get());
+        codec_handle_->width = param.width;
+        codec_handle_->height = param.height;
+        codec_handle_->time_base = param.time_base;
+        codec_handle_->framerate = param.frame_rate;
+        codec_handle_->pix_fmt = param.pixel_format;
+        if (param.global_header) {
+            codec_handle_->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+        }
+        core::verify(av_opt_set_int(codec_handle_.get(), "threads", threads, 0));
+        for (auto& [name, value] : param.options) {
+            core::verify(av_opt_set(codec_handle_->priv_data, name.data(), value.data(), 0));
+        }
+        core::verify(avcodec_open2(codec_handle_.get(), core::get_pointer(codec), nullptr));
     }
 
     codec_context::pointer codec_context::operator->() const {
@@ -208,14 +385,36 @@ namespace media
         auto decode_start_time = absl::Now();
         core::verify(avcodec_send_packet(core::get_pointer(codec_handle_),
                                          core::get_pointer(packets)));
+        const auto stream_duration = [time_base = format_stream_->time_base](int64_t timestamp) {
+            if (timestamp == AV_NOPTS_VALUE) {
+                return absl::InfiniteDuration();
+            }
+            return absl::Microseconds(av_rescale_q(timestamp, time_base, AVRational{ 1, AV_TIME_BASE }));
+        };
         frame temp_frame;
         while (0 == avcodec_receive_frame(core::get_pointer(codec_handle_),
                                           core::get_pointer(temp_frame))) {
             temp_frame.process_duration(absl::Now() - decode_start_time);
+            temp_frame.presentation_time(stream_duration(temp_frame->best_effort_timestamp),
+                                         stream_duration(temp_frame->pkt_duration));
             full_frames.push_back(std::exchange(temp_frame, frame{}));
             decode_start_time = absl::Now();
         }
         dispose_count_ += full_frames.size();
         return full_frames;
     }
+
+    detail::vector<packet> codec_context::encode(const frame& picture) const {
+        const auto flushed = std::exchange(flushed_, picture.empty());
+        assert(!flushed);
+        core::verify(avcodec_send_frame(codec_handle_.get(),
+                                        picture.empty() ? nullptr : picture.operator->()));
+        detail::vector<packet> compressed_packets;
+        packet temp_packet;
+        while (0 == avcodec_receive_packet(codec_handle_.get(), core::get_pointer(temp_packet))) {
+            compressed_packets.push_back(std::exchange(temp_packet, packet{}));
+        }
+        dispose_count_ += compressed_packets.size();
+        return compressed_packets;
+    }
 }
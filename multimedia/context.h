@@ -1,8 +1,11 @@
 #pragma once
 #include "media.h"
 #include "io.cursor.h"
+#include "frame.pool.h"
 #include <boost/container/small_vector.hpp>
 #include <memory>
+#include <string>
+#include <vector>
 
 namespace media
 {
@@ -13,6 +16,10 @@ namespace media
 
         struct deleter final
         {
+            uint8_t* page = nullptr;
+            size_t page_size = 0;
+            bool pooled = false;
+
             void operator()(pointer context) const;
         };
 
@@ -20,8 +27,19 @@ namespace media
         std::unique_ptr<AVIOContext, deleter> io_handle_;
 
     public:
+        enum class page_policy
+        {
+            fixed,
+            adaptive,
+            staging
+        };
+
         static constexpr inline size_t default_cache_page_size = 4096;
+        static constexpr inline size_t max_cache_page_size = 256 * 1024;
+        static constexpr inline size_t staging_page_granularity = 64 * 1024;
         static constexpr inline bool default_buffer_writable = false;
+        static constexpr inline bool default_direct_access = false;
+        static constexpr inline page_policy default_page_policy = page_policy::fixed;
 
         io_context() = default;
         io_context(io_context const&) = default;
@@ -30,13 +48,19 @@ namespace media
         io_context& operator=(io_context const&) = default;
         io_context& operator=(io_context&&) noexcept = default;
 
-        explicit io_context(std::unique_ptr<io_base> io_cursor);
+        explicit io_context(std::unique_ptr<io_base> io_cursor,
+                            bool direct_access = default_direct_access,
+                            page_policy policy = default_page_policy);
         io_context(read_context&& read, write_context&& write, seek_context&& seek);
 
         pointer operator->() const;
         explicit operator bool() const;
 
         bool available() const noexcept;
+        bool direct_access() const noexcept;
+        size_t page_size() const noexcept;
+
+        static size_t page_size(const io_base& cursor, page_policy policy);
 
     private:
         static int on_read_buffer(void* opaque, uint8_t* buffer, int size);
@@ -44,6 +68,8 @@ namespace media
         static int64_t on_seek_stream(void* opaque, int64_t offset, int whence);
     };
 
+    class codec_context;
+
     class format_context final
     {
         using value_type = AVFormatContext;
@@ -59,6 +85,7 @@ namespace media
 
     public:
         format_context(io_context& io, source::format iformat);
+        format_context(io_context& io, source::format iformat, const codec_parameters& parameters);
         format_context(io_context& io, sink::format oformat);
         explicit format_context(source::path ipath);
         explicit format_context(sink::path opath);
@@ -75,6 +102,13 @@ namespace media
         std::pair<codec, stream> demux_with_codec(media::type media_type) const;
         packet read(media::type media_type) const;
         std::vector<packet> read(size_t count, media::type media_type) const;
+
+        // output stream carrying packets of encoder, header written after every stream muxed
+        stream mux(const codec_context& encoder) const;
+        bool global_header() const;
+        void write_header() const;
+        void write(const packet& compressed, const stream& target, AVRational time_base) const;
+        void write_trailer() const;
     };
 
     namespace detail
@@ -83,6 +117,18 @@ namespace media
         using vector = boost::container::small_vector<T, 1>;
     }
 
+    struct encode_param final
+    {
+        int width = 0;
+        int height = 0;
+        AVRational time_base{ 1, 30 };
+        AVRational frame_rate{ 30, 1 };
+        AVPixelFormat pixel_format = AV_PIX_FMT_YUV420P;
+        bool global_header = false;
+        // private options of encoder, e.g. qp and x264-params of libx264
+        std::vector<std::pair<std::string, std::string>> options;
+    };
+
     class codec_context final
     {
         using value_type = AVCodecContext;
@@ -94,14 +140,19 @@ namespace media
             void operator()(pointer context) const;
         };
 
+        // declared ahead of codec handle, decoder threads return buffers while closing
+        std::shared_ptr<frame_pool> frame_pool_;
         std::unique_ptr<AVCodecContext, deleter> codec_handle_;
         stream format_stream_;
         mutable int64_t dispose_count_ = 0;
         mutable bool flushed_ = false;
 
     public:
-        codec_context(codec codec, stream stream, unsigned threads);
-        codec_context(format_context& format, media::type type, unsigned threads);
+        codec_context(codec codec, stream stream, unsigned threads,
+                      std::shared_ptr<frame_pool> pool = nullptr);
+        codec_context(format_context& format, media::type type, unsigned threads,
+                      std::shared_ptr<frame_pool> pool = nullptr);
+        codec_context(codec codec, const encode_param& param, unsigned threads);
 
         codec_context() = default;
         codec_context(codec_context const&) = default;
@@ -115,5 +166,7 @@ namespace media
         int64_t dispose_count() const;
         int64_t frame_count() const;
         detail::vector<frame> decode(const packet& compressed) const;
+        // empty picture drains encoder
+        detail::vector<packet> encode(const frame& picture) const;
     };
 }
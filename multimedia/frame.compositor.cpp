@@ -0,0 +1,130 @@
+#include "stdafx.h"
+#include "frame.compositor.h"
+#include "media.h"
+#include "plane.kernel.h"
+#include "core/core.h"
+#include <folly/executors/ThreadPoolExecutor.h>
+#include <folly/synchronization/Baton.h>
+#include <algorithm>
+
+extern "C" {
+#include <libavutil/mem.h>
+}
+
+namespace media
+{
+    namespace
+    {
+        auto align_up = [](int size, int alignment) {
+            return (size + alignment - 1) / alignment * alignment;
+        };
+    }
+
+    void frame_compositor::planar_deleter::operator()(uint8_t* data) const {
+        av_free(data);
+    }
+
+    frame_compositor::frame_compositor(const int width, const int height, const unsigned band_count)
+        : width_{ width }
+        , height_{ height }
+        , band_count_{ std::clamp(band_count, 1u, static_cast<unsigned>(std::max(1, height / 2))) } {
+        assert(width > 0 && width % 2 == 0);
+        assert(height > 0 && height % 2 == 0);
+        for (size_t planar = 0; planar < planar_count; ++planar) {
+            linesizes_[planar] = align_up(planar_stretch(planar, width_), linesize_alignment);
+            const auto planar_size = static_cast<size_t>(linesizes_[planar]) * planar_stretch(planar, height_);
+            planars_[planar].reset(static_cast<uint8_t*>(av_mallocz(planar_size)));
+            if (planars_[planar] == nullptr) {
+                throw std::bad_alloc{};
+            }
+        }
+        // calling thread copies first band itself
+        if (band_count_ > 1) {
+            band_executor_ = core::make_pool_executor(static_cast<int>(band_count_ - 1), "FrameCompositor");
+        }
+    }
+
+    frame_compositor::~frame_compositor() {
+        if (band_executor_) {
+            band_executor_->join();
+        }
+    }
+
+    void frame_compositor::compose(const std::vector<tile>& tiles) const {
+        if (band_count_ == 1) {
+            compose_band(tiles, 0);
+            return;
+        }
+        std::atomic<unsigned> pending_count{ band_count_ };
+        folly::Baton<> compose_baton;
+        const auto finish_band = [&] {
+            if (pending_count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                compose_baton.post();
+            }
+        };
+        for (auto band = 1u; band < band_count_; ++band) {
+            band_executor_->add([this, &tiles, &finish_band, band] {
+                compose_band(tiles, band);
+                finish_band();
+            });
+        }
+        compose_band(tiles, 0);
+        finish_band();
+        compose_baton.wait();
+    }
+
+    // band rows are even so chroma rows of a band never overlap next band
+    void frame_compositor::compose_band(const std::vector<tile>& tiles, const unsigned band) const {
+        const auto band_height = align_up(static_cast<int>((height_ + band_count_ - 1) / band_count_), 2);
+        const auto band_begin = std::min(height_, static_cast<int>(band) * band_height);
+        const auto band_end = std::min(height_, band_begin + band_height);
+        for (const auto& tile : tiles) {
+            if (tile.picture == nullptr || tile.picture->empty()) {
+                continue;
+            }
+            const auto& picture = *tile.picture;
+            const auto row_begin = std::max(band_begin, tile.height_offset);
+            const auto row_end = std::min(band_end, tile.height_offset + picture->height);
+            if (row_begin >= row_end) {
+                continue;
+            }
+            assert(picture->format == AV_PIX_FMT_YUV420P);
+            assert(tile.width_offset >= 0 && tile.width_offset + picture->width <= width_);
+            for (size_t planar = 0; planar < planar_count; ++planar) {
+                const auto target_row = planar_stretch(planar, row_begin);
+                const auto source_row = target_row - planar_stretch(planar, tile.height_offset);
+                kernel::copy_plane(planars_[planar].get() + static_cast<size_t>(target_row) * linesizes_[planar]
+                                   + planar_stretch(planar, tile.width_offset),
+                                   linesizes_[planar],
+                                   picture->data[planar] + static_cast<size_t>(source_row) * picture->linesize[planar],
+                                   picture->linesize[planar],
+                                   planar_stretch(planar, picture->width),
+                                   planar_stretch(planar, row_end) - target_row);
+            }
+        }
+    }
+
+    uint8_t* frame_compositor::data(const size_t planar) const {
+        return planars_.at(planar).get();
+    }
+
+    int frame_compositor::linesize(const size_t planar) const {
+        return linesizes_.at(planar);
+    }
+
+    int frame_compositor::width() const noexcept {
+        return width_;
+    }
+
+    int frame_compositor::height() const noexcept {
+        return height_;
+    }
+
+    unsigned frame_compositor::band_count() const noexcept {
+        return band_count_;
+    }
+
+    int frame_compositor::planar_stretch(const size_t planar, const int offset) {
+        return planar > 0 ? offset / 2 : offset;
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace folly
+{
+    class ThreadPoolExecutor;
+}
+
+namespace media
+{
+    class frame;
+
+    // assembles decoded tile frames into one full frame planar 4:2:0 picture on CPU,
+    // planes are allocated once and picture rows are split into bands copied in parallel
+    class frame_compositor final
+    {
+    public:
+        struct tile final
+        {
+            const media::frame* picture = nullptr;
+            int width_offset = 0;
+            int height_offset = 0;
+        };
+
+        static constexpr inline size_t planar_count = 3;
+        static constexpr inline int linesize_alignment = 64;
+
+    private:
+        struct planar_deleter final
+        {
+            void operator()(uint8_t* data) const;
+        };
+
+        const int width_;
+        const int height_;
+        const unsigned band_count_;
+        std::array<std::unique_ptr<uint8_t, planar_deleter>, planar_count> planars_;
+        std::array<int, planar_count> linesizes_{};
+        std::shared_ptr<folly::ThreadPoolExecutor> band_executor_;
+
+    public:
+        frame_compositor(int width, int height, unsigned band_count = 1);
+        frame_compositor(const frame_compositor&) = delete;
+        frame_compositor(frame_compositor&&) = delete;
+        frame_compositor& operator=(const frame_compositor&) = delete;
+        frame_compositor& operator=(frame_compositor&&) = delete;
+        ~frame_compositor();
+
+        // blocks until every band is copied, empty tile frames leave their region untouched
+        void compose(const std::vector<tile>& tiles) const;
+
+        uint8_t* data(size_t planar) const;
+        int linesize(size_t planar) const;
+        int width() const noexcept;
+        int height() const noexcept;
+        unsigned band_count() const noexcept;
+
+        // chroma planars are subsampled by 2 in both directions
+        static int planar_stretch(size_t planar, int offset);
+
+    private:
+        void compose_band(const std::vector<tile>& tiles, unsigned band) const;
+    };
+}
@@ -0,0 +1,158 @@
+#include "stdafx.h"
+#include "frame.pool.h"
+#include "media.h"
+#include <vector>
+
+extern "C" {
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+}
+
+namespace media
+{
+    namespace
+    {
+        constexpr auto linesize_alignment = 64;
+        constexpr auto overread_padding = 16 + linesize_alignment;
+    }
+
+    //-- frame_pool::slab
+    struct frame_pool::slab final
+    {
+        std::mutex mutex;
+        std::vector<uint8_t*> blocks;
+        const size_t block_size;
+        const size_t capacity;
+        size_t outstanding = 0;
+        bool detached = false;
+
+        slab(size_t block_size, size_t capacity)
+            : block_size{ block_size }
+            , capacity{ capacity } {}
+
+        std::pair<uint8_t*, bool> acquire() {
+            std::lock_guard<std::mutex> lock{ mutex };
+            if (!blocks.empty()) {
+                const auto block = blocks.back();
+                blocks.pop_back();
+                outstanding++;
+                return { block, true };
+            }
+            if (outstanding < capacity) {
+                outstanding++;
+                return { static_cast<uint8_t*>(av_malloc(block_size)), false };
+            }
+            return { nullptr, false };
+        }
+
+        // frames may outlive the pool, a detached slab deletes itself with its last block
+        static void release(void* opaque, uint8_t* block) {
+            auto* owner = static_cast<slab*>(opaque);
+            auto remove_slab = false;
+            {
+                std::lock_guard<std::mutex> lock{ owner->mutex };
+                owner->outstanding--;
+                if (owner->detached) {
+                    av_free(block);
+                    remove_slab = owner->outstanding == 0;
+                } else {
+                    owner->blocks.push_back(block);
+                }
+            }
+            if (remove_slab) {
+                delete owner;
+            }
+        }
+
+        void detach() {
+            auto remove_slab = false;
+            {
+                std::lock_guard<std::mutex> lock{ mutex };
+                detached = true;
+                for (auto* block : blocks) {
+                    av_free(block);
+                }
+                blocks.clear();
+                remove_slab = outstanding == 0;
+            }
+            if (remove_slab) {
+                delete this;
+            }
+        }
+    };
+
+    //-- frame_pool
+    frame_pool::frame_pool(size_t slab_capacity)
+        : capacity_{ slab_capacity } {}
+
+    frame_pool::~frame_pool() {
+        for (auto& [key, slab] : slabs_) {
+            slab->detach();
+        }
+    }
+
+    int64_t frame_pool::hit_count() const noexcept {
+        return hit_count_.load(std::memory_order_relaxed);
+    }
+
+    int64_t frame_pool::miss_count() const noexcept {
+        return miss_count_.load(std::memory_order_relaxed);
+    }
+
+    size_t frame_pool::slab_count() const {
+        std::lock_guard<std::mutex> lock{ mutex_ };
+        return slabs_.size();
+    }
+
+    frame_pool::slab& frame_pool::slab_of(const slab_key& key) {
+        std::lock_guard<std::mutex> lock{ mutex_ };
+        auto& key_slab = slabs_[key];
+        if (key_slab == nullptr) {
+            key_slab = new slab{ std::get<size_t>(key), capacity_ };
+        }
+        return *key_slab;
+    }
+
+    int frame_pool::on_get_buffer(AVCodecContext* context, AVFrame* frame, const int flags) {
+        auto* pool = static_cast<frame_pool*>(context->opaque);
+        const auto format = static_cast<AVPixelFormat>(frame->format);
+        const auto* descriptor = av_pix_fmt_desc_get(format);
+        if (pool == nullptr || descriptor == nullptr
+            || descriptor->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_PAL)) {
+            return avcodec_default_get_buffer2(context, frame, flags);
+        }
+        auto width = frame->width;
+        auto height = frame->height;
+        int linesize_align[AV_NUM_DATA_POINTERS];
+        avcodec_align_dimensions2(context, &width, &height, linesize_align);
+        int linesizes[4] = {};
+        if (av_image_fill_linesizes(linesizes, format, width) < 0) {
+            return avcodec_default_get_buffer2(context, frame, flags);
+        }
+        for (auto& linesize : linesizes) {
+            linesize = FFALIGN(linesize, linesize_alignment);
+        }
+        uint8_t* plane_offsets[4] = {};
+        const auto picture_size = av_image_fill_pointers(plane_offsets, format, height, nullptr, linesizes);
+        if (picture_size < 0) {
+            return avcodec_default_get_buffer2(context, frame, flags);
+        }
+        const auto block_size = folly::to<size_t>(picture_size) + overread_padding;
+        auto& frame_slab = pool->slab_of({ frame->format, frame->width, frame->height, block_size });
+        const auto [block, hit] = frame_slab.acquire();
+        if (block == nullptr) {
+            pool->miss_count_.fetch_add(1, std::memory_order_relaxed);
+            return avcodec_default_get_buffer2(context, frame, flags);
+        }
+        (hit ? pool->hit_count_ : pool->miss_count_).fetch_add(1, std::memory_order_relaxed);
+        frame->buf[0] = av_buffer_create(block, folly::to<int>(block_size), slab::release, &frame_slab, 0);
+        if (frame->buf[0] == nullptr) {
+            slab::release(&frame_slab, block);
+            return AVERROR(ENOMEM);
+        }
+        av_image_fill_pointers(frame->data, format, height, block, linesizes);
+        std::copy_n(linesizes, 4, frame->linesize);
+        frame->extended_data = frame->data;
+        return 0;
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <tuple>
+
+struct AVCodecContext;
+struct AVFrame;
+
+namespace media
+{
+    // picture buffers of decoded frames are carved from per-resolution slabs and return
+    // to their slab once the last frame reference is released, e.g. after texture upload
+    class frame_pool final
+    {
+        struct slab;
+        using slab_key = std::tuple<int, int, int, size_t>;
+
+        mutable std::mutex mutex_;
+        std::map<slab_key, slab*> slabs_;
+        size_t capacity_ = 0;
+        std::atomic<int64_t> hit_count_{ 0 };
+        std::atomic<int64_t> miss_count_{ 0 };
+
+    public:
+        static constexpr inline size_t default_slab_capacity = 64;
+
+        explicit frame_pool(size_t slab_capacity = default_slab_capacity);
+        frame_pool(const frame_pool&) = delete;
+        frame_pool(frame_pool&&) = delete;
+        frame_pool& operator=(const frame_pool&) = delete;
+        frame_pool& operator=(frame_pool&&) = delete;
+        ~frame_pool();
+
+        int64_t hit_count() const noexcept;
+        int64_t miss_count() const noexcept;
+        size_t slab_count() const;
+
+        // installed as AVCodecContext::get_buffer2, AVCodecContext::opaque points to the pool
+        static int on_get_buffer(AVCodecContext* context, AVFrame* frame, int flags);
+
+    private:
+        slab& slab_of(const slab_key& key);
+    };
+}
@@ -2,6 +2,7 @@
 #include "io.cursor.h"
 #include "core/core.h"
 #include "core/exception.hpp"
+#include <algorithm>
 #include <numeric>
 #pragma warning(disable: 4819)
 extern "C" {
@@ -16,33 +17,22 @@ namespace media
 
     //-- cursor
     cursor::cursor(const multi_buffer& buffer)
-        : buffer_begin(boost::asio::buffer_sequence_begin(buffer.data()))
-        , buffer_end(boost::asio::buffer_sequence_end(buffer.data()))
-        , buffer_iterator(buffer_begin) {
-        auto& buffer_sizes = core::as_mutable(this->buffer_sizes);
-        std::transform(buffer_begin, buffer_end, std::back_inserter(buffer_sizes),
-                       [](const_buffer_iterator::reference buffer) {
-                           return boost::asio::buffer_size(buffer);
-                       });
-    }
+        : buffers{ core::split_buffer_sequence(buffer) } {}
 
     int64_t cursor::seek_sequence(int64_t seek_offset) {
-        const auto size_iter = std::upper_bound(buffer_sizes.crbegin(), buffer_sizes.crend(),
-                                                seek_offset, std::greater<>{});
-        buffer_iterator = std::prev(buffer_end, std::distance(buffer_sizes.crbegin(), size_iter));
-        const auto partial_sequence_size = size_iter != buffer_sizes.crend() ? *size_iter : 0;
-        buffer_offset = std::min(seek_offset - partial_sequence_size, buffer_size());
-        sequence_offset = partial_sequence_size + buffer_offset;
+        seek_offset = std::clamp<int64_t>(seek_offset, 0, sequence_size());
+        buffer_index = buffers.locate(seek_offset);
+        buffer_offset = seek_offset - buffers.offset(buffer_index);
+        sequence_offset = seek_offset;
         return sequence_offset;
     }
 
     int64_t cursor::buffer_size() const {
-        auto const size = buffer_sizes.at(std::distance(buffer_begin, buffer_iterator));
-        return folly::to<int64_t>(size);
+        return folly::to<int64_t>(buffers[buffer_index].size());
     }
 
     int64_t cursor::sequence_size() const {
-        return std::accumulate(buffer_sizes.begin(), buffer_sizes.end(), 0i64);
+        return buffers.total_size();
     }
 
     //-- generic_cursor
@@ -85,19 +75,19 @@ namespace media
         : cursor(buffer) {}
 
     int random_access_cursor::read(uint8_t* buffer, int expect_size) {
-        if (buffer_iterator == buffer_end)
+        if (buffer_index == buffers.size())
             return AVERROR_EOF;
         auto total_read_size = 0;
         fmt::print("cursor reading, expect_size {}, sequence{}/{}\n", expect_size, sequence_offset, sequence_size());
-        while (buffer_iterator != buffer_end && total_read_size < expect_size) {
-            auto const read_ptr = static_cast<char const*>((*buffer_iterator).data());
+        while (buffer_index != buffers.size() && total_read_size < expect_size) {
+            auto const read_ptr = static_cast<char const*>(buffers[buffer_index].data());
             auto const read_size = std::min<int64_t>(expect_size - total_read_size, buffer_size() - buffer_offset);
             assert(read_size > 0);
             std::copy_n(read_ptr + buffer_offset, read_size, buffer + total_read_size);
             buffer_offset += read_size;
             sequence_offset += read_size;
             if (buffer_offset == buffer_size()) {
-                buffer_iterator.operator++();
+                buffer_index++;
                 buffer_offset = 0;
             }
             total_read_size += folly::to<int>(read_size);
@@ -153,6 +143,10 @@ namespace media
         return false;
     }
 
+    bool io_base::sizable() const {
+        return false;
+    }
+
     bool io_base::available() const {
         core::not_implemented_error::throw_directly();
     }
@@ -166,28 +160,23 @@ namespace media
     }
 
     //-- buffer_list_cursor
-    buffer_list_cursor::buffer_list_cursor(std::list<const_buffer> bufs) {
-        full_size_ = std::accumulate(
-            bufs.begin(), bufs.end(), 0i64,
-            [](int64_t sum, const_buffer& buffer) {
-                return sum + buffer.size();
-            });
-        buffer_list_ = std::move(bufs);
-        buffer_iterator_ = buffer_list_.begin();
-    }
+    buffer_list_cursor::buffer_list_cursor(core::buffer_vector bufs)
+        : buffer_list_{ std::move(bufs) }
+        , full_size_{ buffer_list_.total_size() } {}
 
     int buffer_list_cursor::read(uint8_t* buffer, int expect_size) {
-        if (buffer_iterator_ != buffer_list_.end()) {
+        if (buffer_index_ != buffer_list_.size()) {
             auto read_size = 0i64;
-            while (buffer_iterator_ != buffer_list_.end() && read_size < expect_size) {
-                auto* pointer = static_cast<const char*>(buffer_iterator_->data());
+            while (buffer_index_ != buffer_list_.size() && read_size < expect_size) {
+                const auto& current_buffer = buffer_list_[buffer_index_];
+                auto* pointer = static_cast<const char*>(current_buffer.data());
                 const auto increment = std::min<int64_t>(expect_size - read_size,
-                                                         buffer_iterator_->size() - offset_);
+                                                         current_buffer.size() - offset_);
                 assert(increment > 0);
                 std::copy_n(pointer + offset_, increment, buffer + read_size);
                 offset_ += increment;
-                if (offset_ == buffer_iterator_->size()) {
-                    if (buffer_iterator_.operator++() == buffer_list_.end()) {
+                if (offset_ == current_buffer.size()) {
+                    if (++buffer_index_ == buffer_list_.size()) {
                         eof_ = true;
                     }
                     offset_ = 0;
@@ -221,25 +210,15 @@ namespace media
                 core::not_reachable_error::throw_directly();
         }
         if (seek_offset >= full_size_) {
-            buffer_iterator_ = buffer_list_.end();
+            buffer_index_ = buffer_list_.size();
             full_offset_ = full_size_;
             offset_ = 0;
             return full_size_;
         }
-        auto partial_sum = 0i64;
-        buffer_iterator_ = std::find_if(
-            buffer_list_.begin(), buffer_list_.end(),
-            [&partial_sum, &seek_offset](const_buffer& buffer) {
-                const auto buffer_size = folly::to<int64_t>(buffer.size());
-                const auto next_buffer_offset = partial_sum + buffer_size;
-                if (next_buffer_offset <= seek_offset) {
-                    partial_sum = next_buffer_offset;
-                    return false;
-                }
-                return true;
-            });
+        // prefix sums over flat sequence, mov demuxer seeks on every box it skips
+        buffer_index_ = buffer_list_.locate(seek_offset);
         full_offset_ = seek_offset;
-        offset_ = seek_offset - partial_sum;
+        offset_ = seek_offset - buffer_list_.offset(buffer_index_);
         return seek_offset;
     }
 
@@ -251,8 +230,12 @@ namespace media
         return true;
     }
 
+    bool buffer_list_cursor::sizable() const {
+        return true;
+    }
+
     bool buffer_list_cursor::available() const {
-        return buffer_iterator_ != buffer_list_.end();
+        return buffer_index_ != buffer_list_.size();
     }
 
     int64_t buffer_list_cursor::consume_size() const {
@@ -269,7 +252,7 @@ namespace media
     }
 
     std::unique_ptr<buffer_list_cursor>
-    buffer_list_cursor::create(std::list<const_buffer>&& buffer_list) {
+    buffer_list_cursor::create(core::buffer_vector&& buffer_list) {
         return std::make_unique<buffer_list_cursor>(std::move(buffer_list));
     }
 }
@@ -3,6 +3,7 @@
 #include <folly/Function.h>
 #include <boost/asio/buffer.hpp>
 #include <boost/beast/core/multi_buffer.hpp>
+#include "core/buffer_vector.hpp"
 
 namespace media
 {
@@ -29,6 +30,7 @@ namespace media
         virtual bool readable() const;
         virtual bool writable() const;
         virtual bool seekable() const;
+        virtual bool sizable() const;
 
         virtual bool available() const;
         virtual int64_t consume_size() const;
@@ -47,8 +49,8 @@ namespace media
 
     class buffer_list_cursor final : public io_base
     {
-        std::list<detail::const_buffer> buffer_list_;
-        std::list<detail::const_buffer>::iterator buffer_iterator_;
+        core::buffer_vector buffer_list_;
+        size_t buffer_index_ = 0;
         int64_t offset_ = 0;
         int64_t full_read_size_ = 0;
         int64_t full_offset_ = 0;
@@ -56,7 +58,7 @@ namespace media
         bool eof_ = false;
 
     public:
-        explicit buffer_list_cursor(std::list<detail::const_buffer> buffer_list);
+        explicit buffer_list_cursor(core::buffer_vector buffer_list);
 
         int read(uint8_t* buffer, int expect_size) override;
         int write(uint8_t* buffer, int size) override;
@@ -64,23 +66,22 @@ namespace media
 
         bool readable() const override;
         bool seekable() const override;
+        bool sizable() const override;
 
         bool available() const override;
         int64_t consume_size() const override;
         int64_t remain_size() const override;
 
         static std::unique_ptr<buffer_list_cursor> create(const detail::multi_buffer& buffer);
-        static std::unique_ptr<buffer_list_cursor> create(std::list<detail::const_buffer>&& buffer_list);
+        static std::unique_ptr<buffer_list_cursor> create(core::buffer_vector&& buffer_list);
     };
 
     struct cursor
     {
-        const detail::const_buffer_iterator buffer_begin;
-        const detail::const_buffer_iterator buffer_end;
-        detail::const_buffer_iterator buffer_iterator;
+        const core::buffer_vector buffers;
+        size_t buffer_index = 0;
         int64_t buffer_offset = 0;
         int64_t sequence_offset = 0;
-        std::vector<int64_t> const buffer_sizes;
 
         explicit cursor(const detail::multi_buffer& buffer);
 
@@ -50,7 +50,7 @@ namespace media
         static_cast<default_delete&>(*this)(impl);
     }
 
-    frame_segmentor::frame_segmentor(std::list<const_buffer> buffer_list,
+    frame_segmentor::frame_segmentor(core::buffer_vector buffer_list,
                                      unsigned concurrency)
         : impl_{ new impl{}, impl_deleter{} } {
         parse_context(std::move(buffer_list), concurrency);
@@ -60,14 +60,16 @@ namespace media
         return impl_.operator bool();
     }
 
-    void frame_segmentor::parse_context(std::list<const_buffer> buffer_list,
+    void frame_segmentor::parse_context(core::buffer_vector buffer_list,
                                         unsigned concurrency) {
         if (!impl_) {
             impl_ = { new impl{}, impl_deleter{} };
         }
+        // segment memory stays alive as long as the segmentor, demuxer copies packet payload
+        // from the buffer list directly instead of staging it through the avio cache page
         impl_->codec_context.emplace(
             impl_->format_context.emplace(
-                impl_->io_context.emplace(buffer_list_cursor::create(std::move(buffer_list))),
+                impl_->io_context.emplace(buffer_list_cursor::create(std::move(buffer_list)), true),
                 source::format{}),
             media::type::video, concurrency);
     }
@@ -3,6 +3,7 @@
 #include <folly/futures/Future.h>
 #include <boost/asio/buffer.hpp>
 #include <boost/container/small_vector.hpp>
+#include "core/buffer_vector.hpp"
 
 namespace media
 {
@@ -39,11 +40,11 @@ namespace media
         frame_segmentor& operator=(frame_segmentor&&) noexcept = default;
         ~frame_segmentor() = default;
 
-        explicit frame_segmentor(std::list<detail::const_buffer> buffer_list, unsigned concurrency);
+        explicit frame_segmentor(core::buffer_vector buffer_list, unsigned concurrency);
 
         explicit operator bool() const;
 
-        void parse_context(std::list<detail::const_buffer> buffer_list, unsigned concurrency);
+        void parse_context(core::buffer_vector buffer_list, unsigned concurrency);
         bool codec_available() const noexcept;
         bool context_valid() const noexcept;
         bool buffer_available() const;
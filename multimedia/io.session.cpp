@@ -0,0 +1,479 @@
+#include "stdafx.h"
+#include "io.session.h"
+#include "context.h"
+#include "core/core.h"
+#include "core/exception.hpp"
+#include "core/verify.hpp"
+#include <algorithm>
+#include <deque>
+#include <limits>
+#include <optional>
+#include <unordered_map>
+
+namespace media
+{
+    using namespace detail;
+
+    namespace
+    {
+        auto big_endian = [](const uint8_t* bytes, size_t size) {
+            uint64_t value = 0;
+            for (size_t index = 0; index < size; ++index) {
+                value = value << 8 | bytes[index];
+            }
+            return value;
+        };
+
+        //-- segment_cursor
+        // concatenates segments into one unseekable stream, mov demuxer treats it as a live
+        // fragmented mp4 and keeps parsing moof boxes across segment boundaries
+        struct segment_cursor final : io_base
+        {
+            struct segment_data final
+            {
+                // downloaded bytes from offset on, stream body is moved in as it arrives
+                core::segment_buffer buffer;
+                std::shared_ptr<core::chunk_stream> stream;
+                // representation switch, recorded at stream offset where the segment starts
+                const multi_buffer* switch_initial = nullptr;
+                // offsets from segment start, bytes before min of read and scan are released
+                int64_t offset = 0;
+                int64_t read_offset = 0;
+                int64_t scan_offset = 0;
+                // end of last downloaded mdat box, demuxer never reads past the next one
+                // while producing a packet
+                int64_t mdat_end = 0;
+
+                bool downloaded() const {
+                    return stream == nullptr || (stream->closed() && stream->readable_size() == 0);
+                }
+
+                // moves arrived body into buffer and walks complete top-level boxes
+                void stage() {
+                    if (stream != nullptr) {
+                        if (const auto readable_size = stream->readable_size(); readable_size > 0) {
+                            const auto grow_size = std::max(readable_size, buffer.size());
+                            buffer.commit(stream->try_read(buffer.prepare(grow_size)));
+                        }
+                    }
+                    const auto* data = static_cast<const uint8_t*>(buffer.data().data());
+                    const auto data_end = offset + folly::to<int64_t>(buffer.size());
+                    while (scan_offset <= data_end - 8) {
+                        const auto* header = data + (scan_offset - offset);
+                        auto box_size = big_endian(header, 4);
+                        uint64_t header_size = 8;
+                        if (box_size == 1) {
+                            if (scan_offset + 16 > data_end) {
+                                break;
+                            }
+                            box_size = big_endian(header + 8, 8);
+                            header_size = 16;
+                        }
+                        if (box_size == 0) {
+                            // box runs to end of segment, complete once downloaded
+                            break;
+                        }
+                        if (box_size < header_size
+                            || box_size > static_cast<uint64_t>(std::numeric_limits<int64_t>::max() - scan_offset)) {
+                            // not a box sequence, leave it to demuxer and never gate
+                            scan_offset = mdat_end = std::numeric_limits<int64_t>::max();
+                            break;
+                        }
+                        if (scan_offset + static_cast<int64_t>(box_size) > data_end) {
+                            break;
+                        }
+                        scan_offset += box_size;
+                        if (std::equal(header + 4, header + 8, "mdat")) {
+                            mdat_end = scan_offset;
+                        }
+                    }
+                }
+
+                size_t read(boost::asio::mutable_buffer read_buffer) {
+                    const auto copy_size = boost::asio::buffer_copy(
+                        read_buffer, buffer.data() + folly::to<size_t>(read_offset - offset));
+                    read_offset += copy_size;
+                    const auto release_size = std::min(read_offset, scan_offset) - offset;
+                    buffer.consume(folly::to<size_t>(release_size));
+                    offset += release_size;
+                    return copy_size;
+                }
+
+                int64_t remain_size() const {
+                    return offset + folly::to<int64_t>(buffer.size()) - read_offset;
+                }
+            };
+
+            decode_session::segment_provider provider;
+            std::deque<segment_data> segments;
+            std::deque<std::pair<int64_t, const multi_buffer*>> initial_switches;
+            const multi_buffer* initial = nullptr;
+            int64_t read_size = 0;
+            int64_t segment_count = 0;
+            std::exception_ptr exception;
+
+            static constexpr size_t stream_chunk_size = 64 * 1024;
+
+            explicit segment_cursor(decode_session::segment_provider&& provider)
+                : provider(std::move(provider)) {}
+
+            int read(uint8_t* buffer, int size) override {
+                const boost::asio::mutable_buffer read_buffer{ buffer, folly::to<size_t>(size) };
+                while (true) {
+                    if (segments.empty()) {
+                        if (exception) {
+                            return AVERROR_EOF;
+                        }
+                        // exception must not propagate across libavformat frames
+                        try {
+                            pull_segment();
+                        } catch (...) {
+                            exception = std::current_exception();
+                            return AVERROR_EOF;
+                        }
+                    }
+                    auto& segment = segments.front();
+                    if (segment.switch_initial != nullptr) {
+                        initial_switches.emplace_back(read_size, std::exchange(segment.switch_initial, nullptr));
+                    }
+                    segment.stage();
+                    if (const auto copy_size = segment.read(read_buffer); copy_size > 0) {
+                        read_size += copy_size;
+                        return folly::to<int>(copy_size);
+                    }
+                    if (segment.stream == nullptr) {
+                        segments.pop_front();
+                        continue;
+                    }
+                    // ungated caller blocks here until more body arrives or stream closes
+                    try {
+                        const auto stream_size = segment.stream->read(segment.buffer.prepare(stream_chunk_size));
+                        segment.buffer.commit(stream_size);
+                        if (stream_size == 0) {
+                            segments.pop_front();
+                        }
+                    } catch (...) {
+                        exception = std::current_exception();
+                        segments.clear();
+                        return AVERROR_EOF;
+                    }
+                }
+            }
+
+            int write(uint8_t* buffer, int size) override {
+                core::not_implemented_error::throw_directly();
+            }
+
+            int64_t seek(int64_t offset, int whence) override {
+                core::not_implemented_error::throw_directly();
+            }
+
+            bool readable() const override {
+                return true;
+            }
+
+            bool available() const override {
+                return exception == nullptr;
+            }
+
+            int64_t consume_size() const override {
+                return read_size;
+            }
+
+            int64_t remain_size() const override {
+                int64_t remain_size = 0;
+                for (const auto& segment : segments) {
+                    remain_size += segment.remain_size();
+                    if (segment.stream != nullptr) {
+                        remain_size += segment.stream->readable_size();
+                    }
+                }
+                return remain_size;
+            }
+
+            bool stream_pending() const {
+                return std::any_of(segments.begin(), segments.end(), [](const segment_data& segment) {
+                    return segment.stream != nullptr && !segment.stream->closed();
+                });
+            }
+
+            // downloaded bytes reach end of next mdat, demuxing a packet will not block
+            bool packet_ready() {
+                for (auto& segment : segments) {
+                    segment.stage();
+                    if (segment.mdat_end > segment.read_offset) {
+                        return true;
+                    }
+                    if (!segment.downloaded()) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            void pull_segment() {
+                auto [initial_buffer, data, stream] = provider();
+                const auto* segment_initial = &initial_buffer.get();
+                const multi_buffer* switch_initial = nullptr;
+                if (initial == nullptr) {
+                    segments.push_back(segment_data{ core::segment_buffer{ segment_initial->data() } });
+                } else if (initial != segment_initial) {
+                    switch_initial = segment_initial;
+                }
+                initial = segment_initial;
+                // streamed body is staged into one block of segment pool, reserved up front
+                if (stream != nullptr && stream->content_size().has_value()) {
+                    data.reserve(folly::to<size_t>(*stream->content_size()));
+                }
+                segments.push_back(segment_data{ std::move(data), std::move(stream), switch_initial });
+                segment_count++;
+            }
+        };
+
+        auto parse_parameters = [](const multi_buffer& initial) {
+            io_context io_context{ buffer_list_cursor::create(initial) };
+            const format_context format_context{ io_context, source::format{} };
+            return codec_parameters{ format_context.demux(type::video).params() };
+        };
+
+        // avcC or hvcC configuration record, 0 if payload is not length prefixed
+        auto parse_nal_length_size = [](const codec_parameters& parameters) {
+            const auto extradata = parameters.extradata();
+            if (extradata.empty() || extradata[0] != 1) {
+                return 0;
+            }
+            if (parameters->codec_id == AV_CODEC_ID_H264 && extradata.size() > 4) {
+                return (extradata[4] & 0b11) + 1;
+            }
+            if (parameters->codec_id == AV_CODEC_ID_HEVC && extradata.size() > 21) {
+                return (extradata[21] & 0b11) + 1;
+            }
+            return 0;
+        };
+
+        // no other picture predicts from it: h264 nal_ref_idc 0, hevc sub-layer non-reference
+        auto nonreference_packet = [](const packet& packet, AVCodecID codec_id, size_t length_size) {
+            auto payload = packet.buffer();
+            auto slice_count = 0;
+            while (length_size > 0 && payload.size() > length_size) {
+                size_t nal_size = 0;
+                for (size_t index = 0; index < length_size; ++index) {
+                    nal_size = nal_size << 8 | payload[index];
+                }
+                payload.remove_prefix(length_size);
+                if (nal_size == 0 || nal_size > payload.size()) {
+                    return false;
+                }
+                if (codec_id == AV_CODEC_ID_H264) {
+                    if (const auto nal_type = payload[0] & 0x1f; nal_type == 1 || nal_type == 5) {
+                        if (payload[0] & 0x60) {
+                            return false;
+                        }
+                        slice_count++;
+                    }
+                } else if (const auto nal_type = payload[0] >> 1 & 0x3f; nal_type < 32) {
+                    if (nal_type > 14 || nal_type % 2) {
+                        return false;
+                    }
+                    slice_count++;
+                }
+                payload.remove_prefix(nal_size);
+            }
+            return slice_count > 0;
+        };
+    }
+
+    struct decode_session::impl final
+    {
+        unsigned concurrency = 0;
+        std::shared_ptr<frame_pool> pool;
+        segment_cursor* cursor = nullptr;
+        int64_t switch_count = 0;
+        int64_t discard_count = 0;
+        AVCodecID codec_id = AV_CODEC_ID_NONE;
+        size_t nal_length_size = 0;
+        bool drained = false;
+        std::optional<io_context> io_context;
+        std::optional<format_context> format_context;
+        std::optional<codec_context> codec_context;
+        std::unordered_map<const multi_buffer*, codec_parameters> parameters_cache;
+        // timestamps of discarded packets, sorted, waiting for a decoded frame presented after them
+        std::deque<int64_t> discard_timestamps;
+
+        void create_cursor(segment_provider&& provider) {
+            auto stream_cursor = std::make_unique<segment_cursor>(std::move(provider));
+            cursor = stream_cursor.get();
+            io_context.emplace(std::move(stream_cursor), true);
+        }
+
+        // pulls next segment outside libavformat once buffered data is exhausted, returns
+        // false if demuxing a packet would block on the segment still being downloaded
+        bool prepare_segment() {
+            if (cursor->available() && cursor->remain_size() == 0 && !cursor->stream_pending()) {
+                if (!codec_context.has_value()) {
+                    // provider exception on initial segment propagates to caller
+                    cursor->pull_segment();
+                } else {
+                    try {
+                        cursor->pull_segment();
+                    } catch (...) {
+                        // demuxer reads end of file and decoder flushes
+                        cursor->exception = std::current_exception();
+                        return true;
+                    }
+                }
+                return cursor->packet_ready();
+            }
+            return true;
+        }
+
+        void open_context() {
+            const auto& parameters = initial_parameters(cursor->initial);
+            codec_id = parameters->codec_id;
+            nal_length_size = parse_nal_length_size(parameters);
+            format_context.emplace(*io_context, source::format{}, parameters);
+            codec_context.emplace(*format_context, type::video, concurrency, pool);
+        }
+
+        // init segment only carries moov, parsing it never decodes a frame
+        const codec_parameters& initial_parameters(const multi_buffer* initial) {
+            auto parameters_iter = parameters_cache.find(initial);
+            if (parameters_iter == parameters_cache.end()) {
+                parameters_iter = parameters_cache.emplace(initial, parse_parameters(*initial)).first;
+            }
+            return parameters_iter->second;
+        }
+
+        bool discardable(const packet& packet) const {
+            // packet carrying a representation switch must reach decoder
+            const auto& switches = cursor->initial_switches;
+            if (!switches.empty() && switches.front().first <= packet->pos) {
+                return false;
+            }
+            return nonreference_packet(packet, codec_id, nal_length_size);
+        }
+
+        void update_extradata(packet& packet) {
+            auto& switches = cursor->initial_switches;
+            const multi_buffer* initial = nullptr;
+            while (!switches.empty() && switches.front().first <= packet->pos) {
+                initial = switches.front().second;
+                switches.pop_front();
+            }
+            if (initial == nullptr) {
+                return;
+            }
+            const auto extradata = initial_parameters(initial).extradata();
+            // decoder picks up sps and pps of new representation without reopening
+            auto* side_data = av_packet_new_side_data(core::get_pointer(packet),
+                                                      AV_PKT_DATA_NEW_EXTRADATA,
+                                                      folly::to<int>(extradata.size()));
+            core::verify(side_data);
+            std::copy_n(extradata.data(), extradata.size(), side_data);
+            switch_count++;
+        }
+
+        void discard_packet(const packet& packet) {
+            discard_count++;
+            discard_timestamps.insert(
+                std::upper_bound(discard_timestamps.begin(), discard_timestamps.end(), packet->pts),
+                packet->pts);
+        }
+
+        // decoder reorders into presentation order, placeholders are slotted in by timestamp
+        // so that frame index still lines up with a fully decoded stream
+        vector<frame> present(vector<frame>&& decode_frames, bool flush) {
+            vector<frame> present_frames;
+            const auto release_placeholders = [&](int64_t timestamp) {
+                while (!discard_timestamps.empty() && discard_timestamps.front() < timestamp) {
+                    present_frames.push_back(frame{ nullptr });
+                    discard_timestamps.pop_front();
+                }
+            };
+            for (auto& decode_frame : decode_frames) {
+                if (const auto timestamp = decode_frame->best_effort_timestamp; timestamp != AV_NOPTS_VALUE) {
+                    release_placeholders(timestamp);
+                }
+                present_frames.push_back(std::move(decode_frame));
+            }
+            for (; flush && !discard_timestamps.empty(); discard_timestamps.pop_front()) {
+                present_frames.push_back(frame{ nullptr });
+            }
+            return present_frames;
+        }
+    };
+
+    void decode_session::impl_deleter::operator()(impl* impl) {
+        static_cast<default_delete&>(*this)(impl);
+    }
+
+    decode_session::decode_session(segment_provider provider, unsigned concurrency,
+                                   std::shared_ptr<frame_pool> pool)
+        : impl_{ new impl{}, impl_deleter{} } {
+        impl_->concurrency = concurrency;
+        impl_->pool = std::move(pool);
+        impl_->create_cursor(std::move(provider));
+    }
+
+    decode_session::operator bool() const {
+        return impl_ != nullptr && impl_->io_context.has_value();
+    }
+
+    bool decode_session::codec_available() const noexcept {
+        return !impl_->drained;
+    }
+
+    int64_t decode_session::segment_count() const noexcept {
+        return impl_->cursor->segment_count;
+    }
+
+    int64_t decode_session::switch_count() const noexcept {
+        return impl_->switch_count;
+    }
+
+    int64_t decode_session::discard_count() const noexcept {
+        return impl_->discard_count;
+    }
+
+    bool decode_session::segment_demand() const {
+        return !impl_->drained && impl_->cursor->available() && impl_->cursor->remain_size() == 0
+            && !impl_->cursor->stream_pending();
+    }
+
+    bool decode_session::stream_demand() const {
+        return !impl_->drained && impl_->cursor->available() && impl_->cursor->stream_pending()
+            && !impl_->cursor->packet_ready();
+    }
+
+    vector<frame> decode_session::try_consume(discard policy) const {
+        if (impl_->drained) {
+            if (impl_->cursor->exception) {
+                std::rethrow_exception(impl_->cursor->exception);
+            }
+            core::stream_drained_error::throw_in_function(__FUNCTION__);
+        }
+        if (!impl_->prepare_segment()) {
+            // caller waits on stream_demand, an ungated caller blocks in next call
+            return vector<frame>{};
+        }
+        if (!impl_->codec_context.has_value()) {
+            impl_->open_context();
+        }
+        auto packet = impl_->format_context->read(type::video);
+        if (packet.empty()) {
+            impl_->drained = true;
+            if (policy == discard::all) {
+                return impl_->present(vector<frame>{}, true);
+            }
+            return impl_->present(impl_->codec_context->decode(packet), true);
+        }
+        if (policy == discard::all
+            || (policy == discard::nonreference && impl_->discardable(packet))) {
+            impl_->discard_packet(packet);
+            // nothing reaches decoder under discard::all, every frame is a placeholder
+            return impl_->present(vector<frame>{}, policy == discard::all);
+        }
+        impl_->update_extradata(packet);
+        return impl_->present(impl_->codec_context->decode(packet), false);
+    }
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include "core/chunk_stream.hpp"
+#include "core/segment_buffer.hpp"
+#include <folly/Function.h>
+#include <boost/beast/core/multi_buffer.hpp>
+#include <boost/container/small_vector.hpp>
+
+namespace media
+{
+    class frame;
+    class frame_pool;
+}
+
+namespace media
+{
+    namespace detail
+    {
+        using boost::beast::multi_buffer;
+        template <typename T>
+        using vector = boost::container::small_vector<T, 1>;
+    }
+
+    class decode_session final
+    {
+        struct impl;
+        struct impl_deleter final : private std::default_delete<impl>
+        {
+            void operator()(impl* impl);
+        };
+
+        std::unique_ptr<impl, impl_deleter> impl_;
+
+    public:
+        struct segment final
+        {
+            std::reference_wrapper<const detail::multi_buffer> initial;
+            core::segment_buffer data;
+            // read after data, stream_demand holds decode until next packet is downloaded
+            std::shared_ptr<core::chunk_stream> stream = nullptr;
+        };
+
+        // blocks until next segment downloaded, throws when stream drained or aborted
+        using segment_provider = folly::Function<segment()>;
+
+        // discarded packets still yield an empty placeholder frame, slotted in presentation
+        // order among decoded frames to keep frame index aligned
+        enum class discard
+        {
+            none,
+            nonreference,
+            all,
+        };
+
+        decode_session() = delete;
+        decode_session(const decode_session&) = delete;
+        decode_session(decode_session&&) noexcept = default;
+        decode_session& operator=(const decode_session&) = delete;
+        decode_session& operator=(decode_session&&) noexcept = default;
+        ~decode_session() = default;
+
+        decode_session(segment_provider provider, unsigned concurrency,
+                       std::shared_ptr<frame_pool> pool = nullptr);
+
+        explicit operator bool() const;
+
+        bool codec_available() const noexcept;
+        int64_t segment_count() const noexcept;
+        int64_t switch_count() const noexcept;
+        int64_t discard_count() const noexcept;
+        // next try_consume may invoke segment provider, buffered data is exhausted
+        bool segment_demand() const;
+        // next try_consume may block on a segment still being downloaded
+        bool stream_demand() const;
+        detail::vector<media::frame> try_consume(discard policy = discard::none) const;
+    };
+}
@@ -35,6 +35,19 @@ absl::Duration media::frame::process_duration() const {
     return duration_;
 }
 
+void media::frame::presentation_time(const absl::Duration time, const absl::Duration duration) {
+    presentation_time_ = time;
+    presentation_duration_ = duration;
+}
+
+absl::Duration media::frame::presentation_time() const {
+    return presentation_time_;
+}
+
+absl::Duration media::frame::presentation_duration() const {
+    return presentation_duration_;
+}
+
 void media::packet::deleter::operator()(AVPacket* object) const {
     if (object != nullptr) {
         av_packet_free(&object);
@@ -84,6 +97,36 @@ void media::packet::unreference() const {
     av_packet_unref(handle_.get());
 }
 
+void media::codec_parameters::deleter::operator()(AVCodecParameters* object) const {
+    if (object != nullptr) {
+        avcodec_parameters_free(&object);
+    }
+}
+
+media::codec_parameters::codec_parameters(codec::parameter parameter)
+    : handle_(avcodec_parameters_alloc(), deleter{}) {
+    core::verify(avcodec_parameters_copy(handle_.get(), std::addressof(parameter.get())));
+}
+
+media::codec_parameters::pointer media::codec_parameters::operator->() const {
+    return handle_.get();
+}
+
+media::codec_parameters::operator bool() const {
+    return handle_ != nullptr;
+}
+
+media::codec::parameter media::codec_parameters::params() const {
+    return std::cref(*handle_);
+}
+
+std::basic_string_view<uint8_t> media::codec_parameters::extradata() const {
+    return {
+        handle_->extradata,
+        folly::to<size_t>(handle_->extradata_size)
+    };
+}
+
 media::stream::stream(reference ref)
     : reference_wrapper(ref) {}
 
@@ -34,6 +34,8 @@ namespace media
 
         std::unique_ptr<AVFrame, deleter> handle_;
         absl::Duration duration_;
+        absl::Duration presentation_time_ = absl::InfiniteDuration();
+        absl::Duration presentation_duration_;
 
     public:
         frame();
@@ -49,6 +51,10 @@ namespace media
         void unreference() const;
         void process_duration(absl::Duration duration);
         absl::Duration process_duration() const;
+        // timestamp on stream timeline, infinite if decoder reports none
+        void presentation_time(absl::Duration time, absl::Duration duration);
+        absl::Duration presentation_time() const;
+        absl::Duration presentation_duration() const;
     };
 
     class packet final
@@ -99,6 +105,32 @@ namespace media
         pointer operator->() const;
     };
 
+    class codec_parameters final
+    {
+        using pointer = AVCodecParameters *;
+
+        struct deleter final
+        {
+            void operator()(AVCodecParameters* object) const;
+        };
+
+        std::unique_ptr<AVCodecParameters, deleter> handle_;
+
+    public:
+        codec_parameters() = default;
+        explicit codec_parameters(codec::parameter parameter); // deep copy including extradata
+        codec_parameters(const codec_parameters&) = delete;
+        codec_parameters(codec_parameters&&) = default;
+        codec_parameters& operator=(const codec_parameters&) = delete;
+        codec_parameters& operator=(codec_parameters&&) = default;
+        ~codec_parameters() = default;
+        pointer operator->() const;
+        explicit operator bool() const;
+
+        codec::parameter params() const;
+        std::basic_string_view<uint8_t> extradata() const;
+    };
+
     struct stream final : std::reference_wrapper<AVStream>
     {
         using pointer = type *;
@@ -0,0 +1,287 @@
+#include "stdafx.h"
+#include "plane.kernel.h"
+#include <atomic>
+#include <cassert>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define MEDIA_KERNEL_X64
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define MEDIA_KERNEL_AVX2
+#else
+#define MEDIA_KERNEL_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace media::kernel
+{
+    namespace
+    {
+        struct row_kernel final
+        {
+            isa target;
+            void (*copy)(uint8_t* target, const uint8_t* source, int width);
+            void (*split)(const uint8_t* uv, uint8_t* u, uint8_t* v, int width);
+            void (*merge)(const uint8_t* u, const uint8_t* v, uint8_t* uv, int width);
+        };
+
+        //-- scalar
+        void copy_row_scalar(uint8_t* target, const uint8_t* source, const int width) {
+            std::memcpy(target, source, width);
+        }
+
+        void split_row_scalar(const uint8_t* uv, uint8_t* u, uint8_t* v, const int width) {
+            for (auto index = 0; index < width; ++index) {
+                u[index] = uv[2 * index];
+                v[index] = uv[2 * index + 1];
+            }
+        }
+
+        void merge_row_scalar(const uint8_t* u, const uint8_t* v, uint8_t* uv, const int width) {
+            for (auto index = 0; index < width; ++index) {
+                uv[2 * index] = u[index];
+                uv[2 * index + 1] = v[index];
+            }
+        }
+
+        constexpr row_kernel scalar_kernel{ isa::scalar, copy_row_scalar, split_row_scalar, merge_row_scalar };
+
+#ifdef MEDIA_KERNEL_X64
+        //-- sse2, baseline of x64
+        void copy_row_sse2(uint8_t* target, const uint8_t* source, const int width) {
+            auto index = 0;
+            for (; index + 64 <= width; index += 64) {
+                const auto block0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + index));
+                const auto block1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + index + 16));
+                const auto block2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + index + 32));
+                const auto block3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + index + 48));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(target + index), block0);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(target + index + 16), block1);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(target + index + 32), block2);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(target + index + 48), block3);
+            }
+            for (; index + 16 <= width; index += 16) {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(target + index),
+                                 _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + index)));
+            }
+            copy_row_scalar(target + index, source + index, width - index);
+        }
+
+        void split_row_sse2(const uint8_t* uv, uint8_t* u, uint8_t* v, const int width) {
+            const auto low_mask = _mm_set1_epi16(0x00ff);
+            auto index = 0;
+            for (; index + 16 <= width; index += 16) {
+                const auto block0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(uv + 2 * index));
+                const auto block1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(uv + 2 * index + 16));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(u + index),
+                                 _mm_packus_epi16(_mm_and_si128(block0, low_mask),
+                                                  _mm_and_si128(block1, low_mask)));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(v + index),
+                                 _mm_packus_epi16(_mm_srli_epi16(block0, 8),
+                                                  _mm_srli_epi16(block1, 8)));
+            }
+            split_row_scalar(uv + 2 * index, u + index, v + index, width - index);
+        }
+
+        void merge_row_sse2(const uint8_t* u, const uint8_t* v, uint8_t* uv, const int width) {
+            auto index = 0;
+            for (; index + 16 <= width; index += 16) {
+                const auto u_block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(u + index));
+                const auto v_block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(v + index));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(uv + 2 * index),
+                                 _mm_unpacklo_epi8(u_block, v_block));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(uv + 2 * index + 16),
+                                 _mm_unpackhi_epi8(u_block, v_block));
+            }
+            merge_row_scalar(u + index, v + index, uv + 2 * index, width - index);
+        }
+
+        constexpr row_kernel sse2_kernel{ isa::sse2, copy_row_sse2, split_row_sse2, merge_row_sse2 };
+
+        //-- avx2, pack and unpack work within 128 bit lanes so results are permuted back
+        MEDIA_KERNEL_AVX2 void copy_row_avx2(uint8_t* target, const uint8_t* source, const int width) {
+            auto index = 0;
+            for (; index + 128 <= width; index += 128) {
+                const auto block0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + index));
+                const auto block1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + index + 32));
+                const auto block2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + index + 64));
+                const auto block3 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + index + 96));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(target + index), block0);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(target + index + 32), block1);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(target + index + 64), block2);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(target + index + 96), block3);
+            }
+            for (; index + 32 <= width; index += 32) {
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(target + index),
+                                    _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + index)));
+            }
+            copy_row_sse2(target + index, source + index, width - index);
+        }
+
+        MEDIA_KERNEL_AVX2 void split_row_avx2(const uint8_t* uv, uint8_t* u, uint8_t* v, const int width) {
+            const auto low_mask = _mm256_set1_epi16(0x00ff);
+            auto index = 0;
+            for (; index + 32 <= width; index += 32) {
+                const auto block0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(uv + 2 * index));
+                const auto block1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(uv + 2 * index + 32));
+                const auto u_block = _mm256_packus_epi16(_mm256_and_si256(block0, low_mask),
+                                                         _mm256_and_si256(block1, low_mask));
+                const auto v_block = _mm256_packus_epi16(_mm256_srli_epi16(block0, 8),
+                                                         _mm256_srli_epi16(block1, 8));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(u + index),
+                                    _mm256_permute4x64_epi64(u_block, 0xd8));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(v + index),
+                                    _mm256_permute4x64_epi64(v_block, 0xd8));
+            }
+            split_row_sse2(uv + 2 * index, u + index, v + index, width - index);
+        }
+
+        MEDIA_KERNEL_AVX2 void merge_row_avx2(const uint8_t* u, const uint8_t* v, uint8_t* uv, const int width) {
+            auto index = 0;
+            for (; index + 32 <= width; index += 32) {
+                const auto u_block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(u + index));
+                const auto v_block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(v + index));
+                const auto low = _mm256_unpacklo_epi8(u_block, v_block);
+                const auto high = _mm256_unpackhi_epi8(u_block, v_block);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(uv + 2 * index),
+                                    _mm256_permute2x128_si256(low, high, 0x20));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(uv + 2 * index + 32),
+                                    _mm256_permute2x128_si256(low, high, 0x31));
+            }
+            merge_row_sse2(u + index, v + index, uv + 2 * index, width - index);
+        }
+
+        constexpr row_kernel avx2_kernel{ isa::avx2, copy_row_avx2, split_row_avx2, merge_row_avx2 };
+
+        bool support_avx2() noexcept {
+#ifdef _MSC_VER
+            int info[4] = {};
+            __cpuid(info, 0);
+            if (info[0] < 7) {
+                return false;
+            }
+            __cpuid(info, 1);
+            const auto os_save = (info[2] & (1 << 27)) != 0;
+            const auto avx = (info[2] & (1 << 28)) != 0;
+            if (!os_save || !avx || (_xgetbv(0) & 0x6) != 0x6) {
+                return false;
+            }
+            __cpuidex(info, 7, 0);
+            return (info[1] & (1 << 5)) != 0;
+#else
+            return __builtin_cpu_supports("avx2");
+#endif
+        }
+#endif
+
+        const row_kernel& kernel_of(const isa target) noexcept {
+            switch (target) {
+#ifdef MEDIA_KERNEL_X64
+            case isa::avx2:
+                return avx2_kernel;
+            case isa::sse2:
+                return sse2_kernel;
+#endif
+            default:
+                return scalar_kernel;
+            }
+        }
+
+        std::atomic<const row_kernel*> active_kernel{ nullptr };
+
+        const row_kernel& kernel() noexcept {
+            if (const auto* current = active_kernel.load(std::memory_order_acquire)) {
+                return *current;
+            }
+            const auto& detected = kernel_of(detect());
+            active_kernel.store(&detected, std::memory_order_release);
+            return detected;
+        }
+    }
+
+    isa detect() noexcept {
+#ifdef MEDIA_KERNEL_X64
+        static const auto detected = support_avx2() ? isa::avx2 : isa::sse2;
+        return detected;
+#else
+        return isa::scalar;
+#endif
+    }
+
+    isa active() noexcept {
+        return kernel().target;
+    }
+
+    isa activate(const isa target) noexcept {
+        const auto supported = static_cast<int>(target) <= static_cast<int>(detect()) ? target : detect();
+        active_kernel.store(&kernel_of(supported), std::memory_order_release);
+        return supported;
+    }
+
+    std::string_view name(const isa target) noexcept {
+        switch (target) {
+        case isa::avx2:
+            return "avx2";
+        case isa::sse2:
+            return "sse2";
+        default:
+            return "scalar";
+        }
+    }
+
+    void copy_plane(uint8_t* target, const int target_stride,
+                    const uint8_t* source, const int source_stride,
+                    const int width, const int height) {
+        assert(width <= target_stride && width <= source_stride);
+        const auto& row = kernel();
+        // unpadded planes are one contiguous run
+        if (target_stride == width && source_stride == width) {
+            row.copy(target, source, width * height);
+            return;
+        }
+        for (auto line = 0; line < height; ++line) {
+            row.copy(target + static_cast<ptrdiff_t>(line) * target_stride,
+                     source + static_cast<ptrdiff_t>(line) * source_stride, width);
+        }
+    }
+
+    void copy_plane_padded(uint8_t* target, const int target_stride,
+                           const uint8_t* source, const int source_stride,
+                           const int width, const int height) {
+        assert(width > 0 && width <= target_stride && width <= source_stride);
+        const auto& row = kernel();
+        for (auto line = 0; line < height; ++line) {
+            auto* target_row = target + static_cast<ptrdiff_t>(line) * target_stride;
+            row.copy(target_row, source + static_cast<ptrdiff_t>(line) * source_stride, width);
+            std::memset(target_row + width, target_row[width - 1], target_stride - width);
+        }
+    }
+
+    void nv12_to_i420(const uint8_t* uv, const int uv_stride,
+                      uint8_t* u, const int u_stride,
+                      uint8_t* v, const int v_stride,
+                      const int width, const int height) {
+        assert(2 * width <= uv_stride && width <= u_stride && width <= v_stride);
+        const auto& row = kernel();
+        for (auto line = 0; line < height; ++line) {
+            row.split(uv + static_cast<ptrdiff_t>(line) * uv_stride,
+                      u + static_cast<ptrdiff_t>(line) * u_stride,
+                      v + static_cast<ptrdiff_t>(line) * v_stride, width);
+        }
+    }
+
+    void i420_to_nv12(const uint8_t* u, const int u_stride,
+                      const uint8_t* v, const int v_stride,
+                      uint8_t* uv, const int uv_stride,
+                      const int width, const int height) {
+        assert(2 * width <= uv_stride && width <= u_stride && width <= v_stride);
+        const auto& row = kernel();
+        for (auto line = 0; line < height; ++line) {
+            row.merge(u + static_cast<ptrdiff_t>(line) * u_stride,
+                      v + static_cast<ptrdiff_t>(line) * v_stride,
+                      uv + static_cast<ptrdiff_t>(line) * uv_stride, width);
+        }
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+
+namespace media::kernel
+{
+    enum class isa
+    {
+        scalar, sse2, avx2,
+    };
+
+    // widest instruction set supported by running cpu
+    isa detect() noexcept;
+
+    // instruction set kernels dispatch to, detected one unless activated otherwise
+    isa active() noexcept;
+
+    // lowered to detected instruction set if unsupported, e.g. benchmark against scalar
+    isa activate(isa target) noexcept;
+
+    std::string_view name(isa target) noexcept;
+
+    // width x height bytes between planes of any line stride, e.g. padded decoder linesize
+    void copy_plane(uint8_t* target, int target_stride,
+                    const uint8_t* source, int source_stride,
+                    int width, int height);
+
+    // as copy_plane, tail of every target row up to target_stride repeats its last byte
+    void copy_plane_padded(uint8_t* target, int target_stride,
+                           const uint8_t* source, int source_stride,
+                           int width, int height);
+
+    // interleaved chroma plane of NV12 into U and V planes of I420, width and height
+    // are of chroma planes, i.e. half of luma
+    void nv12_to_i420(const uint8_t* uv, int uv_stride,
+                      uint8_t* u, int u_stride,
+                      uint8_t* v, int v_stride,
+                      int width, int height);
+
+    void i420_to_nv12(const uint8_t* u, int u_stride,
+                      const uint8_t* v, int v_stride,
+                      uint8_t* uv, int uv_stride,
+                      int width, int height);
+}
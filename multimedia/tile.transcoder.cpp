@@ -0,0 +1,250 @@
+#include "stdafx.h"
+#include "tile.transcoder.h"
+#include "context.h"
+#include "core/core.h"
+#include "core/exception.hpp"
+#include "core/verify.hpp"
+#include <folly/executors/ThreadPoolExecutor.h>
+#include <folly/futures/Future.h>
+#include <folly/ScopeGuard.h>
+#include <folly/synchronization/Baton.h>
+#include <fmt/format.h>
+#include <deque>
+#include <thread>
+
+namespace media
+{
+    namespace
+    {
+        auto floor_even = [](const int num) constexpr {
+            return num - num % 2;
+        };
+
+        auto x264_codec = [] {
+            const auto encoder = avcodec_find_encoder_by_name("libx264");
+            core::verify(encoder);
+            return codec{ encoder };
+        };
+
+        auto make_muxer = [](const std::filesystem::path& path) {
+            const auto path_string = path.string();
+            return format_context{ sink::path{ path_string.data() } };
+        };
+
+        constexpr auto x264_gop_params = "keyint=30:min-keyint=30:scenecut=0:no-scenecut=1";
+    }
+
+    // each encoder is only touched by one worker at a time, its tasks are chained in frame order
+    struct tile_transcoder::encoder final
+    {
+        const tile position;
+        const int width_offset;
+        const int height_offset;
+        const format_context muxer;
+        const codec_context encode_context;
+        const stream target;
+
+        encoder(const tile& position, const int width_offset, const int height_offset,
+                const std::filesystem::path& path, encode_param param)
+            : position{ position }
+            , width_offset{ width_offset }
+            , height_offset{ height_offset }
+            , muxer{ make_muxer(path) }
+            , encode_context{
+                [&] {
+                    param.global_header = muxer.global_header();
+                    return codec_context{ x264_codec(), param, 1 };
+                }()
+            }
+            , target{ muxer.mux(encode_context) } {
+            muxer.write_header();
+        }
+
+        // crop only offsets plane pointers, picture buffers are shared with every other tile
+        int64_t encode(const frame& picture) const {
+            frame cropped;
+            core::verify(av_frame_ref(cropped.operator->(), picture.operator->()));
+            cropped->crop_left = width_offset;
+            cropped->crop_top = height_offset;
+            cropped->crop_right = picture->width - width_offset - encode_context->width;
+            cropped->crop_bottom = picture->height - height_offset - encode_context->height;
+            core::verify(av_frame_apply_cropping(cropped.operator->(), AV_FRAME_CROP_UNALIGNED));
+            // keyframe placement follows gop params rather than source picture types
+            cropped->pict_type = AV_PICTURE_TYPE_NONE;
+            return write(encode_context.encode(cropped));
+        }
+
+        int64_t finish() const {
+            const auto packet_count = write(encode_context.encode(frame{ nullptr }));
+            muxer.write_trailer();
+            return packet_count;
+        }
+
+    private:
+        int64_t write(const detail::vector<packet>& packets) const {
+            for (auto& compressed : packets) {
+                muxer.write(compressed, target, encode_context->time_base);
+            }
+            return packets.size();
+        }
+    };
+
+    struct tile_transcoder::frame_barrier final
+    {
+        std::atomic<size_t> pending_count;
+        folly::Baton<> baton;
+
+        explicit frame_barrier(const size_t count)
+            : pending_count{ count } {}
+
+        void arrive() {
+            if (pending_count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                baton.post();
+            }
+        }
+    };
+
+    tile_transcoder::tile_transcoder(std::filesystem::path input, const int wcrop, const int hcrop,
+                                     std::vector<int> qp_ladder, path_generator output_path,
+                                     const unsigned concurrency)
+        : input_{ std::move(input) }
+        , wcrop_{ wcrop }
+        , hcrop_{ hcrop }
+        , qp_ladder_{ std::move(qp_ladder) }
+        , output_path_{ std::move(output_path) } {
+        assert(wcrop_ > 0 && hcrop_ > 0);
+        assert(!qp_ladder_.empty());
+        assert(output_path_ != nullptr);
+        const auto thread_count = concurrency > 0
+                                      ? concurrency
+                                      : std::max(1u, std::thread::hardware_concurrency());
+        encode_executor_ = core::make_pool_executor(static_cast<int>(thread_count), "TileTranscoder");
+    }
+
+    tile_transcoder::~tile_transcoder() {
+        encode_executor_->join();
+    }
+
+    // every libx264 encoder holds its own lookahead and reference pictures, a long ladder of
+    // fine tiles is split into passes rather than kept alive at once
+    void tile_transcoder::transcode(const size_t pending_frames, const size_t max_encoders) {
+        const auto rung_size = static_cast<size_t>(wcrop_) * hcrop_;
+        const auto pass_size = std::max<size_t>(1, max_encoders / rung_size);
+        for (auto rung = qp_ladder_.begin(); rung != qp_ladder_.end();) {
+            const auto pass_end = rung + std::min<size_t>(pass_size, std::distance(rung, qp_ladder_.end()));
+            transcode_pass({ rung, pass_end }, pending_frames);
+            rung = pass_end;
+        }
+    }
+
+    void tile_transcoder::transcode_pass(const std::vector<int>& qp_pass, const size_t pending_frames) {
+        const auto input_string = input_.string();
+        format_context input_format{ source::path{ input_string.data() } };
+        const auto video_stream = input_format.demux(type::video);
+        const codec_context decoder{ input_format, type::video, 0 };
+        if (decoder->pix_fmt != AV_PIX_FMT_YUV420P && decoder->pix_fmt != AV_PIX_FMT_YUVJ420P) {
+            core::not_implemented_error::throw_directly();
+        }
+        const auto [width, height] = video_stream.scale();
+        encode_param param;
+        param.width = floor_even(width / wcrop_);
+        param.height = floor_even(height / hcrop_);
+        param.time_base = video_stream->time_base;
+        if (const auto frame_rate = av_guess_frame_rate(input_format.operator->(), video_stream.operator->(), nullptr);
+            frame_rate.num > 0 && frame_rate.den > 0) {
+            param.frame_rate = frame_rate;
+        }
+        std::vector<std::unique_ptr<encoder>> encoders;
+        encoders.reserve(qp_pass.size() * wcrop_ * hcrop_);
+        for (const auto qp : qp_pass) {
+            param.options = {
+                { "qp", fmt::to_string(qp) },
+                { "x264-params", x264_gop_params },
+            };
+            for (auto row = 0; row < hcrop_; ++row) {
+                for (auto col = 0; col < wcrop_; ++col) {
+                    const tile position{ col, row, qp };
+                    encoders.push_back(std::make_unique<encoder>(
+                        position, col * param.width, row * param.height, output_path_(position), param));
+                }
+            }
+        }
+        std::vector<folly::Future<folly::Unit>> encode_chains;
+        std::generate_n(std::back_inserter(encode_chains), encoders.size(), [] {
+            return folly::makeFuture();
+        });
+        // workers reference encoders, none may outlive this frame even if decoding throws
+        auto chain_guard = folly::makeGuard([&encode_chains] {
+            for (auto& chain : encode_chains) {
+                if (chain.valid()) {
+                    chain.wait();
+                }
+            }
+        });
+        const auto encode_failed = [&encode_chains] {
+            return std::any_of(encode_chains.begin(), encode_chains.end(),
+                               [](const folly::Future<folly::Unit>& chain) {
+                                   return chain.isReady() && chain.hasException();
+                               });
+        };
+        const auto frame_interval = av_rescale_q(1, av_inv_q(param.frame_rate), param.time_base);
+        std::deque<std::shared_ptr<frame_barrier>> pending_barriers;
+        int64_t pass_decode_count = 0;
+        const auto dispatch = [&](frame&& decoded) {
+            if (decoded->best_effort_timestamp != AV_NOPTS_VALUE) {
+                decoded->pts = decoded->best_effort_timestamp;
+            } else {
+                decoded->pts = pass_decode_count * frame_interval;
+            }
+            ++pass_decode_count;
+            ++decode_count_;
+            const auto picture = std::make_shared<frame>(std::move(decoded));
+            const auto barrier = std::make_shared<frame_barrier>(encoders.size());
+            for (size_t index = 0; index < encoders.size(); ++index) {
+                encode_chains[index] = std::move(encode_chains[index])
+                                       .via(encode_executor_.get())
+                                       .thenValue([this, &tile_encoder = *encoders[index], picture](folly::Unit) {
+                                           packet_count_ += tile_encoder.encode(*picture);
+                                       })
+                                       .ensure([barrier] {
+                                           barrier->arrive();
+                                       });
+            }
+            pending_barriers.push_back(barrier);
+            while (pending_barriers.size() > pending_frames) {
+                pending_barriers.front()->baton.wait();
+                pending_barriers.pop_front();
+            }
+        };
+        auto packet_empty = false;
+        do {
+            const auto compressed = input_format.read(type::video);
+            packet_empty = compressed.empty();
+            for (auto& decoded : decoder.decode(compressed)) {
+                dispatch(std::move(decoded));
+            }
+        } while (!packet_empty && !encode_failed());
+        for (size_t index = 0; index < encoders.size(); ++index) {
+            encode_chains[index] = std::move(encode_chains[index])
+                                   .via(encode_executor_.get())
+                                   .thenValue([this, &tile_encoder = *encoders[index]](folly::Unit) {
+                                       packet_count_ += tile_encoder.finish();
+                                   });
+        }
+        for (auto& chain : encode_chains) {
+            std::move(chain).get();
+        }
+    }
+
+    int64_t tile_transcoder::decode_count() const noexcept {
+        return decode_count_.load(std::memory_order_acquire);
+    }
+
+    int64_t tile_transcoder::packet_count() const noexcept {
+        return packet_count_.load(std::memory_order_acquire);
+    }
+
+    size_t tile_transcoder::encoder_count() const noexcept {
+        return qp_ladder_.size() * wcrop_ * hcrop_;
+    }
+}
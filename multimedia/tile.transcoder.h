@@ -0,0 +1,69 @@
+#pragma once
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace folly
+{
+    class ThreadPoolExecutor;
+}
+
+namespace media
+{
+    // decodes source video once per pass and crops every tile of every decoded picture by reference,
+    // each tile of each qp in the pass is encoded by its own libx264 encoder on a shared worker pool
+    class tile_transcoder final
+    {
+    public:
+        struct tile final
+        {
+            int col = 0;
+            int row = 0;
+            int qp = 0;
+        };
+
+        using path_generator = std::function<std::filesystem::path(const tile&)>;
+
+        // decoded pictures the decoder may run ahead of slowest encoder
+        static constexpr inline size_t default_pending_frames = 8;
+
+        // live encoders of one pass, a pass holds whole qp rungs and at least one
+        static constexpr inline size_t default_max_encoders = 32;
+
+    private:
+        struct encoder;
+        struct frame_barrier;
+
+        void transcode_pass(const std::vector<int>& qp_pass, size_t pending_frames);
+
+        const std::filesystem::path input_;
+        const int wcrop_;
+        const int hcrop_;
+        const std::vector<int> qp_ladder_;
+        const path_generator output_path_;
+        std::shared_ptr<folly::ThreadPoolExecutor> encode_executor_;
+        std::atomic<int64_t> decode_count_{ 0 };
+        std::atomic<int64_t> packet_count_{ 0 };
+
+    public:
+        tile_transcoder(std::filesystem::path input, int wcrop, int hcrop,
+                        std::vector<int> qp_ladder, path_generator output_path,
+                        unsigned concurrency = 0);
+        tile_transcoder(const tile_transcoder&) = delete;
+        tile_transcoder(tile_transcoder&&) = delete;
+        tile_transcoder& operator=(const tile_transcoder&) = delete;
+        tile_transcoder& operator=(tile_transcoder&&) = delete;
+        ~tile_transcoder();
+
+        // blocks until every tile file is finalized, rethrows first encoder failure
+        void transcode(size_t pending_frames = default_pending_frames,
+                       size_t max_encoders = default_max_encoders);
+
+        // decoded pictures summed over passes
+        int64_t decode_count() const noexcept;
+        int64_t packet_count() const noexcept;
+        size_t encoder_count() const noexcept;
+    };
+}
@@ -7,18 +7,31 @@ namespace net::server
     auto logger = core::console_logger_access("net.acceptor");
 
     acceptor<boost::asio::ip::tcp>::acceptor(boost::asio::ip::tcp::endpoint endpoint,
-                                             boost::asio::io_context& context, bool reuse_addr)
+                                             boost::asio::io_context& context, bool reuse_addr, bool reuse_port)
         : context_{ context }
-        , acceptor_{ context, endpoint, reuse_addr } {
+        , acceptor_{ context } {
+        acceptor_.open(endpoint.protocol());
+        if (reuse_addr) {
+            acceptor_.set_option(boost::asio::socket_base::reuse_address{ true });
+        }
+        if (reuse_port) {
+#if defined __linux__ && defined SO_REUSEPORT
+            acceptor_.set_option(boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>{ true });
+#else
+            logger().warn("reuse port unsupported, option ignored");
+#endif
+        }
+        acceptor_.bind(endpoint);
+        acceptor_.listen();
         assert(acceptor_.is_open());
         logger().info("listen address {}, port {}", endpoint.address(), listen_port());
     }
 
     acceptor<boost::asio::ip::tcp>::acceptor(uint16_t port,
-                                             boost::asio::io_context& context, bool reuse_addr)
+                                             boost::asio::io_context& context, bool reuse_addr, bool reuse_port)
         : acceptor{
             boost::asio::ip::tcp::endpoint{ boost::asio::ip::tcp::v4(), port },
-            context, reuse_addr
+            context, reuse_addr, reuse_port
         } {}
 
     uint16_t acceptor<boost::asio::ip::tcp>::listen_port() const {
@@ -30,8 +43,8 @@ namespace net::server
                                                     boost::asio::ip::tcp::socket socket) mutable {
             logger().info("on_accept error {}, message {}", error, error.message());
             if (error) {
-                promise.setException(std::runtime_error{ "acceptor error" });
-                return close(error);
+                // acceptor stays open, caller decides whether error is transient and accepts again
+                return promise.setException(boost::system::system_error{ error });
             }
             logger().info("on_accept local {} remote {}", socket.local_endpoint(), socket.remote_endpoint());
             promise.setValue(std::move(socket));
@@ -44,6 +57,13 @@ namespace net::server
         return std::move(future);
     }
 
+    auto acceptor<boost::asio::ip::tcp>::accept_socket(boost::asio::io_context& peer_context)
+        -> folly::SemiFuture<socket_type> {
+        auto [promise, future] = folly::makePromiseContract<socket_type>();
+        acceptor_.async_accept(peer_context, on_accept(std::move(promise)));
+        return std::move(future);
+    }
+
     void acceptor<boost::asio::ip::tcp>::close(std::optional<boost::system::error_code> error,
                                                bool cancel) {
         if (error.has_value()) {
@@ -14,16 +14,28 @@ namespace net::server
         boost::asio::ip::tcp::acceptor acceptor_;
 
     public:
+#if defined __linux__ && defined SO_REUSEPORT
+        static constexpr inline bool reuse_port_supported = true;
+#else
+        static constexpr inline bool reuse_port_supported = false;
+#endif
+
+        // reuse port lets acceptors of several io_context bind one port, kernel balances
+        // incoming connections among them, ignored where reuse_port_supported is false
         acceptor(boost::asio::ip::tcp::endpoint endpoint,
-                 boost::asio::io_context& context, bool reuse_addr = false);
+                 boost::asio::io_context& context, bool reuse_addr = false, bool reuse_port = false);
 
         acceptor(uint16_t port,
-                 boost::asio::io_context& context, bool reuse_addr = false);
+                 boost::asio::io_context& context, bool reuse_addr = false, bool reuse_port = false);
 
         uint16_t listen_port() const;
 
+        // fails with boost::system::system_error, operation_aborted once acceptor is closed
         folly::SemiFuture<socket_type> accept_socket();
 
+        // accepted socket is associated with peer context, promise is fulfilled on this one
+        folly::SemiFuture<socket_type> accept_socket(boost::asio::io_context& peer_context);
+
         template <typename Protocal, typename ...SessionArgs>
         folly::SemiFuture<session_ptr<Protocal>> listen_session(SessionArgs&& ...args) {
             return accept_socket().deferValue(
@@ -0,0 +1,77 @@
+#include "stdafx.h"
+#include "byte.range.h"
+#include <absl/strings/ascii.h>
+#include <absl/strings/match.h>
+#include <absl/strings/numbers.h>
+#include <absl/strings/str_split.h>
+#include <fmt/format.h>
+#include <algorithm>
+
+namespace net
+{
+    namespace
+    {
+        auto parse_position = [](std::string_view text) -> std::optional<uint64_t> {
+            uint64_t position = 0;
+            if (text.empty() || !absl::ascii_isdigit(text.front()) || !absl::SimpleAtoi(text, &position)) {
+                return std::nullopt;
+            }
+            return position;
+        };
+    }
+
+    std::optional<std::vector<byte_range>> parse_byte_ranges(std::string_view header, const uint64_t size,
+                                                             const size_t max_ranges) {
+        constexpr std::string_view unit = "bytes=";
+        header = absl::StripAsciiWhitespace(header);
+        if (header.size() <= unit.size() || !absl::EqualsIgnoreCase(header.substr(0, unit.size()), unit)) {
+            return std::vector<byte_range>{};
+        }
+        std::vector<byte_range> ranges;
+        size_t spec_count = 0;
+        for (std::string_view spec : absl::StrSplit(header.substr(unit.size()), ',', absl::SkipWhitespace{})) {
+            spec = absl::StripAsciiWhitespace(spec);
+            const auto dash = spec.find('-');
+            // a syntactically invalid or abusive set is ignored as a whole per rfc 7233
+            if (dash == std::string_view::npos || ++spec_count > max_ranges) {
+                return std::vector<byte_range>{};
+            }
+            const auto first = spec.substr(0, dash);
+            const auto last = spec.substr(dash + 1);
+            if (first.empty()) {
+                const auto suffix = parse_position(last);
+                if (!suffix.has_value()) {
+                    return std::vector<byte_range>{};
+                }
+                if (*suffix > 0 && size > 0) {
+                    const auto length = std::min(*suffix, size);
+                    ranges.push_back(byte_range{ size - length, length });
+                }
+                continue;
+            }
+            const auto first_position = parse_position(first);
+            const auto last_position = last.empty() ? std::optional<uint64_t>{ UINT64_MAX } : parse_position(last);
+            if (!first_position.has_value() || !last_position.has_value() || *last_position < *first_position) {
+                return std::vector<byte_range>{};
+            }
+            if (*first_position < size) {
+                const auto end = std::min(*last_position, size - 1);
+                ranges.push_back(byte_range{ *first_position, end - *first_position + 1 });
+            }
+        }
+        if (spec_count == 0) {
+            return std::vector<byte_range>{};
+        }
+        if (ranges.empty()) {
+            return std::nullopt;
+        }
+        return ranges;
+    }
+
+    std::string content_range(const std::optional<byte_range>& range, const uint64_t size) {
+        if (!range.has_value()) {
+            return fmt::format("bytes */{}", size);
+        }
+        return fmt::format("bytes {}-{}/{}", range->offset, range->offset + range->length - 1, size);
+    }
+}
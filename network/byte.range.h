@@ -0,0 +1,26 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace net
+{
+    struct byte_range final
+    {
+        uint64_t offset = 0;
+        uint64_t length = 0;
+    };
+
+    inline constexpr size_t default_max_byte_ranges = 64;
+
+    // satisfiable ranges of a Range header value over a representation of size bytes, in request
+    // order, empty if header is not a valid bytes range set and whole representation is sent,
+    // nullopt if none is satisfiable and 416 is due
+    std::optional<std::vector<byte_range>> parse_byte_ranges(std::string_view header, uint64_t size,
+                                                             size_t max_ranges = default_max_byte_ranges);
+
+    // Content-Range value, bytes */size for an unsatisfiable request
+    std::string content_range(const std::optional<byte_range>& range, uint64_t size);
+}
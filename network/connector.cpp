@@ -20,6 +20,11 @@ namespace net::client
         for (auto& connect_token : connect_list_) {
             connect_token.socket.setException(std::runtime_error{ errc.message() });
         }
+        connect_list_.clear();
+    }
+
+    std::string connector<protocal::tcp>::endpoint_key(const connect_token& connect_token) {
+        return fmt::format("{}:{}", connect_token.host, connect_token.service);
     }
 
     auto connector<protocal::tcp>::on_resolve() {
@@ -30,20 +35,24 @@ namespace net::client
             if (error) {
                 return fail_socket_then_cancel(error);
             }
+            auto endpoint_key = connector::endpoint_key(connect_list_.front());
+            endpoint_cache_.emplace(endpoint_key, endpoints);
             auto socket_ptr = std::make_unique<socket_type>(context_);
             auto& socket_ref = socket_ptr.operator*();
             boost::asio::async_connect(
                 socket_ref, endpoints, [this,
                     socket_ptr = std::move(socket_ptr),
-                    promise = std::move(connect_list_.front().socket)
+                    promise = std::move(connect_list_.front().socket),
+                    endpoint_key = std::move(endpoint_key)
                 ](boost::system::error_code error,
                   boost::asio::ip::tcp::endpoint endpoint) mutable {
                     logger().info("on_connect error {} message {}", error, error.message());
                     if (error) {
-                        promise.setException(std::runtime_error{ error.message() });
-                        boost::asio::post(connect_sequence_, [=] {
-                            fail_socket_then_cancel(error);
+                        // host may have moved, next connect resolves again, other connects go on
+                        boost::asio::post(connect_sequence_, [this, endpoint_key = std::move(endpoint_key)] {
+                            endpoint_cache_.erase(endpoint_key);
                         });
+                        promise.setException(std::runtime_error{ error.message() });
                         return;
                     }
                     promise.setValue(std::move(*socket_ptr));
@@ -73,6 +82,12 @@ namespace net::client
     void connector<protocal::tcp>::resolve_front_endpoint() {
         assert(connect_sequence_.running_in_this_thread());
         auto& connect_token = connect_list_.front();
+        if (const auto endpoint_iter = endpoint_cache_.find(endpoint_key(connect_token));
+            endpoint_iter != endpoint_cache_.end()) {
+            return boost::asio::post(connect_sequence_, [this, endpoints = endpoint_iter->second] {
+                on_resolve()(boost::system::error_code{}, endpoints);
+            });
+        }
         resolver_.async_resolve(connect_token.host, connect_token.service,
                                 boost::asio::bind_executor(connect_sequence_, on_resolve()));
     }
@@ -2,6 +2,7 @@
 #include "network/net.h"
 #include "network/session.client.h"
 #include <boost/asio/strand.hpp>
+#include <unordered_map>
 
 namespace net::client
 {
@@ -21,11 +22,13 @@ namespace net::client
 
 		using connect_list = std::list<connect_token>;
 		using connect_sequence = boost::asio::strand<boost::asio::io_context::executor_type>;
+		using endpoint_cache = std::unordered_map<std::string, boost::asio::ip::tcp::resolver::results_type>;
 
 		boost::asio::io_context& context_;
 		boost::asio::ip::tcp::resolver resolver_;
 		connect_list connect_list_;
 		connect_sequence connect_sequence_;
+		endpoint_cache endpoint_cache_; // host:service resolved once until a connect fails, accessed in connect sequence
 
 	public:
 		explicit connector(boost::asio::io_context& context);
@@ -45,6 +48,8 @@ namespace net::client
 		}
 
 	private:
+		static std::string endpoint_key(const connect_token& connect_token);
+
 		auto on_resolve();
 
 		void resolve_front_endpoint();
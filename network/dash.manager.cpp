@@ -6,11 +6,13 @@
 #include <boost/circular_buffer.hpp>
 #include <boost/logic/tribool.hpp>
 #include <fmt/ostream.h>
+#include <folly/executors/InlineExecutor.h>
 #include <folly/futures/FutureSplitter.h>
 #include <folly/Random.h>
 #include <folly/Uri.h>
 #include <absl/time/time.h>
 #include <absl/time/clock.h>
+#include <deque>
 
 using boost::logic::tribool;
 using boost::logic::indeterminate;
@@ -18,6 +20,7 @@ using net::protocal::http;
 using net::protocal::dash;
 using ordinal = std::pair<int16_t, int16_t>;
 using http_session_ptr = net::client::session<http>::pointer;
+using http_session_shared = std::shared_ptr<net::client::session<http>>;
 using io_context_ptr = std::invoke_result_t<decltype(&net::make_asio_pool), unsigned>;
 using net::dash_manager;
 
@@ -27,8 +30,9 @@ namespace net::protocal
     {
         boost::circular_buffer<size_t> trace{ 120 };
         size_t trace_index = 0;
-        folly::SemiFuture<http_session_ptr> http_session = folly::SemiFuture<http_session_ptr>::makeEmpty();
         bool drain = false;
+        // size of last segment, charged for a request of the tile until its own size is known
+        std::atomic<int64_t> segment_size{ 0 };
     };
 }
 
@@ -41,15 +45,25 @@ namespace net
 {
     //-- buffer_sequence
     buffer_sequence::buffer_sequence(detail::multi_buffer& initial,
-                                     detail::multi_buffer&& data,
+                                     core::segment_buffer&& data,
                                      absl::Duration duration)
         : initial(initial)
         , data(std::move(data))
         , duration{ duration } {}
 
+    buffer_sequence::buffer_sequence(detail::multi_buffer& initial,
+                                     core::segment_buffer&& data,
+                                     std::shared_ptr<core::chunk_stream> stream,
+                                     absl::Duration duration)
+        : initial(initial)
+        , data(std::move(data))
+        , stream(std::move(stream))
+        , duration{ duration } {}
+
     buffer_sequence::buffer_sequence(buffer_sequence&& that) noexcept
         : initial(that.initial)
         , data(std::move(that.data))
+        , stream(std::move(that.stream))
         , duration{ that.duration } {}
 }
 
@@ -67,6 +81,24 @@ namespace net
         std::shared_ptr<spdlog::logger> logger;
         std::shared_ptr<folly::ThreadPoolExecutor> executor;
         int drain_count = 0;
+        unsigned prefetch_window = 1;
+        int64_t prefetch_budget = std::numeric_limits<int64_t>::max();
+        std::atomic<int64_t> buffered_size{ 0 };
+        bool stream_body = false;
+
+        struct session_slot final
+        {
+            // shared by requests issued while connecting, replaced once connection fails
+            folly::FutureSplitter<http_session_shared> session;
+            std::atomic<int64_t> outstanding{ 0 };
+        };
+
+        // tile streamers of the host share connections, established together on first request,
+        // a failed connection is established again by next request assigned to its slot
+        std::mutex session_mutex;
+        std::deque<session_slot> session_pool;
+        unsigned max_connections = default_max_connections;
+        size_t session_cursor = 0;
         std::variant<detail::predict_callback,
                      detail::select_callback> adaptation_callback{
             std::in_place_type<detail::predict_callback>,
@@ -75,6 +107,28 @@ namespace net
             }
         };
 
+        // segment bytes counted in buffered_size, from request until consumer takes the segment,
+        // dropping a prefetched or failed segment releases them as well
+        struct buffered_charge final
+        {
+            std::shared_ptr<impl> owner;
+            int64_t size = 0;
+
+            explicit buffered_charge(std::shared_ptr<impl> owner)
+                : owner{ std::move(owner) } {}
+
+            buffered_charge(const buffered_charge&) = delete;
+            buffered_charge& operator=(const buffered_charge&) = delete;
+
+            ~buffered_charge() {
+                resize(0);
+            }
+
+            void resize(int64_t charge_size) {
+                owner->buffered_size += charge_size - std::exchange(size, charge_size);
+            }
+        };
+
         struct deleter final : std::default_delete<impl>
         {
             void operator()(impl* impl) noexcept {
@@ -120,9 +174,8 @@ namespace net
             return fmt::format(represent.media, video_set.context->trace_index);
         }
 
-        folly::SemiFuture<multi_buffer>
-        request_send(dash::video_adaptation_set& video_set,
-                     dash::represent& represent, bool initial = false) {
+        std::string request_target(dash::video_adaptation_set& video_set,
+                                   dash::represent& represent, bool initial) const {
             const auto replace_suffix = [](std::string path,
                                            std::string&& suffix) {
                 if (path.empty()) {
@@ -136,12 +189,82 @@ namespace net
                            ? represent.initial
                            : fmt::format(represent.media, video_set.context->trace_index);
             };
-            const auto url_path = replace_suffix(mpd_uri->path(), suffix(initial));
-            return video_set.context
-                            ->http_session.wait().value()
-                            ->send_request_for<multi_buffer>(
-                                net::make_http_request<empty_body>(mpd_uri->host(),
-                                                                   url_path));
+            return replace_suffix(mpd_uri->path(), suffix(initial));
+        }
+
+        folly::SemiFuture<multi_buffer>
+        request_send(dash::video_adaptation_set& video_set,
+                     dash::represent& represent, bool initial = false) {
+            const auto url_path = request_target(video_set, represent, initial);
+            return request_on_session(
+                [request = net::make_http_request<empty_body>(mpd_uri->host(), url_path)](
+                client::session<http>& session) mutable {
+                    return session.send_request_for<multi_buffer>(std::move(request));
+                });
+        }
+
+        folly::SemiFuture<core::segment_buffer>
+        request_segment(dash::video_adaptation_set& video_set,
+                        dash::represent& represent,
+                        std::shared_ptr<core::segment_pool> pool) {
+            const auto url_path = request_target(video_set, represent, false);
+            return request_on_session(
+                [request = net::make_http_request<empty_body>(mpd_uri->host(), url_path),
+                    pool = std::move(pool)](client::session<http>& session) mutable {
+                    return session.send_request_segment(std::move(request), std::move(pool));
+                });
+        }
+
+        // slot is released at header arrival, pipelined requests still queue behind the body
+        folly::SemiFuture<std::shared_ptr<core::chunk_stream>>
+        request_stream(dash::video_adaptation_set& video_set,
+                       dash::represent& represent) {
+            const auto url_path = request_target(video_set, represent, false);
+            return request_on_session(
+                [request = net::make_http_request<empty_body>(mpd_uri->host(), url_path)](
+                client::session<http>& session) mutable {
+                    return session.send_request_stream(std::move(request));
+                });
+        }
+
+        // request is sent once slot session connects, session outlives its pending request
+        // even if the slot is reconnected meanwhile
+        template <typename Send>
+        auto request_on_session(Send&& send) {
+            auto acquired = acquire_session();
+            return std::move(acquired.second)
+                   .deferValue([send = std::forward<Send>(send)](http_session_shared session) mutable {
+                       return send(*session).deferEnsure([session] {});
+                   })
+                   .via(&folly::InlineExecutor::instance())
+                   .ensure([slot = acquired.first] {
+                       slot->outstanding--;
+                   })
+                   .semi();
+        }
+
+        // least outstanding requests first, ties rotate so idle connections share load,
+        // connecting is left to the returned future and never waited under the lock
+        std::pair<session_slot*, folly::SemiFuture<http_session_shared>> acquire_session() {
+            std::lock_guard<std::mutex> lock{ session_mutex };
+            if (session_pool.empty()) {
+                for (auto index = 0u; index < max_connections; ++index) {
+                    session_pool.emplace_back().session = split_http_session();
+                }
+            }
+            auto* slot = &session_pool[session_cursor++ % session_pool.size()];
+            for (auto& candidate : session_pool) {
+                if (candidate.outstanding < slot->outstanding) {
+                    slot = &candidate;
+                }
+            }
+            if (auto session = slot->session.getSemiFuture();
+                session.isReady() && (session.hasException() || !session.value()->active())) {
+                // only requests already queued on the failed connection see its error
+                slot->session = split_http_session();
+            }
+            slot->outstanding++;
+            return { slot, slot->session.getSemiFuture() };
         }
 
         folly::SemiFuture<std::shared_ptr<multi_buffer>>
@@ -159,11 +282,21 @@ namespace net
                             ->getSemiFuture();
         }
 
+        folly::FutureSplitter<http_session_shared> split_http_session() {
+            return folly::splitFuture(
+                make_http_session()
+                .via(&folly::InlineExecutor::instance())
+                .thenValue([](http_session_ptr session) {
+                    return http_session_shared{ std::move(session) };
+                }));
+        }
+
         folly::SemiFuture<http_session_ptr> make_http_session() {
             return connector->establish_session<http>(mpd_uri->host(),
                                                       folly::to<std::string>(mpd_uri->port()))
                             .deferValue([this](http_session_ptr session) {
                                 session->trace_by(logger_sink);
+                                session->pipeline_by(prefetch_window);
                                 return session;
                             });
         }
@@ -242,26 +375,89 @@ namespace net
              .emplace<detail::select_callback>(std::move(callback));
     }
 
+    void dash_manager::prefetch_by(unsigned window, int64_t budget) const {
+        assert(window > 0 && budget > 0);
+        impl_->prefetch_window = window;
+        impl_->prefetch_budget = budget;
+    }
+
+    void dash_manager::stream_by(bool enable) const {
+        impl_->stream_body = enable;
+    }
+
+    void dash_manager::connect_by(unsigned max_connections) const {
+        assert(max_connections > 0);
+        std::lock_guard<std::mutex> lock{ impl_->session_mutex };
+        assert(impl_->session_pool.empty() && "connection pool already established");
+        impl_->max_connections = std::max(max_connections, 1u);
+    }
+
+    int64_t dash_manager::buffered_size() const {
+        return impl_->buffered_size.load(std::memory_order_relaxed);
+    }
+
     folly::Function<folly::SemiFuture<buffer_sequence>()>
     dash_manager::tile_streamer(core::coordinate coordinate) {
         auto& video_set = impl_->mpd_parser->video_set(coordinate);
         assert(video_set.col == coordinate.col);
         assert(video_set.row == coordinate.row);
-        core::access(video_set.context)->http_session = impl_->make_http_session();
-        return [this, &video_set] {
+        core::access(video_set.context); // trace context created with first streamer of the tile
+        // blocks of consumed segments are reused by later segments of the tile
+        auto segment_pool = std::make_shared<core::segment_pool>(impl_->prefetch_window + 2);
+        auto request_segment = [this, &video_set, segment_pool] {
             if (video_set.context->drain) {
                 return folly::makeSemiFuture<buffer_sequence>(core::stream_drained_error{});
             }
             auto request_time = absl::Now();
             auto& represent = impl_->predict_represent(video_set);
             auto initial_segment = impl_->request_initial_if_null(video_set, represent);
-            auto tile_segment = impl_->request_send(video_set, represent, false);
+            auto charge = std::make_shared<impl::buffered_charge>(impl_);
+            charge->resize(video_set.context->segment_size.load(std::memory_order_relaxed));
+            if (impl_->stream_body) {
+                // content length stands for bytes in flight, body is not yet downloaded
+                auto tile_stream = impl_->request_stream(video_set, represent)
+                                        .via(&folly::InlineExecutor::instance())
+                                        .thenValue([charge, context = video_set.context](
+                                            std::shared_ptr<core::chunk_stream> stream) {
+                                                if (const auto content_size = stream->content_size()) {
+                                                    charge->resize(*content_size);
+                                                    context->segment_size.store(*content_size, std::memory_order_relaxed);
+                                                }
+                                                return stream;
+                                            });
+                return folly::collectAllSemiFuture(initial_segment, tile_stream)
+                    .deferValue([request_time, charge, segment_pool](
+                        std::tuple<
+                            folly::Try<std::shared_ptr<multi_buffer>>,
+                            folly::Try<std::shared_ptr<core::chunk_stream>>
+                        >&& stream_tuple) {
+                            charge->resize(0);
+                            auto& [initial_buffer, data_stream] = stream_tuple;
+                            data_stream.throwIfFailed();
+                            return buffer_sequence{
+                                **initial_buffer, core::segment_buffer{ segment_pool }, std::move(*data_stream),
+                                absl::Now() - request_time
+                            };
+                        }
+                    );
+            }
+            // downloaded size replaces the estimate, released once consumer takes the segment
+            auto tile_segment = impl_->request_segment(video_set, represent, segment_pool)
+                                     .via(&folly::InlineExecutor::instance())
+                                     .thenValue([charge, context = video_set.context](
+                                         core::segment_buffer&& data_buffer) {
+                                             const auto data_size = folly::to<int64_t>(data_buffer.size());
+                                             charge->resize(data_size);
+                                             context->segment_size.store(data_size, std::memory_order_relaxed);
+                                             return std::move(data_buffer);
+                                         });
             return folly::collectAllSemiFuture(initial_segment, tile_segment)
-                .deferValue([request_time](
+                .deferValue([request_time, charge](
                     std::tuple<
                         folly::Try<std::shared_ptr<multi_buffer>>,
-                        folly::Try<multi_buffer>
+                        folly::Try<core::segment_buffer>
                     >&& buffer_tuple) {
+                        charge->resize(0);
                         auto& [initial_buffer, data_buffer] = buffer_tuple;
                         data_buffer.throwIfFailed();
                         return buffer_sequence{
@@ -271,5 +467,18 @@ namespace net
                     }
                 );
         };
+        // requests queue on the keep-alive session, next one is sent as soon as previous response is read
+        return [this, request_segment, prefetch_window = std::deque<folly::SemiFuture<buffer_sequence>>{}]() mutable {
+            if (prefetch_window.empty()) {
+                prefetch_window.push_back(request_segment());
+            }
+            auto tile_segment = std::move(prefetch_window.front());
+            prefetch_window.pop_front();
+            while (prefetch_window.size() + 1 < impl_->prefetch_window
+                && impl_->buffered_size.load(std::memory_order_relaxed) < impl_->prefetch_budget) {
+                prefetch_window.push_back(request_segment());
+            }
+            return tile_segment;
+        };
     }
 }
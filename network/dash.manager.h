@@ -1,5 +1,7 @@
 #pragma once
 #include "core/spatial.hpp"
+#include "core/chunk_stream.hpp"
+#include "core/segment_buffer.hpp"
 #include <folly/futures/Future.h>
 #include <folly/executors/ThreadPoolExecutor.h>
 #include <boost/beast/core/multi_buffer.hpp>
@@ -20,10 +22,15 @@ namespace net
     struct buffer_sequence final
     {
         detail::multi_buffer& initial;
-        detail::multi_buffer data;
+        core::segment_buffer data;
+        // streamed media segment, data stays empty while body is still downloading and
+        // consumer stages arrived body into it, so its storage comes from the same pool
+        std::shared_ptr<core::chunk_stream> stream;
         absl::Duration duration;
 
-        buffer_sequence(detail::multi_buffer& initial, detail::multi_buffer&& data, absl::Duration duration);
+        buffer_sequence(detail::multi_buffer& initial, core::segment_buffer&& data, absl::Duration duration);
+        buffer_sequence(detail::multi_buffer& initial, core::segment_buffer&& data,
+                        std::shared_ptr<core::chunk_stream> stream, absl::Duration duration);
         buffer_sequence(buffer_sequence&) = delete;
         buffer_sequence(buffer_sequence&& that) noexcept;
         buffer_sequence& operator=(buffer_sequence&) = delete;
@@ -40,6 +47,8 @@ namespace net
         std::shared_ptr<impl> impl_;
 
     public:
+        static constexpr inline unsigned default_max_connections = 8;
+
         explicit dash_manager(std::string mpd_url, unsigned concurrency = std::thread::hardware_concurrency(),
                               std::shared_ptr<folly::ThreadPoolExecutor> executor = nullptr);
         dash_manager() = delete;
@@ -58,6 +67,15 @@ namespace net
         void trace_by(spdlog::sink_ptr sink) const;
         void predict_by(detail::predict_callback callback) const;
         void select_by(detail::select_callback callback) const;
+        // tile requests are spread over at most max_connections keep-alive sessions to the host
+        void connect_by(unsigned max_connections) const;
+        // up to window outstanding segment requests per tile while buffered bytes of all tiles stay under budget
+        void prefetch_by(unsigned window, int64_t budget = std::numeric_limits<int64_t>::max()) const;
+        // media segment is handed over once response header arrives, body streams in while consumed
+        void stream_by(bool enable) const;
+        // bytes of requested segments not yet taken by consumers, a request still in flight
+        // counts the previous segment size of its tile
+        int64_t buffered_size() const;
         bool available() const;
     };
 }
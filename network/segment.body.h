@@ -0,0 +1,191 @@
+#pragma once
+#include "core/segment_buffer.hpp"
+#include <boost/beast/http/error.hpp>
+#include <boost/beast/http/message.hpp>
+#include <boost/optional/optional.hpp>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace net
+{
+    // http body reading into one contiguous segment_buffer, storage is reserved once
+    // from Content-Length, pool of the body value set before parsing is used if any
+    struct segment_body final
+    {
+        using value_type = core::segment_buffer;
+
+        static std::uint64_t size(const value_type& body) noexcept {
+            return body.size();
+        }
+
+        class reader final
+        {
+            value_type& body_;
+
+        public:
+            template <bool IsRequest, typename Fields>
+            explicit reader(boost::beast::http::header<IsRequest, Fields>&, value_type& body)
+                : body_{ body } {}
+
+            void init(const boost::optional<std::uint64_t>& content_length,
+                      boost::system::error_code& errc) {
+                if (content_length.has_value()) {
+                    if (*content_length > std::numeric_limits<size_t>::max()) {
+                        errc = boost::beast::http::error::buffer_overflow;
+                        return;
+                    }
+                    body_.reserve(static_cast<size_t>(*content_length));
+                }
+                errc = {};
+            }
+
+            template <typename ConstBufferSequence>
+            std::size_t put(const ConstBufferSequence& buffers,
+                            boost::system::error_code& errc) {
+                const auto size = boost::asio::buffer_size(buffers);
+                body_.commit(boost::asio::buffer_copy(body_.prepare(size), buffers));
+                errc = {};
+                return size;
+            }
+
+            void finish(boost::system::error_code& errc) {
+                errc = {};
+            }
+        };
+    };
+
+    // http body writing one immutable buffer shared with segment cache, response only
+    // holds a reference so concurrent responses of a hot segment never copy it
+    struct shared_segment_body final
+    {
+        using value_type = std::shared_ptr<const std::string>;
+
+        static std::uint64_t size(const value_type& body) noexcept {
+            return body ? body->size() : 0;
+        }
+
+        class writer final
+        {
+            const value_type& body_;
+
+        public:
+            using const_buffers_type = boost::asio::const_buffer;
+
+            template <bool IsRequest, typename Fields>
+            explicit writer(const boost::beast::http::header<IsRequest, Fields>&, const value_type& body)
+                : body_{ body } {}
+
+            void init(boost::system::error_code& errc) {
+                errc = {};
+            }
+
+            boost::optional<std::pair<const_buffers_type, bool>> get(boost::system::error_code& errc) {
+                errc = {};
+                if (body_ == nullptr || body_->empty()) {
+                    return boost::none;
+                }
+                return std::make_pair(const_buffers_type{ body_->data(), body_->size() }, false);
+            }
+        };
+    };
+
+    // http body writing read only file pages mapped by segment store, owner keeps the
+    // mapping alive until response is sent even if store is released meanwhile
+    struct mapped_segment_body final
+    {
+        struct value_type final
+        {
+            std::shared_ptr<const void> owner;
+            std::string_view data;
+        };
+
+        static std::uint64_t size(const value_type& body) noexcept {
+            return body.data.size();
+        }
+
+        class writer final
+        {
+            const value_type& body_;
+
+        public:
+            using const_buffers_type = boost::asio::const_buffer;
+
+            template <bool IsRequest, typename Fields>
+            explicit writer(const boost::beast::http::header<IsRequest, Fields>&, const value_type& body)
+                : body_{ body } {}
+
+            void init(boost::system::error_code& errc) {
+                errc = {};
+            }
+
+            boost::optional<std::pair<const_buffers_type, bool>> get(boost::system::error_code& errc) {
+                errc = {};
+                if (body_.data.empty()) {
+                    return boost::none;
+                }
+                return std::make_pair(const_buffers_type{ body_.data.data(), body_.data.size() }, false);
+            }
+        };
+    };
+
+    // multipart/byteranges body over slices of one mapped segment, delimiters hold boundary
+    // and part headers around each slice, the last one closes the multipart
+    struct multipart_segment_body final
+    {
+        struct value_type final
+        {
+            std::shared_ptr<const void> owner;
+            std::vector<std::string> delimiters;
+            std::vector<std::string_view> parts;
+        };
+
+        static std::uint64_t size(const value_type& body) noexcept {
+            std::uint64_t size = 0;
+            for (auto& delimiter : body.delimiters) {
+                size += delimiter.size();
+            }
+            for (auto& part : body.parts) {
+                size += part.size();
+            }
+            return size;
+        }
+
+        class writer final
+        {
+            const value_type& body_;
+            size_t index_ = 0;
+
+        public:
+            using const_buffers_type = boost::asio::const_buffer;
+
+            template <bool IsRequest, typename Fields>
+            explicit writer(const boost::beast::http::header<IsRequest, Fields>&, const value_type& body)
+                : body_{ body } {
+                assert(body_.delimiters.size() == body_.parts.size() + 1);
+            }
+
+            void init(boost::system::error_code& errc) {
+                errc = {};
+            }
+
+            // delimiters and parts interleaved, delimiter first
+            boost::optional<std::pair<const_buffers_type, bool>> get(boost::system::error_code& errc) {
+                errc = {};
+                const auto piece_count = body_.delimiters.size() + body_.parts.size();
+                while (index_ < piece_count) {
+                    const auto index = index_++;
+                    const std::string_view piece = index % 2 == 0
+                                                       ? std::string_view{ body_.delimiters[index / 2] }
+                                                       : body_.parts[index / 2];
+                    if (!piece.empty()) {
+                        return std::make_pair(const_buffers_type{ piece.data(), piece.size() },
+                                              index_ < piece_count);
+                    }
+                }
+                return boost::none;
+            }
+        };
+    };
+}
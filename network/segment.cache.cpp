@@ -0,0 +1,129 @@
+#include "stdafx.h"
+#include "segment.cache.h"
+#include <fstream>
+
+namespace net::server
+{
+    namespace
+    {
+        auto read_segment = [](const std::filesystem::path& target, const size_t size) {
+            std::string data(size, '\0');
+            std::ifstream segment_stream{ target, std::ios::binary };
+            if (!segment_stream.read(data.data(), static_cast<std::streamsize>(size))
+                || segment_stream.gcount() != static_cast<std::streamsize>(size)) {
+                return segment_cache::segment{};
+            }
+            return std::make_shared<const std::string>(std::move(data));
+        };
+    }
+
+    segment_cache::segment_cache(const size_t capacity, const size_t max_segment_size,
+                                 const std::chrono::steady_clock::duration revalidate_interval)
+        : capacity_{ capacity }
+        , max_segment_size_{ std::min(max_segment_size, capacity) }
+        , revalidate_interval_{ revalidate_interval } {}
+
+    segment_cache::segment segment_cache::find(const std::filesystem::path& target) {
+        auto key = target.generic_string();
+        const auto now = std::chrono::steady_clock::now();
+        file_status status;
+        if (auto data = lookup(key, target, now, status); data != nullptr) {
+            return data;
+        }
+        if (!status.stated) {
+            status.stat(target);
+        }
+        miss_count_.fetch_add(1, std::memory_order_relaxed);
+        auto data = !status.error && status.size <= max_segment_size_
+                        ? read_segment(target, static_cast<size_t>(status.size))
+                        : segment{};
+        std::lock_guard<std::mutex> lock{ mutex_ };
+        erase(key);
+        if (data == nullptr) {
+            return data;
+        }
+        recency_.push_front(key);
+        size_ += data->size();
+        entries_.emplace(std::move(key), entry{ data, status.write_time, now, recency_.begin() });
+        while (size_ > capacity_ && recency_.size() > 1) {
+            const auto evict_key = recency_.back();
+            erase(evict_key);
+            evict_count_.fetch_add(1, std::memory_order_relaxed);
+        }
+        return data;
+    }
+
+    void segment_cache::file_status::stat(const std::filesystem::path& target) {
+        stated = true;
+        write_time = std::filesystem::last_write_time(target, error);
+        size = error ? 0 : std::filesystem::file_size(target, error);
+    }
+
+    segment_cache::segment segment_cache::find_resident(const std::filesystem::path& target) {
+        file_status status;
+        return lookup(target.generic_string(), target, std::chrono::steady_clock::now(), status);
+    }
+
+    segment_cache::segment segment_cache::lookup(const std::string& key, const std::filesystem::path& target,
+                                                 const std::chrono::steady_clock::time_point now,
+                                                 file_status& status) {
+        {
+            std::lock_guard<std::mutex> lock{ mutex_ };
+            const auto entry_iter = entries_.find(key);
+            if (entry_iter == entries_.end()) {
+                return nullptr;
+            }
+            if (now - entry_iter->second.validate_time < revalidate_interval_) {
+                recency_.splice(recency_.begin(), recency_, entry_iter->second.recency);
+                hit_count_.fetch_add(1, std::memory_order_relaxed);
+                return entry_iter->second.data;
+            }
+        }
+        // mtime alone misses a rewrite within one tick of a coarse resolution filesystem
+        status.stat(target);
+        if (status.error) {
+            return nullptr;
+        }
+        std::lock_guard<std::mutex> lock{ mutex_ };
+        if (const auto entry_iter = entries_.find(key);
+            entry_iter != entries_.end() && entry_iter->second.write_time == status.write_time
+            && entry_iter->second.data->size() == status.size) {
+            entry_iter->second.validate_time = now;
+            recency_.splice(recency_.begin(), recency_, entry_iter->second.recency);
+            hit_count_.fetch_add(1, std::memory_order_relaxed);
+            return entry_iter->second.data;
+        }
+        return nullptr;
+    }
+
+    size_t segment_cache::size() const {
+        std::lock_guard<std::mutex> lock{ mutex_ };
+        return size_;
+    }
+
+    size_t segment_cache::entry_count() const {
+        std::lock_guard<std::mutex> lock{ mutex_ };
+        return entries_.size();
+    }
+
+    int64_t segment_cache::hit_count() const noexcept {
+        return hit_count_.load(std::memory_order_relaxed);
+    }
+
+    int64_t segment_cache::miss_count() const noexcept {
+        return miss_count_.load(std::memory_order_relaxed);
+    }
+
+    int64_t segment_cache::evict_count() const noexcept {
+        return evict_count_.load(std::memory_order_relaxed);
+    }
+
+    // mutex held by caller
+    void segment_cache::erase(const std::string& key) {
+        if (const auto entry_iter = entries_.find(key); entry_iter != entries_.end()) {
+            size_ -= entry_iter->second.data->size();
+            recency_.erase(entry_iter->second.recency);
+            entries_.erase(entry_iter);
+        }
+    }
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace net::server
+{
+    // size bounded lru of whole segment files keyed by target path, shared by every session,
+    // a hit within revalidate interval touches no filesystem, later ones compare mtime and size
+    class segment_cache final
+    {
+    public:
+        using segment = std::shared_ptr<const std::string>;
+
+        static constexpr inline size_t default_capacity = 256 * 1024 * 1024;
+        static constexpr inline size_t default_max_segment_size = 16 * 1024 * 1024;
+        static constexpr inline std::chrono::milliseconds default_revalidate_interval{ 1000 };
+
+    private:
+        struct entry final
+        {
+            segment data;
+            std::filesystem::file_time_type write_time;
+            std::chrono::steady_clock::time_point validate_time;
+            std::list<std::string>::iterator recency;
+        };
+
+        const size_t capacity_;
+        const size_t max_segment_size_;
+        const std::chrono::steady_clock::duration revalidate_interval_;
+        mutable std::mutex mutex_;
+        std::list<std::string> recency_;
+        std::unordered_map<std::string, entry> entries_;
+        size_t size_ = 0;
+        std::atomic<int64_t> hit_count_{ 0 };
+        std::atomic<int64_t> miss_count_{ 0 };
+        std::atomic<int64_t> evict_count_{ 0 };
+
+    public:
+        explicit segment_cache(size_t capacity = default_capacity,
+                               size_t max_segment_size = default_max_segment_size,
+                               std::chrono::steady_clock::duration revalidate_interval = default_revalidate_interval);
+        segment_cache(const segment_cache&) = delete;
+        segment_cache(segment_cache&&) = delete;
+        segment_cache& operator=(const segment_cache&) = delete;
+        segment_cache& operator=(segment_cache&&) = delete;
+        ~segment_cache() = default;
+
+        // null if target is missing or larger than max segment size, caller serves file then,
+        // evicted or replaced segments stay valid until last response holding them is sent
+        segment find(const std::filesystem::path& target);
+
+        // null unless target is resident and still valid, never reads the file
+        segment find_resident(const std::filesystem::path& target);
+
+        size_t size() const;
+        size_t entry_count() const;
+        int64_t hit_count() const noexcept;
+        int64_t miss_count() const noexcept;
+        int64_t evict_count() const noexcept;
+
+    private:
+        struct file_status final
+        {
+            std::filesystem::file_time_type write_time;
+            uintmax_t size = 0;
+            std::error_code error;
+            bool stated = false;
+
+            void stat(const std::filesystem::path& target);
+        };
+
+        // status is stated only if entry outlived revalidate interval
+        segment lookup(const std::string& key, const std::filesystem::path& target,
+                       std::chrono::steady_clock::time_point now, file_status& status);
+
+        void erase(const std::string& key);
+    };
+}
@@ -0,0 +1,94 @@
+#include "stdafx.h"
+#include "segment.store.h"
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <algorithm>
+
+namespace net::server
+{
+    auto make_store_logger = core::console_logger_factory("net.server.store");
+
+    namespace
+    {
+        auto index_key = [](const std::filesystem::path& target) {
+            return target.lexically_normal().generic_string();
+        };
+    }
+
+    segment_store::segment_store(std::filesystem::path root,
+                                 std::vector<std::string> extensions,
+                                 const size_t max_file_size)
+        : root_{ std::move(root) } {
+        const auto logger = make_store_logger().second;
+        // only iterator failure ends scan, a file failing to stat is skipped alone
+        std::error_code scan_error;
+        for (std::filesystem::recursive_directory_iterator iterator{
+                 root_, std::filesystem::directory_options::skip_permission_denied, scan_error
+             }, end; !scan_error && iterator != end; iterator.increment(scan_error)) {
+            const auto& entry = *iterator;
+            std::error_code entry_error;
+            if (!entry.is_regular_file(entry_error)
+                || std::find(extensions.begin(), extensions.end(),
+                             entry.path().extension().string()) == extensions.end()) {
+                continue;
+            }
+            // mapping an empty file fails, oversized ones are most likely source videos
+            const auto file_size = entry.file_size(entry_error);
+            if (entry_error) {
+                logger().warn("stat {} failed {}", entry.path().generic_string(), entry_error.message());
+                continue;
+            }
+            if (file_size == 0 || file_size > max_file_size) {
+                continue;
+            }
+            try {
+                auto mapped = map(entry.path());
+                size_ += mapped.data.size();
+                index_.emplace(index_key(entry.path()), std::move(mapped));
+            } catch (const boost::interprocess::interprocess_exception& exception) {
+                logger().warn("map {} failed {}", entry.path().generic_string(), exception.what());
+            }
+        }
+        if (scan_error) {
+            logger().error("scan {} stopped {}", root_.generic_string(), scan_error.message());
+        }
+        logger().info("mapped {} files {} bytes under {}", index_.size(), size_, root_.generic_string());
+    }
+
+    segment_store::segment segment_store::find(const std::filesystem::path& target) const {
+        if (const auto entry_iter = index_.find(index_key(target)); entry_iter != index_.end()) {
+            hit_count_.fetch_add(1, std::memory_order_relaxed);
+            return entry_iter->second;
+        }
+        miss_count_.fetch_add(1, std::memory_order_relaxed);
+        return segment{};
+    }
+
+    segment_store::segment segment_store::map(const std::filesystem::path& target) {
+        namespace ipc = boost::interprocess;
+        const ipc::file_mapping mapping{ target.string().c_str(), ipc::read_only };
+        auto region = std::make_shared<const ipc::mapped_region>(mapping, ipc::read_only);
+        const std::string_view data{ static_cast<const char*>(region->get_address()), region->get_size() };
+        return segment{ std::move(region), data };
+    }
+
+    const std::filesystem::path& segment_store::root() const noexcept {
+        return root_;
+    }
+
+    size_t segment_store::size() const noexcept {
+        return size_;
+    }
+
+    size_t segment_store::file_count() const noexcept {
+        return index_.size();
+    }
+
+    int64_t segment_store::hit_count() const noexcept {
+        return hit_count_.load(std::memory_order_relaxed);
+    }
+
+    int64_t segment_store::miss_count() const noexcept {
+        return miss_count_.load(std::memory_order_relaxed);
+    }
+}
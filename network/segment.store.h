@@ -0,0 +1,52 @@
+#pragma once
+#include "network/segment.body.h"
+#include <atomic>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace net::server
+{
+    // read only mapping of every segment file under server root, indexed once at startup so a
+    // request costs a hash lookup and the socket write, files created later are not indexed
+    // and files must not be truncated while mapped, republish a title by restarting server,
+    // so server maps segments only when Net.Server.MapSegments opts in
+    class segment_store final
+    {
+    public:
+        using segment = mapped_segment_body::value_type;
+
+        static constexpr inline size_t default_max_file_size = 256 * 1024 * 1024;
+
+    private:
+        const std::filesystem::path root_;
+        std::unordered_map<std::string, segment> index_;
+        size_t size_ = 0;
+        mutable std::atomic<int64_t> hit_count_{ 0 };
+        mutable std::atomic<int64_t> miss_count_{ 0 };
+
+    public:
+        explicit segment_store(std::filesystem::path root,
+                               std::vector<std::string> extensions = { ".mpd", ".mp4", ".m4s" },
+                               size_t max_file_size = default_max_file_size);
+        segment_store(const segment_store&) = delete;
+        segment_store(segment_store&&) = delete;
+        segment_store& operator=(const segment_store&) = delete;
+        segment_store& operator=(segment_store&&) = delete;
+        ~segment_store() = default;
+
+        // empty owner if target was not mapped at startup, caller serves it another way then,
+        // index is immutable after construction so sessions look up without locking
+        segment find(const std::filesystem::path& target) const;
+
+        // maps one file outside index, throws interprocess_exception if target is missing or empty
+        static segment map(const std::filesystem::path& target);
+
+        const std::filesystem::path& root() const noexcept;
+        size_t size() const noexcept;
+        size_t file_count() const noexcept;
+        int64_t hit_count() const noexcept;
+        int64_t miss_count() const noexcept;
+    };
+}
@@ -29,6 +29,13 @@ namespace net::client
         reserve_recvbuf_capacity();
     }
 
+    session<protocal::http>::~session() {
+        // reader of an unfinished body must not block forever
+        if (recv_stream_ != nullptr) {
+            recv_stream_->close(std::make_exception_ptr(core::session_closed_error{}));
+        }
+    }
+
     auto session<protocal::http>::create(socket_type&& socket,
                                          boost::asio::io_context& context) -> pointer {
         return std::make_unique<session<protocal::http>>(std::move(socket), context);
@@ -39,39 +46,140 @@ namespace net::client
                         .body_limit(std::numeric_limits<uint64_t>::max());
     }
 
+    template <>
+    auto session<protocal::http>::parser_of<dynamic_body>() -> std::optional<response_parser<dynamic_body>>& {
+        return response_parser_;
+    }
+
+    template <>
+    auto session<protocal::http>::parser_of<segment_body>() -> std::optional<response_parser<segment_body>>& {
+        return segment_parser_;
+    }
+
+    template <typename Body>
     auto session<protocal::http>::on_recv_response(int64_t index) {
         return [=](boost::system::error_code errc,
                    std::size_t transfer_size) mutable {
             assert(request_sequence_.running_in_this_thread());
             logger_().info("on_recv_response errc {} transfer {}", errc, transfer_size);
+            if (!active_) {
+                return; // requests already failed by the other direction
+            }
             if (errc) {
                 logger_().error("on_recv_response failure");
                 return fail_request_then_close(
                     core::bad_response_error{} << core::errinfo_code{ errc },
                     errc, boost::asio::socket_base::shutdown_receive);
             }
-            if (response_parser_->get().result() != http::status::ok) {
+            auto& parser = parser_of<Body>();
+            auto& promise = std::get<folly::Promise<response<Body>>>(request_list_.front().promise);
+            if (const auto status = parser->get().result();
+                status != http::status::ok && status != http::status::partial_content) {
+                // whole message is read, connection stays usable for requests behind it
                 logger_().error("on_recv_response bad response");
+                promise.setException(core::bad_response_error{} << core::errinfo_message{
+                    parser->get().reason().to_string()
+                });
+                return pop_front_response();
+            }
+            tracer_->info("response=recv:index={}:transfer={}", index, transfer_size);
+            promise.setValue(parser->release());
+            pop_front_response();
+        };
+    }
+
+    auto session<protocal::http>::on_recv_stream_chunk(int64_t index) {
+        return [=](boost::system::error_code errc,
+                   std::size_t transfer_size) mutable {
+            assert(request_sequence_.running_in_this_thread());
+            if (!active_) {
+                return;
+            }
+            // chunk buffer filled up before message end
+            if (errc == http::error::need_buffer) {
+                errc = {};
+            }
+            if (errc) {
+                logger_().error("on_recv_stream_chunk failure errc {}", errc);
                 return fail_request_then_close(
-                    core::bad_response_error{} << core::errinfo_message{
-                        response_parser_->get().reason().to_string()
-                    },
+                    core::bad_response_error{} << core::errinfo_code{ errc },
                     errc, boost::asio::socket_base::shutdown_receive);
             }
-            tracer_->info("response=recv:index={}:transfer={}", index, transfer_size);
-            request_list_.front().second.setValue(response_parser_->release());
-            request_list_.pop_front();
-            if (!request_list_.empty()) {
-                send_front_request();
+            const auto chunk_size = recv_chunk_.size() - chunk_parser_->get().body().size;
+            recv_stream_->append(boost::asio::const_buffer{ recv_chunk_.data(), chunk_size });
+            recv_stream_chunk(index);
+        };
+    }
+
+    void session<protocal::http>::recv_stream_chunk(int64_t index) {
+        assert(request_sequence_.running_in_this_thread());
+        if (chunk_parser_->is_done()) {
+            tracer_->info("response=recv:index={}:transfer={}", index, recv_stream_->append_size());
+            std::exchange(recv_stream_, nullptr)->close();
+            return pop_front_response();
+        }
+        recv_chunk_.resize(default_max_chunk_size);
+        auto& body = chunk_parser_->get().body();
+        body.data = recv_chunk_.data();
+        body.size = recv_chunk_.size();
+        http::async_read_some(socket_, recvbuf_, *chunk_parser_,
+                              boost::asio::bind_executor(request_sequence_, on_recv_stream_chunk(index)));
+    }
+
+    auto session<protocal::http>::on_recv_stream_header(int64_t index) {
+        return [=](boost::system::error_code errc,
+                   std::size_t transfer_size) mutable {
+            assert(request_sequence_.running_in_this_thread());
+            logger_().info("on_recv_stream_header errc {} transfer {}", errc, transfer_size);
+            if (!active_) {
+                return;
+            }
+            if (errc) {
+                logger_().error("on_recv_stream_header failure");
+                return fail_request_then_close(
+                    core::bad_response_error{} << core::errinfo_code{ errc },
+                    errc, boost::asio::socket_base::shutdown_receive);
+            }
+            if (const auto status = chunk_parser_->get().result();
+                status != http::status::ok && status != http::status::partial_content) {
+                // error body is drained into a stream nobody reads, connection stays usable
+                logger_().error("on_recv_stream_header bad response");
+                std::get<folly::Promise<stream_pointer>>(request_list_.front().promise)
+                    .setException(core::bad_response_error{} << core::errinfo_message{
+                        chunk_parser_->get().reason().to_string()
+                    });
+                recv_stream_ = std::make_shared<core::chunk_stream>();
+                return recv_stream_chunk(index);
+            }
+            tracer_->info("response=header:index={}:transfer={}", index, transfer_size);
+            std::optional<int64_t> content_size;
+            if (const auto content_length = chunk_parser_->content_length(); content_length.has_value()) {
+                content_size = folly::to<int64_t>(*content_length);
             }
+            recv_stream_ = std::make_shared<core::chunk_stream>(content_size);
+            std::get<folly::Promise<stream_pointer>>(request_list_.front().promise)
+                .setValue(recv_stream_);
+            recv_stream_chunk(index);
         };
     }
 
+    void session<protocal::http>::pop_front_response() {
+        assert(request_sequence_.running_in_this_thread());
+        request_list_.pop_front();
+        receiving_ = false;
+        send_count_--;
+        recv_front_response();
+        send_pending_request();
+    }
+
     auto session<protocal::http>::on_send_request(int64_t index) {
         return [=](boost::system::error_code errc,
                    std::size_t transfer_size) mutable {
             assert(request_sequence_.running_in_this_thread());
             logger_().info("on_send_request errc {} transfer {}", errc, transfer_size);
+            if (!active_) {
+                return;
+            }
             if (errc) {
                 logger_().error("on_send_request failure");
                 return fail_request_then_close(
@@ -79,42 +187,111 @@ namespace net::client
                     errc, boost::asio::socket_base::shutdown_send);
             }
             tracer_->info("request=send:index={}:transfer={}", index, transfer_size);
-            http::async_read(socket_, recvbuf_, *response_parser_,
-                             boost::asio::bind_executor(request_sequence_, on_recv_response(index)));
+            sending_ = false;
+            send_count_++;
+            recv_front_response();
+            send_pending_request();
         };
     }
 
-    void session<protocal::http>::send_front_request() {
+    void session<protocal::http>::send_pending_request() {
         assert(request_sequence_.running_in_this_thread());
-        emplace_response_parser();
+        if (sending_ || !active_ || send_count_ == request_list_.size() || send_count_ >= pipeline_depth_) {
+            return;
+        }
+        sending_ = true;
         auto request_index = ++round_index_;
-        tracer_->info("request=ready:index={}", request_index);
-        http::async_write(socket_, request_list_.front().first,
+        tracer_->info("request=ready:index={}:pipeline={}", request_index, send_count_);
+        // list node stays in place while its response is pending
+        http::async_write(socket_, std::next(request_list_.begin(), send_count_)->message,
                           boost::asio::bind_executor(request_sequence_, on_send_request(request_index)));
     }
 
+    void session<protocal::http>::recv_front_response() {
+        assert(request_sequence_.running_in_this_thread());
+        if (receiving_ || !active_ || send_count_ == 0) {
+            return;
+        }
+        receiving_ = true;
+        const auto recv_index = ++recv_index_;
+        auto& front = request_list_.front();
+        if (std::holds_alternative<folly::Promise<response<segment_body>>>(front.promise)) {
+            segment_parser_.emplace()
+                           .body_limit(std::numeric_limits<uint64_t>::max());
+            segment_parser_->get().body() = core::segment_buffer{ front.pool };
+            return http::async_read(
+                socket_, recvbuf_, *segment_parser_,
+                boost::asio::bind_executor(request_sequence_, on_recv_response<segment_body>(recv_index)));
+        }
+        if (std::holds_alternative<folly::Promise<stream_pointer>>(front.promise)) {
+            chunk_parser_.emplace()
+                         .body_limit(std::numeric_limits<uint64_t>::max());
+            return http::async_read_header(
+                socket_, recvbuf_, *chunk_parser_,
+                boost::asio::bind_executor(request_sequence_, on_recv_stream_header(recv_index)));
+        }
+        emplace_response_parser();
+        http::async_read(socket_, recvbuf_, *response_parser_,
+                         boost::asio::bind_executor(request_sequence_, on_recv_response<dynamic_body>(recv_index)));
+    }
+
+    bool session<protocal::http>::active() const noexcept {
+        return active_.load(std::memory_order_acquire);
+    }
+
     void session<protocal::http>::trace_by(spdlog::sink_ptr sink) const {
         spdlog::drop(identity_);
         core::as_mutable(tracer_) = core::make_async_logger(identity_, std::move(sink));
     }
 
-    auto session<protocal::http>::send_request(request<empty_body>&& request)
-    -> folly::SemiFuture<response<dynamic_body>> {
-        logger_().info("send_request empty body");
-        auto [promise, future] = folly::makePromiseContract<response<dynamic_body>>();
+    void session<protocal::http>::pipeline_by(size_t depth) {
+        assert(depth > 0);
+        boost::asio::post(request_sequence_, [this, depth] {
+            pipeline_depth_ = std::max<size_t>(depth, 1);
+            send_pending_request();
+        });
+    }
+
+    void session<protocal::http>::emplace_request(request<empty_body>&& request, response_promise&& promise,
+                                                  std::shared_ptr<core::segment_pool> pool) {
         boost::asio::post(
             request_sequence_,
-            [this, request = std::move(request), response = std::move(promise)]() mutable {
-                auto request_target = request.target().to_string();
+            [this, request = std::move(request), promise = std::move(promise), pool = std::move(pool)]() mutable {
                 if (active_) {
-                    request_list_.emplace_back(std::move(request), std::move(response));
-                    if (request_list_.size() == 1) {
-                        send_front_request();
-                    }
+                    request_list_.push_back(request_entry{ std::move(request), std::move(promise), std::move(pool) });
+                    send_pending_request();
                 } else {
-                    response.setException(core::session_closed_error{});
+                    std::visit([](auto& pending) {
+                        pending.setException(core::session_closed_error{});
+                    }, promise);
                 }
             });
+    }
+
+    auto session<protocal::http>::send_request(request<empty_body>&& request)
+    -> folly::SemiFuture<response<dynamic_body>> {
+        logger_().info("send_request empty body");
+        auto [promise, future] = folly::makePromiseContract<response<dynamic_body>>();
+        emplace_request(std::move(request), std::move(promise));
+        return std::move(future);
+    }
+
+    auto session<protocal::http>::send_request_segment(request<empty_body>&& request,
+                                                       std::shared_ptr<core::segment_pool> pool)
+    -> folly::SemiFuture<core::segment_buffer> {
+        logger_().info("send_request_segment empty body");
+        auto [promise, future] = folly::makePromiseContract<response<segment_body>>();
+        emplace_request(std::move(request), std::move(promise), std::move(pool));
+        return std::move(future).deferValue([](response<segment_body>&& response) {
+            return std::move(response).body();
+        });
+    }
+
+    auto session<protocal::http>::send_request_stream(request<empty_body>&& request)
+    -> folly::SemiFuture<stream_pointer> {
+        logger_().info("send_request_stream empty body");
+        auto [promise, future] = folly::makePromiseContract<stream_pointer>();
+        emplace_request(std::move(request), std::move(promise));
         return std::move(future);
     }
 }
@@ -1,8 +1,11 @@
 #pragma once
 #include "network/net.h"
 #include "network/session.base.h"
+#include "core/chunk_stream.hpp"
+#include "network/segment.body.h"
 #include <boost/asio/strand.hpp>
 #include <spdlog/common.h>
+#include <atomic>
 
 namespace net::client
 {
@@ -17,28 +20,56 @@ namespace net::client
         detail::session_base<boost::asio::ip::tcp::socket, multi_buffer>,
         protocal::protocal_base<protocal::http>
     {
-        using request_list = std::list<
-            std::pair<request<empty_body>,
-                      folly::Promise<response<dynamic_body>>>>;
+        using stream_pointer = std::shared_ptr<core::chunk_stream>;
+        using response_promise = std::variant<
+            folly::Promise<response<dynamic_body>>,
+            folly::Promise<response<segment_body>>,
+            folly::Promise<stream_pointer>>;
+
+        struct request_entry final
+        {
+            request<empty_body> message;
+            response_promise promise;
+            // storage of segment_body response
+            std::shared_ptr<core::segment_pool> pool;
+        };
+
+        using request_list = std::list<request_entry>;
         using request_sequence = boost::asio::strand<boost::asio::io_context::executor_type>;
         using response_body_parser = response_parser<dynamic_body>;
+        using response_segment_parser = response_parser<segment_body>;
+        using response_chunk_parser = response_parser<buffer_body>;
 
         const core::logger_access logger_;
         const std::shared_ptr<spdlog::logger> tracer_;
+        // requests at list front up to send_count_ are written and wait for response in order
         request_list request_list_;
         std::optional<response_body_parser> response_parser_;
-        mutable bool active_ = true;
+        std::optional<response_segment_parser> segment_parser_;
+        std::optional<response_chunk_parser> chunk_parser_;
+        // body of streaming response at list front, appended chunk by chunk
+        stream_pointer recv_stream_;
+        std::vector<char> recv_chunk_;
+        size_t pipeline_depth_ = default_pipeline_depth;
+        size_t send_count_ = 0;
+        int64_t recv_index_ = -1;
+        bool sending_ = false;
+        bool receiving_ = false;
+        std::atomic<bool> active_{ true };
         mutable request_sequence request_sequence_;
 
     public:
         using pointer = std::unique_ptr<session>;
 
+        static constexpr inline size_t default_pipeline_depth = 1;
+
         session(socket_type&& socket,
                 boost::asio::io_context& context);
 
         session() = delete;
         session(const session&) = delete;
         session& operator=(const session&) = delete;
+        ~session();
 
         using session_base::operator<;
         using session_base::local_endpoint;
@@ -46,12 +77,22 @@ namespace net::client
 
         folly::SemiFuture<response<dynamic_body>> send_request(request<empty_body>&& request);
 
+        // body is read into one contiguous block taken from pool, reserved from Content-Length
+        folly::SemiFuture<core::segment_buffer> send_request_segment(request<empty_body>&& request,
+                                                                     std::shared_ptr<core::segment_pool> pool);
+
+        // fulfilled once response header parsed, body keeps streaming into the chunk stream
+        // while it is being downloaded, stream closes with exception if connection fails
+        folly::SemiFuture<stream_pointer> send_request_stream(request<empty_body>&& request);
+
         template <typename Target, typename Body>
         folly::SemiFuture<Target> send_request_for(request<Body>&& req) {
             static_assert(!std::is_reference<Target>::value);
             return send_request(std::move(req)).deferValue(
                 [](response<dynamic_body>&& response) -> Target {
-                    if (response.result() != boost::beast::http::status::ok) {
+                    if (const auto status = response.result();
+                        status != boost::beast::http::status::ok
+                        && status != boost::beast::http::status::partial_content) {
                         core::bad_request_error::throw_in_function("send_request_for");
                     }
                     if constexpr (std::is_same<multi_buffer, Target>::value) {
@@ -64,27 +105,59 @@ namespace net::client
         static pointer create(socket_type&& socket,
                               boost::asio::io_context& context);
 
+        // false once connection failed, requests sent later fail with session_closed_error
+        bool active() const noexcept;
+
         void trace_by(spdlog::sink_ptr sink) const;
 
+        // write up to depth requests back-to-back before their responses arrive, 1 disables pipelining
+        void pipeline_by(size_t depth);
+
     private:
         void emplace_response_parser();
 
+        void emplace_request(request<empty_body>&& request, response_promise&& promise,
+                             std::shared_ptr<core::segment_pool> pool = nullptr);
+
         template <typename Exception>
         void fail_request_then_close(Exception&& exception, boost::system::error_code errc,
                                      boost::asio::socket_base::shutdown_type operation) {
             assert(request_sequence_.running_in_this_thread());
-            for (auto& [request, response] : request_list_) {
-                response.setException(std::forward<Exception>(exception));
+            // continuations of failed requests already see the session as inactive
+            active_ = false;
+            if (recv_stream_ != nullptr) {
+                // front promise is already fulfilled with the stream, reader sees exception instead
+                std::exchange(recv_stream_, nullptr)->close(std::make_exception_ptr(exception));
+                request_list_.pop_front();
+            }
+            for (auto& entry : request_list_) {
+                std::visit([&exception](auto& promise) {
+                    promise.setException(exception);
+                }, entry.promise);
             }
             request_list_.clear();
+            send_count_ = 0;
             close_socket(errc, operation);
-            active_ = false;
         }
 
-        void send_front_request();
+        void send_pending_request();
+
+        void recv_front_response();
+
+        void recv_stream_chunk(int64_t index);
+
+        void pop_front_response();
 
         auto on_send_request(int64_t index);
 
+        template <typename Body>
+        std::optional<response_parser<Body>>& parser_of();
+
+        template <typename Body>
         auto on_recv_response(int64_t index);
+
+        auto on_recv_stream_header(int64_t index);
+
+        auto on_recv_stream_chunk(int64_t index);
     };
 }
@@ -3,6 +3,12 @@
 #include <boost/beast/http/read.hpp>
 #include <boost/beast/http/write.hpp>
 #include <fmt/ostream.h>
+#include <folly/Random.h>
+#include <boost/interprocess/exceptions.hpp>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#include <cerrno>
+#endif
 
 namespace net::server
 {
@@ -10,6 +16,42 @@ namespace net::server
 
     auto make_logger = core::console_logger_factory("net.server.session");
 
+    namespace
+    {
+        // type of each multipart part, whole segment responses carry none
+        auto segment_content_type = [](const std::filesystem::path& target) -> std::string_view {
+            const auto extension = target.extension();
+            if (extension == ".mpd") {
+                return "application/dash+xml";
+            }
+            if (extension == ".m4s") {
+                return "video/iso.segment";
+            }
+            if (extension == ".mp4") {
+                return "video/mp4";
+            }
+            return "application/octet-stream";
+        };
+
+        auto multipart_byteranges = [](segment_store::segment whole,
+                                       const std::vector<byte_range>& ranges,
+                                       std::string_view boundary,
+                                       std::string_view content_type) {
+            multipart_segment_body::value_type body;
+            body.parts.reserve(ranges.size());
+            body.delimiters.reserve(ranges.size() + 1);
+            for (auto& range : ranges) {
+                body.delimiters.push_back(fmt::format("{}--{}\r\nContent-Type: {}\r\nContent-Range: {}\r\n\r\n",
+                                                      body.parts.empty() ? "" : "\r\n", boundary, content_type,
+                                                      content_range(range, whole.data.size())));
+                body.parts.push_back(whole.data.substr(range.offset, range.length));
+            }
+            body.delimiters.push_back(fmt::format("\r\n--{}--\r\n", boundary));
+            body.owner = std::move(whole.owner);
+            return body;
+        };
+    }
+
     session<protocal::http>::session(boost::asio::ip::tcp::socket&& socket,
                                      boost::asio::io_context& context)
         : session_base{ std::move(socket), context } {
@@ -27,6 +69,22 @@ namespace net::server
         return *this;
     }
 
+    session<protocal::http>& session<protocal::http>::cache_segments(std::shared_ptr<segment_cache> cache) {
+        segment_cache_ = std::move(cache);
+        return *this;
+    }
+
+    session<protocal::http>& session<protocal::http>::store_segments(std::shared_ptr<const segment_store> store) {
+        assert(store == nullptr || store->root() == root_path_);
+        segment_store_ = std::move(store);
+        return *this;
+    }
+
+    session<protocal::http>& session<protocal::http>::transfer_files(file_transfer transfer) {
+        file_transfer_ = zero_copy_supported ? transfer : file_transfer::buffered;
+        return *this;
+    }
+
     folly::SemiFuture<folly::Unit> session<protocal::http>::process_requests() {
         auto completion = completion_.getSemiFuture();
         receive_request();
@@ -35,9 +93,15 @@ namespace net::server
 
     auto session<protocal::http>::create(socket_type&& socket,
                                          boost::asio::io_context& context,
-                                         std::filesystem::path root) -> pointer {
+                                         std::filesystem::path root,
+                                         std::shared_ptr<segment_cache> cache,
+                                         file_transfer transfer,
+                                         std::shared_ptr<const segment_store> store) -> pointer {
         auto instance = std::make_unique<session>(std::move(socket), context);
-        instance->root_directory(std::move(root));
+        instance->root_directory(std::move(root))
+                 .cache_segments(std::move(cache))
+                 .transfer_files(transfer)
+                 .store_segments(std::move(store));
         return instance;
     }
 
@@ -49,12 +113,34 @@ namespace net::server
                 return close_socket_then_complete(errc, boost::asio::socket_base::shutdown_receive);
             }
             auto target_path = concat_target_path(request->target());
-            const auto send_response = [this](auto&& response_ptr) {
-                auto& response_ref = response_ptr.operator*();
-                logger_().info("on_recv_request response reason {}", response_ptr->reason());
-                http::async_write(socket_, response_ref, on_send_response(std::move(response_ptr)));
-            };
-            if (std::filesystem::exists(target_path)) {
+            if (send_range_response(*request, target_path)) {
+                return;
+            }
+            if (auto mapped = segment_store_ ? segment_store_->find(target_path) : segment_store::segment{};
+                mapped.owner != nullptr) {
+                logger_().info("on_recv_request {} mapped", target_path);
+                auto response = std::make_unique<
+                    http::response<mapped_segment_body>>(http::status::ok, request->version(),
+                                                         std::move(mapped));
+                response->content_length(response->body().data.size());
+                response->set(http::field::server, "MetaPlus");
+                response->keep_alive(request->keep_alive());
+                send_response(std::move(response));
+            } else if (auto segment = segment_cache_ ? segment_cache_->find(target_path) : nullptr; segment) {
+                logger_().info("on_recv_request {} cached", target_path);
+                auto response = std::make_unique<
+                    http::response<shared_segment_body>>(http::status::ok, request->version(),
+                                                         std::move(segment));
+                response->content_length(response->body()->size());
+                response->set(http::field::server, "MetaPlus");
+                response->keep_alive(request->keep_alive());
+                send_response(std::move(response));
+#ifdef __linux__
+            } else if (file_transfer_ == file_transfer::zero_copy && std::filesystem::exists(target_path)) {
+                logger_().info("on_recv_request {} valid zero copy", target_path);
+                send_file_zero_copy(target_path, request->version(), request->keep_alive());
+#endif
+            } else if (std::filesystem::exists(target_path)) {
                 logger_().info("on_recv_request {} valid", target_path);
                 auto response_body = file_response_body(target_path);
                 auto response = std::make_unique<
@@ -66,12 +152,156 @@ namespace net::server
                 send_response(std::move(response));
             } else {
                 logger_().error("on_recv_request {} invalid", target_path);
-                send_response(std::make_unique<
-                    http::response<empty_body>>(http::status::bad_request, request->version()));
+                auto response = std::make_unique<
+                    http::response<empty_body>>(http::status::bad_request, request->version());
+                // delimited so that client keeps the connection for requests behind it
+                response->content_length(0);
+                response->keep_alive(request->keep_alive());
+                send_response(std::move(response));
             }
         };
     }
 
+    bool session<protocal::http>::send_range_response(const request<dynamic_body>& request,
+                                                      const std::filesystem::path& target) {
+        const auto range_field = request.find(http::field::range);
+        if (range_field == request.end()) {
+            return false;
+        }
+        auto whole = range_source(target);
+        if (whole.owner == nullptr) {
+            return false;
+        }
+        const auto size = whole.data.size();
+        const std::string_view range_header{ range_field->value().data(), range_field->value().size() };
+        const auto ranges = parse_byte_ranges(range_header, size);
+        if (ranges.has_value() && ranges->empty()) {
+            return false;
+        }
+        const auto prepare_response = [&](auto& response, const uint64_t content_length) {
+            response->content_length(content_length);
+            response->set(http::field::server, "MetaPlus");
+            response->keep_alive(request.keep_alive());
+        };
+        if (!ranges.has_value()) {
+            logger_().error("send_range_response {} unsatisfiable {}", target, range_header);
+            auto response = std::make_unique<
+                http::response<empty_body>>(http::status::range_not_satisfiable, request.version());
+            response->set(http::field::content_range, content_range(std::nullopt, size));
+            prepare_response(response, 0);
+            send_response(std::move(response));
+        } else if (ranges->size() == 1) {
+            const auto& range = ranges->front();
+            logger_().info("send_range_response {} {}", target, content_range(range, size));
+            auto response = std::make_unique<
+                http::response<mapped_segment_body>>(http::status::partial_content, request.version(),
+                                                     segment_store::segment{
+                                                         std::move(whole.owner),
+                                                         whole.data.substr(range.offset, range.length)
+                                                     });
+            response->set(http::field::content_range, content_range(range, size));
+            prepare_response(response, range.length);
+            send_response(std::move(response));
+        } else {
+            logger_().info("send_range_response {} multipart {}", target, ranges->size());
+            const auto boundary = fmt::format("MetaPlus{:016x}", folly::Random::rand64());
+            auto response = std::make_unique<
+                http::response<multipart_segment_body>>(http::status::partial_content, request.version(),
+                                                        multipart_byteranges(std::move(whole), *ranges, boundary,
+                                                                             segment_content_type(target)));
+            response->set(http::field::content_type, fmt::format("multipart/byteranges; boundary={}", boundary));
+            prepare_response(response, multipart_segment_body::size(response->body()));
+            send_response(std::move(response));
+        }
+        return true;
+    }
+
+    // mapped, already cached or mapped on demand, a range request never reads whole file into
+    // memory, a cold segment is mapped rather than loaded into cache
+    segment_store::segment session<protocal::http>::range_source(const std::filesystem::path& target) {
+        if (auto mapped = segment_store_ ? segment_store_->find(target) : segment_store::segment{};
+            mapped.owner != nullptr) {
+            return mapped;
+        }
+        if (auto segment = segment_cache_ ? segment_cache_->find_resident(target) : nullptr; segment) {
+            const std::string_view data{ *segment };
+            return segment_store::segment{ std::move(segment), data };
+        }
+        std::error_code error;
+        if (!std::filesystem::is_regular_file(target, error) || std::filesystem::file_size(target, error) == 0) {
+            return segment_store::segment{};
+        }
+        try {
+            return segment_store::map(target);
+        } catch (const boost::interprocess::interprocess_exception& exception) {
+            logger_().error("range_source {} map failed {}", target, exception.what());
+            return segment_store::segment{};
+        }
+    }
+
+#ifdef __linux__
+    void session<protocal::http>::send_file_zero_copy(std::filesystem::path& target,
+                                                      const unsigned version, const bool keep_alive) {
+        auto file = std::make_shared<file_body::value_type>(file_response_body(target));
+        auto response = std::make_unique<http::response<empty_body>>(http::status::ok, version);
+        response->content_length(file->size());
+        response->set(http::field::server, "MetaPlus");
+        response->set(http::field::accept_ranges, "bytes");
+        response->keep_alive(keep_alive);
+        auto serializer = std::make_unique<http::response_serializer<empty_body>>(*response);
+        auto& serializer_ref = serializer.operator*();
+        http::async_write_header(
+            socket_, serializer_ref,
+            [this, file = std::move(file), response = std::move(response),
+                serializer = std::move(serializer)](boost::system::error_code errc,
+                                                    std::size_t transfer_size) mutable {
+                logger_().info("send_file_zero_copy errc {} header {}", errc, transfer_size);
+                if (errc) {
+                    return close_socket_then_complete(errc, boost::asio::socket_base::shutdown_send);
+                }
+                // sendfile reports EAGAIN instead of blocking, asio waits writable for us then
+                socket_.native_non_blocking(true, errc);
+                if (errc) {
+                    return close_socket_then_complete(errc, boost::asio::socket_base::shutdown_send);
+                }
+                transmit_file(std::move(file), 0, response->need_eof());
+            });
+    }
+
+    void session<protocal::http>::transmit_file(std::shared_ptr<file_body::value_type> file,
+                                                const int64_t offset, const bool need_eof) {
+        const auto size = static_cast<off_t>(file->size());
+        auto file_offset = static_cast<off_t>(offset);
+        while (file_offset < size) {
+            const auto transfer_size = ::sendfile(socket_.native_handle(), file->file().native_handle(),
+                                                  &file_offset, static_cast<size_t>(size - file_offset));
+            if (transfer_size > 0 || (transfer_size < 0 && errno == EINTR)) {
+                continue;
+            }
+            if (transfer_size < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                return socket_.async_wait(
+                    boost::asio::socket_base::wait_write,
+                    [this, file = std::move(file), file_offset, need_eof](boost::system::error_code errc) mutable {
+                        if (errc) {
+                            return close_socket_then_complete(errc, boost::asio::socket_base::shutdown_send);
+                        }
+                        transmit_file(std::move(file), file_offset, need_eof);
+                    });
+            }
+            // file shrank after header promised its length, peer can only detect it by eof
+            const auto errc = transfer_size < 0
+                                  ? boost::system::error_code{ errno, boost::system::system_category() }
+                                  : boost::asio::error::eof;
+            return close_socket_then_complete(errc, boost::asio::socket_base::shutdown_both);
+        }
+        logger_().info("transmit_file last {} transfer {}", need_eof, size);
+        if (need_eof) {
+            return close_socket_then_complete({}, boost::asio::socket_base::shutdown_send);
+        }
+        receive_request();
+    }
+#endif
+
     void session<protocal::http>::receive_request() {
         logger_().info("receive_request");
         auto request_ptr = std::make_unique<request<dynamic_body>>();
@@ -1,6 +1,11 @@
 #pragma once
 #include "network/net.h"
+#include "network/byte.range.h"
 #include "network/session.base.h"
+#include "network/segment.body.h"
+#include "network/segment.cache.h"
+#include "network/segment.store.h"
+#include <boost/beast/http/write.hpp>
 
 namespace net::server
 {
@@ -10,6 +15,20 @@ namespace net::server
     template <typename Protocal>
     using session_ptr = std::unique_ptr<session<Protocal>>;
 
+    // how files missing from segment cache are written, zero copy writes header first and
+    // then hands file pages to socket by sendfile(2), degrades to buffered off linux
+    enum class file_transfer
+    {
+        buffered,
+        zero_copy,
+    };
+
+#ifdef __linux__
+    inline constexpr bool zero_copy_supported = true;
+#else
+    inline constexpr bool zero_copy_supported = false;
+#endif
+
     template <>
     class session<protocal::http> final :
         detail::session_base<boost::asio::ip::tcp::socket, flat_buffer>,
@@ -17,6 +36,9 @@ namespace net::server
     {
         const core::logger_access logger_;
         std::filesystem::path root_path_;
+        std::shared_ptr<const segment_store> segment_store_;
+        std::shared_ptr<segment_cache> segment_cache_;
+        file_transfer file_transfer_ = file_transfer::buffered;
         folly::Promise<folly::Unit> completion_;
 
     public:
@@ -27,6 +49,15 @@ namespace net::server
 
         session& root_directory(std::filesystem::path root);
 
+        // shared by sessions of one server, files too large for it are still served from disk
+        session& cache_segments(std::shared_ptr<segment_cache> cache);
+
+        // consulted before segment cache, must be mapped from the same root directory
+        session& store_segments(std::shared_ptr<const segment_store> store);
+
+        // zero copy silently stays buffered where zero_copy_supported is false
+        session& transfer_files(file_transfer transfer);
+
         using session_base::local_endpoint;
         using session_base::remote_endpoint;
         using session_base::index;
@@ -37,7 +68,10 @@ namespace net::server
 
         static pointer create(socket_type&& socket,
                               boost::asio::io_context& context,
-                              std::filesystem::path root);
+                              std::filesystem::path root,
+                              std::shared_ptr<segment_cache> cache = nullptr,
+                              file_transfer transfer = file_transfer::buffered,
+                              std::shared_ptr<const segment_store> store = nullptr);
 
     private:
         void receive_request();
@@ -56,6 +90,27 @@ namespace net::server
             };
         }
 
+#ifdef __linux__
+        void send_file_zero_copy(std::filesystem::path& target, unsigned version, bool keep_alive);
+
+        void transmit_file(std::shared_ptr<file_body::value_type> file, int64_t offset, bool need_eof);
+#endif
+
+        template <typename Body>
+        void send_response(response_ptr<Body> response) {
+            if (response->result() == boost::beast::http::status::ok) {
+                response->set(boost::beast::http::field::accept_ranges, "bytes");
+            }
+            auto& response_ref = response.operator*();
+            logger_().info("send_response reason {}", response->reason());
+            boost::beast::http::async_write(socket_, response_ref, on_send_response(std::move(response)));
+        }
+
+        // false if request has no usable Range header, whole target is sent then
+        bool send_range_response(const request<dynamic_body>& request, const std::filesystem::path& target);
+
+        segment_store::segment range_source(const std::filesystem::path& target);
+
         std::filesystem::path concat_target_path(boost::beast::string_view request_target) const;
 
         void close_socket_then_complete(boost::system::error_code errc,
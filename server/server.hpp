@@ -1,12 +1,15 @@
 #pragma once
 #include "network/session.server.h"
 #include "network/acceptor.h"
-#include <folly/executors/SerialExecutor.h>
+#include <folly/executors/InlineExecutor.h>
 #ifdef signal_set
 #undef signal_set
 #pragma message("macro conflict: signal_set")
 #endif
+#include <boost/asio/dispatch.hpp>
+#include <boost/asio/post.hpp>
 #include <boost/asio/signal_set.hpp>
+#include <boost/asio/steady_timer.hpp>
 #include <boost/process/search_path.hpp>
 #include <boost/process/system.hpp>
 #include <boost/thread/thread.hpp>
@@ -17,16 +20,63 @@ namespace app
     {
         using session_type = net::server::session<net::protocal::http>;
         using socket_type = session_type::socket_type;
+        using acceptor_type = net::server::acceptor<boost::asio::ip::tcp>;
+
+        // one io_context thread per shard, sessions of a shard and its registry are only touched
+        // on that thread, so accepting and erasing sessions never lock or hop executors
+        struct shard final
+        {
+            boost::asio::io_context context;
+            boost::asio::executor_work_guard<boost::asio::io_context::executor_type> work_guard;
+            std::optional<acceptor_type> acceptor;
+            // delays next accept after a transient failure like descriptor exhaustion
+            boost::asio::steady_timer accept_retry;
+            std::unordered_map<int64_t, session_type::pointer> registry;
+            bool accept_paused = false;
+            boost::container::small_vector<std::thread, 8> threads;
+
+            shard()
+                : work_guard{ boost::asio::make_work_guard(context) }
+                , accept_retry{ context } {}
+
+            shard(const shard&) = delete;
+            shard& operator=(const shard&) = delete;
+
+            ~shard() {
+                stop();
+            }
+
+            // sessions are destroyed only after their handlers can no longer run
+            void stop() {
+                work_guard.reset();
+                context.stop();
+                for (auto& thread : threads) {
+                    if (thread.joinable()) {
+                        thread.join();
+                    }
+                }
+                registry.clear();
+            }
+        };
+
+        // accepting pauses at this many live sessions and resumes once one is erased
+        static constexpr inline int64_t default_max_sessions = 16384;
+        static constexpr inline auto accept_retry_delay = std::chrono::milliseconds{ 100 };
 
-        std::unordered_map<boost::asio::ip::tcp::endpoint,
-                           session_type::pointer> session_map_;
         uint16_t port_ = 0;
         std::string directory_;
+        const int64_t max_sessions_ = default_max_sessions;
         core::logger_access logger_;
+        std::shared_ptr<const net::server::segment_store> segment_store_;
+        std::shared_ptr<net::server::segment_cache> segment_cache_;
+        net::server::file_transfer file_transfer_ = net::server::file_transfer::buffered;
         std::shared_ptr<folly::ThreadPoolExecutor> compute_worker_pool_;
-        std::shared_ptr<boost::asio::io_context> asio_worker_pool_;
+        std::mutex schedule_mutex_;
         boost::thread schedule_worker_;
-        net::server::acceptor<boost::asio::ip::tcp> acceptor_;
+        std::vector<std::unique_ptr<shard>> shards_;
+        size_t next_shard_ = 0;
+        std::atomic<int64_t> accept_count_{ 0 };
+        std::atomic<int64_t> active_count_{ 0 };
         boost::asio::signal_set signals_;
         folly::Baton<false> acceptor_cancellation_;
 
@@ -51,24 +101,45 @@ namespace app
         struct server_directory_error : virtual core::exception_base<server_directory_error>,
                                         virtual server_error {};
 
-        struct session_map_error : virtual core::exception_base<session_map_error>,
-                                   virtual core::session_error, virtual server_error {};
-
         server()
-            : port_{ net::config_entry<uint16_t>("Net.Server.Port") }
+            : server{
+                net::config_entry<uint16_t>("Net.Server.Port"),
 #ifdef _WIN32
-            , directory_{ net::config_entry<std::string>("Net.Server.Directories.Root.Win") }
+                net::config_entry<std::string>("Net.Server.Directories.Root.Win"),
 #elif defined __linux__ && _SERVER_WSL
-            , directory_{ net::config_entry<std::string>("Net.Server.Directories.Root.WSL") }
+                net::config_entry<std::string>("Net.Server.Directories.Root.WSL"),
 #elif defined __linux__ && !_SERVER_WSL
-            , directory_{ net::config_entry<std::string>("Net.Server.Directories.Root.Linux") }
+                net::config_entry<std::string>("Net.Server.Directories.Root.Linux"),
 #else
 #error unrecognized platform
 #endif
+                std::max(1u, std::thread::hardware_concurrency())
+            } {
+            if (net::config_entry<bool>("Net.Server.ZeroCopy")) {
+                if (net::server::zero_copy_supported) {
+                    file_transfer_ = net::server::file_transfer::zero_copy;
+                } else {
+                    logger_().warn("zero copy file transfer unsupported, fallback to buffered");
+                }
+            }
+            if (net::config_entry<bool>("Net.Server.MapSegments")) {
+                segment_store_ = std::make_shared<net::server::segment_store>(directory_);
+                logger_().warn("segments are mapped, truncating or rewriting one requires a restart");
+                logger_().info("segment store files {} size {}",
+                               segment_store_->file_count(), segment_store_->size());
+            }
+        }
+
+        // port 0 listens on an ephemeral port, buffered file transfer without segment store
+        server(uint16_t port, std::string directory, unsigned shard_count,
+               int64_t max_sessions = default_max_sessions)
+            : port_{ port }
+            , directory_{ std::move(directory) }
+            , max_sessions_{ max_sessions }
             , logger_{ core::console_logger_access("server") }
-            , asio_worker_pool_{ net::make_asio_pool(std::thread::hardware_concurrency()) }
-            , acceptor_{ port_, *asio_worker_pool_ }
-            , signals_{ *asio_worker_pool_, SIGINT, SIGTERM } {
+            , segment_cache_{ std::make_shared<net::server::segment_cache>() }
+            , shards_{ make_shards(shard_count) }
+            , signals_{ shards_.front()->context, SIGINT, SIGTERM } {
             if (std::filesystem::is_directory(directory_)) {
                 logger_().info("root directory {}", directory_);
             } else {
@@ -78,8 +149,6 @@ namespace app
             signals_.async_wait([this](boost::system::error_code error,
                                        int signal_count) {
                 acceptor_cancellation_.post();
-                acceptor_.close();
-                asio_worker_pool_->stop();
             });
         }
 
@@ -130,59 +199,176 @@ namespace app
 
         void establish_sessions(std::shared_ptr<folly::ThreadPoolExecutor> pool_executor) {
             assert(!compute_worker_pool_ && "remain threads not joined");
-            compute_worker_pool_ = pool_executor;
-            using session_iterator = decltype(session_map_)::iterator;
-            auto serial_executor = folly::SerialExecutor::create(folly::getKeepAliveToken(pool_executor.get()));
-            std::vector<folly::Future<folly::Unit>> procedure_list;
-            while (!acceptor_cancellation_.ready()) {
-                logger_().info("port {} listening", port_);
-                auto session_procedure =
-                    acceptor_.accept_socket().wait()
-                             .via(pool_executor.get())
-                             .thenValue(
-                                 [this](socket_type socket) {
-                                     return session_type::create(
-                                         std::move(socket), *asio_worker_pool_, directory_);
-                                 })
-                             .via(serial_executor.get())
-                             .thenValue(
-                                 [this](session_type::pointer session) {
-                                     if (session_map_.empty()) {
-                                         logger_().warn("first session encountered");
-                                         assert(!schedule_worker_.joinable());
-                                         schedule_worker_ = make_scheduled_worker();
-                                     }
-                                     auto endpoint = session->remote_endpoint();
-                                     auto [iterator, success] = session_map_.emplace(endpoint, std::move(session));
-                                     if (!success) {
-                                         logger_().error("endpoint duplicate");
-                                         acceptor_cancellation_.post();
-                                         session_map_error::throw_in_function("map emplacement");
-                                     }
-                                     return folly::collectAllSemiFuture(
-                                         iterator->second->process_requests(),
-                                         folly::makeSemiFuture(iterator));
-                                 })
-                             .thenValue(
-                                 [this](std::tuple<folly::Try<folly::Unit>,
-                                                   folly::Try<session_iterator>> tuple) {
-                                     auto iterator = std::get<folly::Try<session_iterator>>(tuple).value();
-                                     logger_().warn("erase {} left {}", iterator->second->identity(),
-                                                    session_map_.size() - 1);
-                                     iterator = session_map_.erase(iterator);
-                                     if (!session_map_.empty()) return;
-                                     logger_().warn("all session erased");
-                                     if (!schedule_worker_.joinable()) return;
-                                     logger_().warn("join scheduler thread");
-                                     schedule_worker_.interrupt();
-                                     schedule_worker_.join();
-                                 });
-                procedure_list.push_back(std::move(session_procedure));
-            }
-            const auto result_list = folly::collectAll(procedure_list).get();
-            const auto success = std::count_if(result_list.begin(), result_list.end(),
-                                               std::mem_fn(&folly::Try<folly::Unit>::hasValue));
-            logger_().info("exit success {} of {}", success, result_list.size());
+            compute_worker_pool_ = std::move(pool_executor);
+            for (auto& shard : shards_) {
+                if (shard->acceptor.has_value()) {
+                    boost::asio::post(shard->context, [this, &shard = *shard] {
+                        accept_next(shard);
+                    });
+                }
+                shard->threads = net::make_asio_threads(shard->context, 1);
+            }
+            logger_().info("port {} listening shards {}", port_, shards_.size());
+            acceptor_cancellation_.wait();
+            for (auto& shard : shards_) {
+                shard->stop();
+            }
+            compute_worker_pool_->join();
+            compute_worker_pool_ = nullptr;
+            if (schedule_worker_.joinable()) {
+                schedule_worker_.interrupt();
+                schedule_worker_.join();
+            }
+            logger_().info("event=server.release,shards={},accept={},active={}",
+                           shards_.size(), accept_count_.load(), active_count_.load());
+            logger_().info("event=segment_cache.release,hit={},miss={},evict={},size={}",
+                           segment_cache_->hit_count(), segment_cache_->miss_count(),
+                           segment_cache_->evict_count(), segment_cache_->size());
+            if (segment_store_) {
+                logger_().info("event=segment_store.release,hit={},miss={},files={},size={}",
+                               segment_store_->hit_count(), segment_store_->miss_count(),
+                               segment_store_->file_count(), segment_store_->size());
+            }
+        }
+
+        // same as an interrupt signal, establish_sessions stops shards and returns
+        void cancel() {
+            acceptor_cancellation_.post();
+        }
+
+        uint16_t listen_port() const {
+            return shards_.front()->acceptor->listen_port();
+        }
+
+        int64_t accept_count() const noexcept {
+            return accept_count_.load();
+        }
+
+        int64_t active_count() const noexcept {
+            return active_count_.load();
+        }
+
+    private:
+        // every shard listens on the port where kernel balances by reuse port,
+        // elsewhere first shard accepts alone and deals sockets to shards in turn
+        std::vector<std::unique_ptr<shard>> make_shards(const unsigned shard_count) const {
+            std::vector<std::unique_ptr<shard>> shards(shard_count);
+            std::generate(shards.begin(), shards.end(), [] {
+                return std::make_unique<shard>();
+            });
+            auto listen_port = port_;
+            for (auto& shard : shards) {
+                shard->acceptor.emplace(listen_port, shard->context, false, acceptor_type::reuse_port_supported);
+                listen_port = shard->acceptor->listen_port();
+                if (!acceptor_type::reuse_port_supported) {
+                    break;
+                }
+            }
+            return shards;
+        }
+
+        // runs on listener thread, next accept is issued as soon as one completes
+        void accept_next(shard& listener) {
+            if (active_count_.load() >= max_sessions_) {
+                logger_().warn("accept paused at {} sessions", max_sessions_);
+                listener.accept_paused = true;
+                return;
+            }
+            auto& target = acceptor_type::reuse_port_supported
+                               ? listener
+                               : *shards_[next_shard_++ % shards_.size()];
+            listener.acceptor->accept_socket(target.context)
+                    .via(&folly::InlineExecutor::instance())
+                    .thenTry([this, &listener, &target](folly::Try<socket_type>&& socket) {
+                        if (socket.hasException()) {
+                            return retry_accept(listener, socket.exception());
+                        }
+                        accept_count_.fetch_add(1);
+                        boost::asio::dispatch(target.context,
+                                              [this, &target, socket = std::move(socket).value()]() mutable {
+                                                  register_session(target, std::move(socket));
+                                              });
+                        accept_next(listener);
+                    });
+        }
+
+        // only a closed acceptor stops accepting, failures of a single connection or
+        // exhausted descriptors are retried after a delay to let sessions close
+        void retry_accept(shard& listener, const folly::exception_wrapper& exception) {
+            auto aborted = false;
+            exception.with_exception([&aborted](const boost::system::system_error& error) {
+                aborted = error.code() == boost::asio::error::operation_aborted;
+            });
+            if (aborted) {
+                return logger_().warn("accept stopped {}", exception.what().toStdString());
+            }
+            logger_().error("accept failed {}, retry", exception.what().toStdString());
+            listener.accept_retry.expires_after(accept_retry_delay);
+            listener.accept_retry.async_wait([this, &listener](boost::system::error_code error) {
+                if (!error) {
+                    accept_next(listener);
+                }
+            });
+        }
+
+        void resume_accept() {
+            for (auto& shard : shards_) {
+                if (shard->acceptor.has_value()) {
+                    boost::asio::post(shard->context, [this, &shard = *shard] {
+                        if (std::exchange(shard.accept_paused, false)) {
+                            logger_().warn("accept resumed");
+                            accept_next(shard);
+                        }
+                    });
+                }
+            }
+        }
+
+        void register_session(shard& shard, socket_type&& socket) {
+            auto session = session_type::create(std::move(socket), shard.context, directory_,
+                                                segment_cache_, file_transfer_, segment_store_);
+            const auto index = session->index();
+            auto& registered = shard.registry.emplace(index, std::move(session)).first->second;
+            if (active_count_.fetch_add(1) == 0) {
+                reconcile_scheduler();
+            }
+            registered->process_requests()
+                      .via(&folly::InlineExecutor::instance())
+                      .thenTry([this, &shard, index](folly::Try<folly::Unit>&&) {
+                          // completion is set inside a handler of the session, erase after it unwinds
+                          boost::asio::post(shard.context, [this, &shard, index] {
+                              erase_session(shard, index);
+                          });
+                      });
+        }
+
+        void erase_session(shard& shard, const int64_t index) {
+            const auto session_iter = shard.registry.find(index);
+            assert(session_iter != shard.registry.end());
+            logger_().info("erase {} left {}", session_iter->second->identity(), active_count_.load() - 1);
+            shard.registry.erase(session_iter);
+            const auto active = active_count_.fetch_sub(1) - 1;
+            if (active == 0) {
+                reconcile_scheduler();
+            }
+            if (active == max_sessions_ - 1) {
+                resume_accept();
+            }
+        }
+
+        // first and last session race across shards, worker state follows live count instead
+        void reconcile_scheduler() {
+            compute_worker_pool_->add([this] {
+                std::lock_guard<std::mutex> lock{ schedule_mutex_ };
+                if (const auto active = active_count_.load(); active > 0 && !schedule_worker_.joinable()) {
+                    logger_().warn("first session encountered");
+                    schedule_worker_ = make_scheduled_worker();
+                } else if (active == 0 && schedule_worker_.joinable()) {
+                    logger_().warn("all session erased, join scheduler thread");
+                    schedule_worker_.interrupt();
+                    schedule_worker_.join();
+                }
+            });
         }
     };
 }
@@ -1,8 +1,10 @@
 #include "pch.h"
 #include "core/meta/function_trait.hpp"
 #include "core/meta/member_function_trait.hpp"
+#include "core/segment_buffer.hpp"
 #include <folly/executors/CPUThreadPoolExecutor.h>
 #include <folly/executors/GlobalExecutor.h>
+#include <boost/beast/core/multi_buffer.hpp>
 #include <spdlog/sinks/basic_file_sink.h>
 #include <absl/numeric/int128_no_intrinsic.inc>
 #include <range/v3/view/iota.hpp>
@@ -138,4 +140,62 @@ namespace core::test
         th2.join();
         spdlog::drop_all();
     }
+
+    TEST(SegmentBuffer, GrowAndConsume) {
+        segment_buffer buffer;
+        const std::string head(1000, 'h');
+        const std::string tail(100 * 1024, 't');
+        buffer.commit(boost::asio::buffer_copy(buffer.prepare(head.size()), boost::asio::buffer(head)));
+        buffer.consume(10);
+        buffer.commit(boost::asio::buffer_copy(buffer.prepare(tail.size()), boost::asio::buffer(tail)));
+        EXPECT_EQ(buffer.size(), head.size() - 10 + tail.size());
+        const auto* data = static_cast<const char*>(buffer.data().data());
+        EXPECT_EQ(std::string_view(data, head.size() - 10), head.substr(10));
+        EXPECT_EQ(std::string_view(data + head.size() - 10, tail.size()), tail);
+        buffer.consume(buffer.size());
+        EXPECT_EQ(buffer.size(), 0);
+    }
+
+    TEST(SegmentBuffer, ClassSizeBeyondPool) {
+        EXPECT_EQ(segment_pool::class_size(1), segment_pool::min_block_size);
+        EXPECT_EQ(segment_pool::class_size(segment_pool::max_block_size), segment_pool::max_block_size);
+        const auto oversize = segment_pool::max_block_size + 1;
+        EXPECT_EQ(segment_pool::class_size(oversize), oversize);
+        EXPECT_EQ(segment_pool::class_size(SIZE_MAX), SIZE_MAX);
+        segment_pool pool;
+        auto [block, block_size] = pool.acquire(oversize);
+        EXPECT_EQ(block_size, oversize);
+        pool.release(std::move(block), block_size);
+        std::tie(block, block_size) = pool.acquire(oversize);
+        EXPECT_EQ(pool.hit_count(), 0);
+    }
+
+    TEST(SegmentBuffer, PoolReuseProfile) {
+        auto pool = std::make_shared<segment_pool>(2);
+        const std::string chunk(16 * 1024, 'c');
+        auto fill_segment = [&chunk](segment_buffer& buffer, size_t content_size) {
+            buffer.reserve(content_size);
+            for (size_t size = 0; size < content_size; size += chunk.size()) {
+                buffer.commit(boost::asio::buffer_copy(buffer.prepare(chunk.size()), boost::asio::buffer(chunk)));
+            }
+        };
+        folly::stop_watch<std::chrono::microseconds> watch;
+        for (auto index = 1; index <= 100; ++index) {
+            segment_buffer buffer{ pool };
+            fill_segment(buffer, 1024 * 1024 + index * 1024);
+            EXPECT_EQ(segment_pool::class_size(buffer.size()), buffer.capacity());
+        }
+        const auto pool_time = watch.lap();
+        for (auto index = 1; index <= 100; ++index) {
+            boost::beast::multi_buffer buffer;
+            for (size_t size = 0; size < 1024 * 1024 + index * 1024; size += chunk.size()) {
+                buffer.commit(boost::asio::buffer_copy(buffer.prepare(chunk.size()), boost::asio::buffer(chunk)));
+            }
+        }
+        const auto multi_buffer_time = watch.lap();
+        fmt::print("segment pool {} us hit {} miss {}, multi_buffer {} us\n",
+                   pool_time.count(), pool->hit_count(), pool->miss_count(), multi_buffer_time.count());
+        EXPECT_EQ(pool->miss_count(), 1);
+        EXPECT_EQ(pool->hit_count(), 99);
+    }
 }
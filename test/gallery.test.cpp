@@ -3,13 +3,15 @@
 #include "multimedia/io.segmentor.h"
 #include "gallery/pch.h"
 #include "gallery/database.sqlite.h"
+#include "gallery/plugin.ring.h"
+#include "gallery/plugin.assembly.h"
+#include "gallery/plugin.clock.h"
 #include <folly/MoveWrapper.h>
 #include <boost/beast/core/multi_buffer.hpp>
 #include <objbase.h>
 #include "core/meta/exception_trait.hpp"
 #include <range/v3/view/cartesian_product.hpp>
 #include <range/v3/view/iota.hpp>
-#include <range/v3/action/remove_if.hpp>
 #include <boost/process/environment.hpp>
 #include <re2/re2.h>
 #include <numeric>
@@ -65,17 +67,31 @@ frame_indexed_builder create_frame_builder(pixel_consume& consume,
     };
 }
 
+auto process_cpu_time = [] {
+    FILETIME creation_time, exit_time, kernel_time, user_time;
+    EXPECT_TRUE(GetProcessTimes(GetCurrentProcess(), &creation_time, &exit_time, &kernel_time, &user_time));
+    const auto to_duration = [](const FILETIME& time) {
+        const auto ticks = static_cast<int64_t>(time.dwHighDateTime) << 32 | time.dwLowDateTime;
+        return microseconds{ ticks / 10 };
+    };
+    return to_duration(kernel_time) + to_duration(user_time);
+};
+
 auto plugin_routine = [](std::string url) {
-    return [url](unsigned codec_concurrency = 8) {
+    return [url](unsigned codec_concurrency = 8, bool decode_schedule = true) {
+        // tile grid is named by mpd directory, e.g. NewYork/6x5/NewYork.mpd
+        int expect_col = 0, expect_row = 0;
+        ASSERT_TRUE(RE2::PartialMatch(url, R"(/(\d+)x(\d+)/)", &expect_col, &expect_row));
         std::this_thread::sleep_for(100ms);
-        ASSERT_TRUE(_nativeLibraryConfigLoad("http://47.101.209.146:33666/NewYork/3x3/NewYork.mpd"));
-        test::_nativeTestConcurrencyStore(1, 2);
+        ASSERT_TRUE(_nativeLibraryConfigLoad(url.data()));
+        test::_nativeTestConcurrencyStore(codec_concurrency, 2);
+        test::_nativeTestDecodeScheduleStore(decode_schedule);
         _nativeLibraryInitialize();
         _nativeDashCreate();
         int col = 0, row = 0, width = 0, height = 0;
         ASSERT_TRUE(_nativeDashGraphicInfo(col, row, width, height));
-        ASSERT_EQ(col, 3);
-        ASSERT_EQ(row, 3);
+        ASSERT_EQ(col, expect_col);
+        ASSERT_EQ(row, expect_row);
         ASSERT_EQ(width, 3840);
         ASSERT_EQ(height, 1920);
         std::vector<void*> stream_list;
@@ -89,42 +105,37 @@ auto plugin_routine = [](std::string url) {
         }
         ASSERT_EQ(col*row, stream_coordinate_map.size());
         folly::stop_watch<seconds> watch;
+        const auto cpu_time_begin = process_cpu_time();
         _nativeDashPrefetch();
-        auto stream_cache = stream_list;
         struct counter
         {
             int frame = 0;
-            int tile = 0;
+            int64_t assembled = -1;
         } counters;
         auto available = true;
         auto update_time = std::chrono::steady_clock::now() + 10ms;
         while (available) {
             std::this_thread::sleep_until(update_time);
             update_time += 11ms;
-            stream_cache |= ranges::action::remove_if(
-                [&](void* tile_stream) {
-                    const auto poll_success =
-                        _nativeDashTilePtrPollUpdate(tile_stream, counters.frame, counters.tile);
-                    if (poll_success) {
-                        counters.tile++;
-                    }
-                    return poll_success;
-                });
-            if (stream_cache.empty()) {
+            // one native call per render frame, tiles of a frame are committed together
+            if (_nativeDashFramePollUpdate(counters.frame, counters.assembled) != 0) {
                 if (++counters.frame % 100 == 0 || counters.frame > 3714) {
-                    XLOG(INFO) << "frame " << counters.frame;
+                    XLOG(INFO) << "frame " << counters.frame << " assembled " << counters.assembled;
                 }
-                //EXPECT_EQ(counters.tile % 9, 0);
-                stream_cache = stream_list;
                 available = _nativeDashAvailable();
             }
         }
         const auto t1 = watch.elapsed();
+        const auto cpu_time = process_cpu_time() - cpu_time_begin;
+        const auto cpu_utilization = 100. * cpu_time.count()
+            / std::chrono::duration_cast<microseconds>(t1).count() / std::thread::hardware_concurrency();
         XLOG(INFO) << "-- profile parting line\n"
             << "concurrency " << codec_concurrency << "\n"
+            << "schedule " << decode_schedule << "\n"
             << "iteration " << counters.frame << "\n"
             << "time " << t1.count() << "\n"
-            << "fps " << counters.frame / t1.count() << "\n";
+            << "fps " << counters.frame / t1.count() << "\n"
+            << "cpu " << cpu_utilization << "%\n";
         _nativeLibraryRelease();
         EXPECT_GE(counters.frame, 3715);
     };
@@ -146,6 +157,13 @@ namespace gallery::test
         }
     }
 
+    TEST(Plugin, DecodeSchedulerProfile) {
+        auto profile_decode_schedule = plugin_routine(
+            "http://47.101.209.146:33666/NewYork/6x5/NewYork.mpd");
+        profile_decode_schedule(1, false);
+        profile_decode_schedule(1, true);
+    }
+
     struct log_cache_slot
     {
         system_clock::time_point request_time;
@@ -476,6 +494,131 @@ namespace gallery::test
         }
     }
 
+    TEST(FrameRing, StagedHandoff) {
+        constexpr auto frame_count = 100000;
+        plugin::frame_ring<int> ring{ 4 };
+        std::thread decoder{
+            [&ring] {
+                for (auto index = 0; index < frame_count;) {
+                    if (ring.write(index)) {
+                        ++index;
+                    } else {
+                        std::this_thread::yield();
+                    }
+                }
+            }
+        };
+        std::thread poller{
+            [&ring] {
+                for (auto index = 0; index < frame_count;) {
+                    if (ring.pending_front() != nullptr) {
+                        ring.commit();
+                        ++index;
+                    } else {
+                        std::this_thread::yield();
+                    }
+                }
+            }
+        };
+        folly::stop_watch<microseconds> watch;
+        for (auto index = 0; index < frame_count;) {
+            if (auto* frame = ring.committed_front()) {
+                EXPECT_EQ(*frame, index++);
+                ring.pop();
+            } else {
+                std::this_thread::yield();
+            }
+        }
+        fmt::print("handoff {} frames {} us\n", frame_count, watch.elapsed().count());
+        decoder.join();
+        poller.join();
+        EXPECT_EQ(ring.size(), 0);
+        EXPECT_EQ(ring.pending_size(), 0);
+        EXPECT_FALSE(ring.committed_front());
+    }
+
+    TEST(FrameRing, DiscardWithoutReader) {
+        plugin::frame_ring<std::shared_ptr<int>> ring{ 2 };
+        auto value = std::make_shared<int>(0);
+        EXPECT_TRUE(ring.write(value));
+        EXPECT_TRUE(ring.write(value));
+        EXPECT_FALSE(ring.write(value));
+        EXPECT_EQ(value.use_count(), 3);
+        ring.discard();
+        EXPECT_EQ(value.use_count(), 2);
+        EXPECT_FALSE(ring.committed_front());
+        EXPECT_TRUE(ring.write(value));
+        ring.discard();
+        ring.discard();
+        EXPECT_EQ(value.use_count(), 1);
+        EXPECT_EQ(ring.size(), 0);
+        EXPECT_EQ(ring.pending_size(), 0);
+        EXPECT_FALSE(ring.pending_front());
+    }
+
+    TEST(FrameAssembly, CompleteAcrossTiles) {
+        constexpr auto tile_count = 4;
+        constexpr auto frame_count = 10000;
+        plugin::frame_assembly assembly{ tile_count, 8 };
+        EXPECT_EQ(assembly.assembled(), -1);
+        assembly.complete(0);
+        assembly.complete(1);
+        EXPECT_EQ(assembly.assembled(), -1);
+        std::vector<std::thread> decoders;
+        std::array<std::atomic<int64_t>, tile_count> tile_frames{};
+        tile_frames[0] = 2;
+        for (auto tile = 0; tile < tile_count; ++tile) {
+            decoders.emplace_back(
+                [&, tile] {
+                    // tile 0 already completed frames 0 and 1 above
+                    for (int64_t frame = tile == 0 ? 2 : 0; frame < frame_count;) {
+                        const int64_t lowest = *std::min_element(tile_frames.begin(), tile_frames.end());
+                        if (frame - lowest >= 4) {
+                            std::this_thread::yield();
+                            continue;
+                        }
+                        assembly.complete(frame);
+                        tile_frames[tile] = ++frame;
+                    }
+                });
+        }
+        auto assembled = assembly.assembled();
+        while (assembled < frame_count - 1) {
+            const auto next_assembled = assembly.assembled();
+            EXPECT_GE(next_assembled, assembled);
+            assembled = next_assembled;
+            std::this_thread::yield();
+        }
+        for (auto& decoder : decoders) {
+            decoder.join();
+        }
+        EXPECT_EQ(assembly.assembled(), frame_count - 1);
+    }
+
+    TEST(PresentationClock, DropAndRepeat) {
+        using decision = plugin::presentation_clock::decision;
+        plugin::presentation_clock clock;
+        const auto frame_interval = absl::Milliseconds(33);
+        const auto start_time = absl::Now();
+        clock.tick(start_time, false);
+        EXPECT_EQ(clock.schedule(absl::ZeroDuration(), frame_interval), decision::present);
+        clock.tick(start_time + absl::Milliseconds(100), false);
+        EXPECT_EQ(clock.media_time(), absl::Milliseconds(100));
+        EXPECT_EQ(clock.schedule(absl::Milliseconds(33), frame_interval), decision::drop);
+        EXPECT_EQ(clock.schedule(absl::Milliseconds(66), frame_interval), decision::drop);
+        EXPECT_EQ(clock.schedule(absl::Milliseconds(99), frame_interval), decision::present);
+        EXPECT_EQ(clock.schedule(absl::Milliseconds(132), frame_interval), decision::wait);
+        clock.repeat();
+        // every tile starves, timeline halts instead of dropping frames later
+        clock.tick(start_time + absl::Milliseconds(500), true);
+        EXPECT_EQ(clock.media_time(), absl::Milliseconds(100));
+        EXPECT_EQ(clock.schedule(absl::Milliseconds(132), frame_interval), decision::wait);
+        EXPECT_EQ(clock.schedule(absl::InfiniteDuration(), frame_interval), decision::present);
+        EXPECT_EQ(clock.present_count(), 3);
+        EXPECT_EQ(clock.drop_count(), 2);
+        EXPECT_EQ(clock.repeat_count(), 1);
+    }
+
     TEST(Gallery, Concurrency) {
         unsigned codec = 0, net = 0, executor = 0;
         unity::test::_nativeTestConcurrencyLoad(codec, net, executor);
@@ -1,19 +1,27 @@
 #include "pch.h"
 #include "multimedia/command.h"
+#include "multimedia/command.manifest.h"
 #include "multimedia/context.h"
+#include "multimedia/frame.compositor.h"
+#include "multimedia/frame.pool.h"
 #include "multimedia/io.segmentor.h"
+#include "multimedia/io.session.h"
 #include "multimedia/media.h"
+#include "multimedia/plane.kernel.h"
 #include "core/exception.hpp"
 #include <folly/executors/Async.h>
 #include <folly/executors/CPUThreadPoolExecutor.h>
 #include <folly/executors/GlobalExecutor.h>
 #include <folly/executors/task_queue/UnboundedBlockingQueue.h>
 #include <folly/MoveWrapper.h>
+#include <boost/beast/core/buffers_range.hpp>
+#include <boost/beast/core/buffers_to_string.hpp>
 #include <boost/beast/core/flat_buffer.hpp>
 #include <boost/beast/core/multi_buffer.hpp>
 #include <boost/beast/core/ostream.hpp>
 #include <boost/container/small_vector.hpp>
 #include <any>
+#include <future>
 #include <numeric>
 
 using boost::beast::multi_buffer;
@@ -104,15 +112,6 @@ namespace boost::test
     }
 }
 
-template <template<typename> typename Container>
-int64_t total_size(Container<const_buffer>& container) {
-    size_t size = 0;
-    for (auto& element : container) {
-        size += element.size();
-    }
-    return size;
-}
-
 void set_cpu_executor(int concurrency) {
     static auto executor = std::make_shared<folly::CPUThreadPoolExecutor>(
         std::make_pair(concurrency, 1),
@@ -129,9 +128,32 @@ namespace core::test
         auto list = core::split_buffer_sequence(buf1);
         auto list2 = core::split_buffer_sequence(buf_int, buf1);
         auto list3 = core::split_buffer_sequence(buf_int, buf1);
-        EXPECT_EQ(total_size<std::list>(list), 2090);
-        EXPECT_EQ(total_size<std::list>(list2), 2966);
-        EXPECT_EQ(total_size<std::list>(list3), 2966);
+        EXPECT_EQ(list.total_size(), 2090);
+        EXPECT_EQ(list2.total_size(), 2966);
+        EXPECT_EQ(list3.total_size(), 2966);
+        EXPECT_EQ(buffer_size(list2), 2966);
+    }
+
+    TEST(BufferOperation, LocateOffset) {
+        auto& buffer_map = create_buffer_map();
+        const auto buffer_list = core::split_buffer_sequence(buffer_map[0], buffer_map[1], buffer_map[2]);
+        EXPECT_EQ(buffer_list.locate(0), 0);
+        EXPECT_EQ(buffer_list.locate(buffer_list.total_size()), buffer_list.size());
+        for (size_t index = 0; index < buffer_list.size(); ++index) {
+            const auto begin = buffer_list.offset(index);
+            EXPECT_EQ(buffer_list.locate(begin), index);
+            EXPECT_EQ(buffer_list.locate(begin + buffer_list[index].size() - 1), index);
+        }
+        const auto flat_sequence = boost::beast::buffers_to_string(buffer_list);
+        media::buffer_list_cursor cursor{ buffer_list };
+        std::array<uint8_t, 64> read_buffer;
+        const auto boundary = folly::to<int64_t>(buffer_map[0].size());
+        for (auto offset : { 0i64, 100i64, boundary - 10, buffer_list.total_size() - 64 }) {
+            EXPECT_EQ(cursor.seek(offset, SEEK_SET), offset);
+            EXPECT_EQ(cursor.read(read_buffer.data(), 64), 64);
+            EXPECT_EQ(std::string_view(reinterpret_cast<const char*>(read_buffer.data()), 64),
+                      std::string_view(flat_sequence).substr(offset, 64));
+        }
     }
 }
 
@@ -197,6 +219,520 @@ namespace media::test
     }
 }
 
+auto tile_segment_buffer = [](int col, int row, int qp, std::string index) {
+    const auto suffix = index == "init" ? "init.mp4" : fmt::format("{}.m4s", index);
+    multi_buffer buffer;
+    ostream(buffer) << std::ifstream{
+        fmt::format("D:/Media/NewYork/6x5/NewYork_c{}r{}_qp{}_dash{}", col, row, qp, suffix),
+        std::ios::binary
+    }.rdbuf();
+    return buffer;
+};
+
+auto decode_session_frame_count = [](media::decode_session& decode_session) {
+    auto count = 0i64;
+    try {
+        while (true) {
+            count += std::size(decode_session.try_consume());
+        }
+    } catch (core::stream_drained_error) {}
+    return count;
+};
+
+namespace media::test
+{
+    TEST(DecodeSession, ConsumeAcrossSegment) {
+        auto& buffer_map = create_buffer_map();
+        auto index = 0;
+        media::decode_session decode_session{
+            [&]() -> media::decode_session::segment {
+                if (++index > 10) {
+                    core::stream_drained_error::throw_directly();
+                }
+                return { buffer_map[0], core::segment_buffer{ buffer_map[index].data() } };
+            },
+            4
+        };
+        EXPECT_EQ(decode_session_frame_count(decode_session), 250);
+        EXPECT_EQ(decode_session.segment_count(), 10);
+        EXPECT_EQ(decode_session.switch_count(), 0);
+        EXPECT_FALSE(decode_session.codec_available());
+    }
+
+    TEST(DecodeSession, SwitchRepresentation) {
+        std::map<int, multi_buffer> initial_map;
+        initial_map.emplace(22, tile_segment_buffer(0, 0, 22, "init"));
+        initial_map.emplace(42, tile_segment_buffer(0, 0, 42, "init"));
+        auto session_provider = [&initial_map](std::function<int(int)> qp_of) {
+            return [&initial_map, qp_of, index = 0]() mutable -> media::decode_session::segment {
+                if (++index > 10) {
+                    core::stream_drained_error::throw_directly();
+                }
+                const auto qp = qp_of(index);
+                return {
+                    initial_map.at(qp), core::segment_buffer{ tile_segment_buffer(0, 0, qp, std::to_string(index)).data() }
+                };
+            };
+        };
+        media::decode_session constant_session{
+            session_provider([](int) { return 22; }), 4
+        };
+        media::decode_session switch_session{
+            session_provider([](int index) { return index % 2 ? 22 : 42; }), 4
+        };
+        folly::stop_watch<milliseconds> watch;
+        const auto constant_count = decode_session_frame_count(constant_session);
+        const auto constant_time = watch.lap();
+        const auto switch_count = decode_session_frame_count(switch_session);
+        const auto switch_time = watch.lap();
+        fmt::print("constant {} frames {} ms, switch {} frames {} ms\n",
+                   constant_count, constant_time.count(), switch_count, switch_time.count());
+        EXPECT_GT(constant_count, 0);
+        EXPECT_EQ(constant_count, switch_count);
+        EXPECT_EQ(switch_session.switch_count(), 9);
+    }
+
+    TEST(DecodeSession, DiscardNonReference) {
+        auto& buffer_map = create_buffer_map();
+        auto session_provider = [&buffer_map] {
+            return [&buffer_map, index = 0]() mutable -> media::decode_session::segment {
+                if (++index > 10) {
+                    core::stream_drained_error::throw_directly();
+                }
+                return { buffer_map[0], core::segment_buffer{ buffer_map[index].data() } };
+            };
+        };
+        // presentation time of each frame index, infinite for a placeholder
+        auto consume_timeline = [](media::decode_session& decode_session,
+                                   media::decode_session::discard policy) {
+            std::vector<absl::Duration> timeline;
+            try {
+                while (true) {
+                    for (auto& frame : decode_session.try_consume(policy)) {
+                        timeline.push_back(frame.empty() ? absl::InfiniteDuration() : frame.presentation_time());
+                    }
+                }
+            } catch (core::stream_drained_error) {}
+            return timeline;
+        };
+        media::decode_session full_session{ session_provider(), 1 };
+        media::decode_session discard_session{ session_provider(), 1 };
+        folly::stop_watch<milliseconds> watch;
+        const auto full_timeline = consume_timeline(full_session, media::decode_session::discard::none);
+        const auto full_time = watch.lap();
+        const auto discard_timeline = consume_timeline(discard_session, media::decode_session::discard::nonreference);
+        const auto discard_time = watch.lap();
+        fmt::print("full {} frames {} ms, discard {} of {} frames {} ms\n",
+                   full_timeline.size(), full_time.count(), discard_session.discard_count(),
+                   discard_timeline.size(), discard_time.count());
+        EXPECT_EQ(full_timeline.size(), 250u);
+        ASSERT_EQ(full_timeline.size(), discard_timeline.size());
+        EXPECT_EQ(full_session.discard_count(), 0);
+        EXPECT_GT(discard_session.discard_count(), 0);
+        EXPECT_EQ(std::count(discard_timeline.begin(), discard_timeline.end(), absl::InfiniteDuration()),
+                  discard_session.discard_count());
+        for (size_t index = 0; index < full_timeline.size(); ++index) {
+            if (discard_timeline[index] != absl::InfiniteDuration()) {
+                EXPECT_EQ(discard_timeline[index], full_timeline[index]) << "frame index " << index;
+            }
+        }
+    }
+
+    TEST(DecodeSession, StreamSegment) {
+        constexpr auto chunk_size = 16 * 1024;
+        constexpr auto chunk_delay = milliseconds{ 2 };
+        auto& buffer_map = create_buffer_map();
+        std::vector<std::shared_ptr<core::chunk_stream>> streams;
+        for (auto index = 1; index <= 10; ++index) {
+            streams.push_back(std::make_shared<core::chunk_stream>(folly::to<int64_t>(buffer_map[index].size())));
+        }
+        folly::stop_watch<milliseconds> watch;
+        milliseconds first_download{ 0 };
+        // emulates body chunks arriving from network
+        std::thread download_thread{
+            [&] {
+                for (auto index = 1; index <= 10; ++index) {
+                    for (auto buffer : boost::beast::buffers_range(buffer_map[index].data())) {
+                        while (buffer.size() > 0) {
+                            const auto size = std::min<size_t>(buffer.size(), chunk_size);
+                            streams[index - 1]->append(const_buffer{ buffer.data(), size });
+                            buffer += size;
+                            std::this_thread::sleep_for(chunk_delay);
+                        }
+                    }
+                    streams[index - 1]->close();
+                    if (index == 1) {
+                        first_download = watch.elapsed();
+                    }
+                }
+            }
+        };
+        auto index = 0;
+        media::decode_session decode_session{
+            [&]() -> media::decode_session::segment {
+                if (++index > 10) {
+                    core::stream_drained_error::throw_directly();
+                }
+                return { buffer_map[0], core::segment_buffer{}, streams[index - 1] };
+            },
+            4
+        };
+        std::optional<milliseconds> first_frame;
+        auto count = 0i64;
+        try {
+            while (true) {
+                const auto frame_count = std::size(decode_session.try_consume());
+                if (frame_count > 0 && !first_frame.has_value()) {
+                    first_frame = watch.elapsed();
+                }
+                count += frame_count;
+            }
+        } catch (core::stream_drained_error) {}
+        download_thread.join();
+        fmt::print("first frame {} ms, first segment downloaded {} ms, total {} ms\n",
+                   first_frame->count(), first_download.count(), watch.elapsed().count());
+        EXPECT_EQ(count, 250);
+        EXPECT_EQ(decode_session.segment_count(), 10);
+        EXPECT_LT(*first_frame, first_download);
+    }
+
+    TEST(DecodeSession, StreamDemand) {
+        constexpr size_t chunk_size = 16 * 1024;
+        auto& buffer_map = create_buffer_map();
+        std::vector<std::shared_ptr<core::chunk_stream>> streams;
+        std::vector<std::string> bodies;
+        std::vector<size_t> append_sizes(10, 0);
+        for (auto index = 1; index <= 10; ++index) {
+            bodies.push_back(boost::beast::buffers_to_string(buffer_map[index].data()));
+            streams.push_back(std::make_shared<core::chunk_stream>(folly::to<int64_t>(bodies.back().size())));
+        }
+        auto index = 0;
+        media::decode_session decode_session{
+            [&]() -> media::decode_session::segment {
+                if (++index > 10) {
+                    core::stream_drained_error::throw_directly();
+                }
+                return { buffer_map[0], core::segment_buffer{}, streams[index - 1] };
+            },
+            4
+        };
+        // chunks are appended on this thread only while decode waits on stream_demand, a read
+        // past downloaded bytes would block for good, watchdog fails streams instead
+        std::promise<void> finished;
+        std::thread watchdog{
+            [&streams, finished = finished.get_future()] {
+                if (finished.wait_for(std::chrono::seconds{ 30 }) == std::future_status::timeout) {
+                    for (auto& stream : streams) {
+                        stream->close(std::make_exception_ptr(std::runtime_error{ "decode blocked on stream" }));
+                    }
+                }
+            }
+        };
+        auto count = 0i64;
+        auto demand_count = 0;
+        try {
+            while (true) {
+                if (decode_session.stream_demand()) {
+                    auto& body = bodies[index - 1];
+                    auto& append_size = append_sizes[index - 1];
+                    const auto size = std::min(chunk_size, body.size() - append_size);
+                    streams[index - 1]->append(const_buffer{ body.data() + append_size, size });
+                    if ((append_size += size) == body.size()) {
+                        streams[index - 1]->close();
+                    }
+                    demand_count++;
+                    continue;
+                }
+                count += std::size(decode_session.try_consume());
+            }
+        } catch (core::stream_drained_error) {}
+        finished.set_value();
+        watchdog.join();
+        fmt::print("stream demand {} times\n", demand_count);
+        EXPECT_EQ(count, 250);
+        EXPECT_EQ(decode_session.segment_count(), 10);
+        EXPECT_GE(demand_count, 10);
+    }
+
+    TEST(FramePool, RecycleProfile) {
+        auto& buffer_map = create_buffer_map();
+        auto session_provider = [&buffer_map] {
+            return [&buffer_map, index = 0]() mutable -> media::decode_session::segment {
+                if (++index > 10) {
+                    core::stream_drained_error::throw_directly();
+                }
+                return { buffer_map[0], core::segment_buffer{ buffer_map[index].data() } };
+            };
+        };
+        auto frame_pool = std::make_shared<media::frame_pool>(16);
+        media::decode_session default_session{ session_provider(), 4 };
+        media::decode_session pooled_session{ session_provider(), 4, frame_pool };
+        folly::stop_watch<milliseconds> watch;
+        const auto default_count = decode_session_frame_count(default_session);
+        const auto default_time = watch.lap();
+        const auto pooled_count = decode_session_frame_count(pooled_session);
+        const auto pooled_time = watch.lap();
+        fmt::print("default {} frames {} ms, pooled {} frames {} ms, hit {} miss {}\n",
+                   default_count, default_time.count(), pooled_count, pooled_time.count(),
+                   frame_pool->hit_count(), frame_pool->miss_count());
+        EXPECT_EQ(default_count, pooled_count);
+        EXPECT_EQ(frame_pool->slab_count(), 1);
+        EXPECT_GT(frame_pool->hit_count(), frame_pool->miss_count());
+    }
+
+    TEST(FrameCompositor, ComposeProfile) {
+        constexpr auto col = 4, row = 3;
+        constexpr auto tile_width = 960, tile_height = 640;
+        std::vector<media::frame> frames(col * row);
+        std::vector<media::frame_compositor::tile> tiles;
+        for (auto index = 0; index < col * row; ++index) {
+            auto& frame = frames[index];
+            frame->format = AV_PIX_FMT_YUV420P;
+            frame->width = tile_width;
+            frame->height = tile_height;
+            ASSERT_EQ(av_frame_get_buffer(core::get_pointer(frame), 0), 0);
+            for (auto planar = 0; planar < 3; ++planar) {
+                std::fill_n(frame->data[planar],
+                            frame->linesize[planar] * media::frame_compositor::planar_stretch(planar, tile_height),
+                            static_cast<uint8_t>(index * 16 + planar));
+            }
+            tiles.push_back({ &frame, index % col * tile_width, index / col * tile_height });
+        }
+        // discarded tile leaves its region untouched
+        tiles.push_back({ nullptr, 0, 0 });
+        auto pixel = [](const media::frame_compositor& compositor, size_t planar, int x, int y) {
+            const auto stretch = [planar](int offset) {
+                return media::frame_compositor::planar_stretch(planar, offset);
+            };
+            return compositor.data(planar)[stretch(y) * compositor.linesize(planar) + stretch(x)];
+        };
+        for (auto band_count : { 1u, 2u, 4u, 8u }) {
+            media::frame_compositor compositor{ col * tile_width, row * tile_height, band_count };
+            folly::stop_watch<microseconds> watch;
+            for (auto iteration = 0; iteration < 100; ++iteration) {
+                compositor.compose(tiles);
+            }
+            fmt::print("band {} compose {} us\n", compositor.band_count(), watch.elapsed().count() / 100);
+            for (auto index = 0; index < col * row; ++index) {
+                const auto x = index % col * tile_width + tile_width - 2;
+                const auto y = index / col * tile_height + tile_height - 2;
+                for (size_t planar = 0; planar < 3; ++planar) {
+                    EXPECT_EQ(pixel(compositor, planar, x, y), index * 16 + planar);
+                }
+            }
+        }
+    }
+
+    TEST(PlaneKernel, ConvertRoundTrip) {
+        constexpr auto width = 77, height = 9;
+        constexpr auto source_stride = 160, target_stride = 131;
+        std::vector<uint8_t> uv(source_stride * height);
+        std::iota(uv.begin(), uv.end(), uint8_t{ 0 });
+        const auto detected = media::kernel::detect();
+        for (auto target = media::kernel::isa::scalar; target <= detected;
+             target = static_cast<media::kernel::isa>(static_cast<int>(target) + 1)) {
+            EXPECT_EQ(media::kernel::activate(target), target);
+            std::vector<uint8_t> u(target_stride * height), v(target_stride * height);
+            media::kernel::nv12_to_i420(uv.data(), source_stride, u.data(), target_stride,
+                                        v.data(), target_stride, width, height);
+            for (auto y = 0; y < height; ++y) {
+                for (auto x = 0; x < width; ++x) {
+                    EXPECT_EQ(u[y * target_stride + x], uv[y * source_stride + 2 * x]);
+                    EXPECT_EQ(v[y * target_stride + x], uv[y * source_stride + 2 * x + 1]);
+                }
+            }
+            std::vector<uint8_t> merged(source_stride * height);
+            media::kernel::i420_to_nv12(u.data(), target_stride, v.data(), target_stride,
+                                        merged.data(), source_stride, width, height);
+            for (auto y = 0; y < height; ++y) {
+                EXPECT_TRUE(std::equal(merged.begin() + y * source_stride,
+                                       merged.begin() + y * source_stride + 2 * width,
+                                       uv.begin() + y * source_stride));
+            }
+            std::vector<uint8_t> padded(target_stride * height);
+            media::kernel::copy_plane_padded(padded.data(), target_stride, uv.data(), source_stride,
+                                             width, height);
+            for (auto y = 0; y < height; ++y) {
+                EXPECT_TRUE(std::equal(padded.begin() + y * target_stride,
+                                       padded.begin() + y * target_stride + width,
+                                       uv.begin() + y * source_stride));
+                EXPECT_EQ(padded[y * target_stride + target_stride - 1], uv[y * source_stride + width - 1]);
+            }
+            XLOG(INFO) << "isa " << media::kernel::name(target) << " round trip verified";
+        }
+        media::kernel::activate(detected);
+    }
+
+    TEST(PlaneKernel, CopyProfile) {
+        const auto detected = media::kernel::detect();
+        for (auto [width, height] : { std::pair{ 960, 640 }, std::pair{ 1920, 1080 }, std::pair{ 3840, 1920 } }) {
+            // decoder style linesize, padded beyond width
+            const auto stride = (width + 63) / 64 * 64 + 64;
+            std::vector<uint8_t> source(stride * height, 1), target(stride * height);
+            folly::stop_watch<microseconds> watch;
+            for (auto iteration = 0; iteration < 20; ++iteration) {
+                for (auto y = 0; y < height; ++y) {
+                    std::copy_n(source.data() + y * stride, width, target.data() + y * stride);
+                }
+            }
+            fmt::print("plane {}x{} copy_n {} us\n", width, height, watch.elapsed().count() / 20);
+            for (auto target_isa = media::kernel::isa::scalar; target_isa <= detected;
+                 target_isa = static_cast<media::kernel::isa>(static_cast<int>(target_isa) + 1)) {
+                media::kernel::activate(target_isa);
+                watch.reset();
+                for (auto iteration = 0; iteration < 20; ++iteration) {
+                    media::kernel::copy_plane(target.data(), stride, source.data(), stride, width, height);
+                }
+                fmt::print("plane {}x{} {} {} us\n", width, height,
+                           media::kernel::name(target_isa), watch.elapsed().count() / 20);
+            }
+        }
+        media::kernel::activate(detected);
+        EXPECT_EQ(media::kernel::active(), detected);
+    }
+}
+
+struct counting_cursor final : media::io_base
+{
+    std::unique_ptr<media::io_base> cursor;
+    int64_t read_count = 0;
+    int64_t seek_count = 0;
+
+    explicit counting_cursor(std::unique_ptr<media::io_base> cursor)
+        : cursor(std::move(cursor)) {}
+
+    int read(uint8_t* buffer, int size) override {
+        ++read_count;
+        return cursor->read(buffer, size);
+    }
+
+    int write(uint8_t* buffer, int size) override {
+        return cursor->write(buffer, size);
+    }
+
+    int64_t seek(int64_t offset, int whence) override {
+        ++seek_count;
+        return cursor->seek(offset, whence);
+    }
+
+    bool readable() const override { return cursor->readable(); }
+    bool seekable() const override { return cursor->seekable(); }
+    bool sizable() const override { return cursor->sizable(); }
+    bool available() const override { return cursor->available(); }
+    int64_t consume_size() const override { return cursor->consume_size(); }
+    int64_t remain_size() const override { return cursor->remain_size(); }
+};
+
+namespace media::test
+{
+    TEST(IoContext, PagePolicyProfile) {
+        using page_policy = media::io_context::page_policy;
+        auto& buffer_map = create_buffer_map();
+        const std::vector<std::tuple<std::string, bool, page_policy>> policies{
+            { "fixed", false, page_policy::fixed },
+            { "direct", true, page_policy::fixed },
+            { "adaptive", false, page_policy::adaptive },
+            { "staging", false, page_policy::staging },
+        };
+        for (auto& [name, direct, policy] : policies) {
+            auto read_count = 0i64;
+            auto seek_count = 0i64;
+            auto packet_count = 0i64;
+            folly::stop_watch<microseconds> watch;
+            for (auto index = 1; index <= 10; ++index) {
+                auto cursor = std::make_unique<counting_cursor>(
+                    media::buffer_list_cursor::create(core::split_buffer_sequence(buffer_map[0], buffer_map[index])));
+                auto& counter = *cursor;
+                media::io_context io_context{ std::move(cursor), direct, policy };
+                media::format_context format_context{ io_context, media::source::format{} };
+                while (!format_context.read(media::type::video).empty()) {
+                    ++packet_count;
+                }
+                read_count += counter.read_count;
+                seek_count += counter.seek_count;
+            }
+            const auto segment_time = watch.elapsed().count() / 10;
+            fmt::print("{}: read {} seek {} packet {} per segment {} us\n",
+                       name, read_count / 10, seek_count / 10, packet_count / 10, segment_time);
+            EXPECT_EQ(packet_count, 250);
+        }
+    }
+}
+
+namespace media::test
+{
+    TEST(FormatContext, FastOpenProfile) {
+        std::vector<std::pair<multi_buffer, multi_buffer>> tile_buffers;
+        for (auto row = 0; row < 5; ++row) {
+            for (auto col = 0; col < 6; ++col) {
+                tile_buffers.emplace_back(tile_segment_buffer(col, row, 22, "init"),
+                                          tile_segment_buffer(col, row, 22, "1"));
+            }
+        }
+        const auto tile_count = folly::to<int64_t>(tile_buffers.size());
+        // what demuxer reports for a tile, fast open must reproduce it without probing
+        struct tile_probe final
+        {
+            std::pair<int, int> scale;
+            AVCodecID codec_id = AV_CODEC_ID_NONE;
+            std::basic_string<uint8_t> extradata;
+            int64_t packet_count = 0;
+
+            bool operator==(const tile_probe& that) const {
+                return std::tie(scale, codec_id, extradata, packet_count)
+                    == std::tie(that.scale, that.codec_id, that.extradata, that.packet_count);
+            }
+        };
+        const auto probe_tile = [](media::format_context& format_context) {
+            const auto stream = format_context.demux(media::type::video);
+            const AVCodecParameters& params = stream.params();
+            tile_probe probe{ stream.scale(), params.codec_id };
+            if (params.extradata != nullptr) {
+                probe.extradata.assign(params.extradata, folly::to<size_t>(params.extradata_size));
+            }
+            while (!format_context.read(media::type::video).empty()) {
+                probe.packet_count++;
+            }
+            return probe;
+        };
+        std::vector<tile_probe> probes;
+        folly::stop_watch<microseconds> watch;
+        for (auto& [initial, segment] : tile_buffers) {
+            media::io_context io_context{
+                media::buffer_list_cursor::create(core::split_buffer_sequence(initial, segment))
+            };
+            media::format_context format_context{ io_context, media::source::format{} };
+            probes.push_back(probe_tile(format_context));
+        }
+        const auto probe_time = watch.lap();
+        std::vector<media::codec_parameters> parameters_list;
+        for (auto& [initial, segment] : tile_buffers) {
+            media::io_context io_context{ media::buffer_list_cursor::create(initial) };
+            media::format_context format_context{ io_context, media::source::format{} };
+            parameters_list.emplace_back(format_context.demux(media::type::video).params());
+        }
+        const auto parse_time = watch.lap();
+        auto index = 0;
+        for (auto& [initial, segment] : tile_buffers) {
+            media::io_context io_context{
+                media::buffer_list_cursor::create(core::split_buffer_sequence(initial, segment))
+            };
+            media::format_context format_context{
+                io_context, media::source::format{}, parameters_list.at(index)
+            };
+            const auto probe = probe_tile(format_context);
+            EXPECT_GT(probe.packet_count, 0);
+            EXPECT_TRUE(probe == probes.at(index));
+            index++;
+        }
+        const auto fast_time = watch.lap();
+        // timings are reported only, they vary with machine load
+        fmt::print("tile {}: probe open {} us, init parse {} us, fast open {} us\n",
+                   tile_count, probe_time.count() / tile_count,
+                   parse_time.count() / tile_count, fast_time.count() / tile_count);
+    }
+}
+
 auto create_buffer_from_path = [](std::string path) {
     EXPECT_TRUE(std::filesystem::is_regular_file(path));
     multi_buffer buffer;
@@ -221,10 +757,10 @@ namespace media::test
 }
 
 using frame_consumer = folly::Function<bool()>;
-using frame_builder = folly::Function<frame_consumer(std::list<const_buffer>)>;
+using frame_builder = folly::Function<frame_consumer(core::buffer_vector)>;
 
 frame_builder create_frame_builder() {
-    return [](std::list<const_buffer> buffer_list) -> frame_consumer {
+    return [](core::buffer_vector buffer_list) -> frame_consumer {
         auto segmentor = folly::makeMoveWrapper(
             media::frame_segmentor{ std::move(buffer_list), 4 });
         return [segmentor]() mutable {
@@ -247,7 +783,7 @@ folly::Future<bool> async_consume(media::frame_segmentor& segmentor,
 }
 
 frame_builder create_async_frame_builder(media::pixel_consume& consume) {
-    return [&consume](std::list<const_buffer> buffer_list) -> frame_consumer {
+    return [&consume](core::buffer_vector buffer_list) -> frame_consumer {
         auto segmentor = folly::makeMoveWrapper(
             media::frame_segmentor{ std::move(buffer_list), 4 });
         auto decode = folly::makeMoveWrapper(async_consume(*segmentor, consume, true));
@@ -530,12 +1066,8 @@ namespace media::test
             EXPECT_GT(wcrop, 0);
             EXPECT_GT(hcrop, 0);
             command_environment(output_directory, crop);
-            for (const auto qp : qp_list) {
-                media::command::crop_scale_package(input, qp);
-            }
+            auto mpd_path = media::command::package_qp_ladder(input, qp_list, duration);
             command_environment(output_directory / input.stem(), crop);
-            media::command::dash_segment(duration);
-            auto mpd_path = media::command::merge_dash_mpd();
             const auto target_directory = copy_directory / input.stem() / fmt::format("{}x{}", wcrop, hcrop);
             create_directories(target_directory);
             copy_file(mpd_path, target_directory / mpd_path.filename(),
@@ -589,6 +1121,78 @@ namespace media::test
         media::command::crop_scale_package("F:/Gpac/NewYork.mp4", 22);
     }
 
+    TEST(Command, CropScalePackageLadder) {
+        command_environment("F:/Debug", { 6, 5 });
+        const std::vector<int> qp_ladder{ 22, 27, 32, 37, 42 };
+        folly::stop_watch<milliseconds> watch;
+        const auto mpd_path = media::command::package_qp_ladder("F:/Gpac/NewYork.mp4", qp_ladder, 1000ms);
+        fmt::print("package ladder {} tiles {} ms\n", 6 * 5 * qp_ladder.size(), watch.elapsed().count());
+        EXPECT_TRUE(std::filesystem::is_regular_file(mpd_path));
+        for (const auto qp : qp_ladder) {
+            const auto mp4_directory = std::filesystem::path{ "F:/Debug/NewYork" } / fmt::format("6x5_qp{}", qp) / "mp4";
+            for (auto row = 0; row < 5; ++row) {
+                for (auto col = 0; col < 6; ++col) {
+                    EXPECT_TRUE(std::filesystem::is_regular_file(
+                        mp4_directory / fmt::format("NewYork_c{}r{}_qp{}.mp4", col, row, qp)));
+                }
+            }
+        }
+    }
+
+    TEST(Command, PackageRateLadder) {
+        command_environment("F:/Output/", { 5, 4 });
+        for (auto pass = 0; pass < 2; ++pass) {
+            // second pass finds every output fresh in manifest and runs no command
+            folly::stop_watch<milliseconds> watch;
+            const auto mpd_path = media::command::package_rate_ladder(
+                "F:/Gpac/NewYork.mp4", { { 3000, 60 }, { 2000, 60 }, { 1000, 60 } }, 1000ms);
+            fmt::print("pass {} ladder {} ms\n", pass, watch.elapsed().count());
+            EXPECT_TRUE(std::filesystem::is_regular_file(mpd_path));
+        }
+    }
+
+    TEST(Command, ManifestFresh) {
+        const auto directory = std::filesystem::temp_directory_path() / "command_manifest_test";
+        std::filesystem::remove_all(directory);
+        create_directories(directory);
+        const auto input = directory / "tile.264";
+        const auto output = directory / "tile.mp4";
+        std::ofstream{ input } << "h264";
+        std::ofstream{ output } << "mp4";
+        auto& manifest = media::command_manifest::of(directory);
+        EXPECT_FALSE(manifest.fresh(output, { input }, "mp4box -add"));
+        manifest.record(output, { input }, "mp4box -add");
+        EXPECT_TRUE(manifest.fresh(output, { input }, "mp4box -add"));
+        EXPECT_FALSE(manifest.fresh(output, { input }, "mp4box -add -fps 60"));
+        // reloaded from disk as a rerun would
+        const media::command_manifest reloaded{ manifest.path() };
+        EXPECT_TRUE(reloaded.fresh(output, { input }, "mp4box -add"));
+        std::ofstream{ input, std::ios::app } << "changed";
+        EXPECT_FALSE(reloaded.fresh(output, { input }, "mp4box -add"));
+        std::filesystem::remove(output);
+        EXPECT_FALSE(manifest.fresh(output, { input }, "mp4box -add"));
+    }
+
+    TEST(Command, ManifestProductRemoved) {
+        const auto directory = std::filesystem::temp_directory_path() / "command_manifest_product_test";
+        std::filesystem::remove_all(directory);
+        create_directories(directory);
+        const auto input = directory / "tile.mp4";
+        const auto output = directory / "tile.mpd";
+        const auto segment = directory / "tile_dash1.m4s";
+        std::ofstream{ input } << "mp4";
+        std::ofstream{ output } << "mpd";
+        std::ofstream{ segment } << "m4s";
+        auto& manifest = media::command_manifest::of(directory);
+        manifest.record(output, { input }, "mp4box -dash", { directory / "tile_dashinit.mp4", segment });
+        // init segment was listed but never written
+        EXPECT_FALSE(manifest.fresh(output, { input }, "mp4box -dash"));
+        manifest.record(output, { input }, "mp4box -dash", { segment });
+        EXPECT_TRUE(manifest.fresh(output, { input }, "mp4box -dash"));
+        std::filesystem::remove(segment);
+        EXPECT_FALSE(manifest.fresh(output, { input }, "mp4box -dash"));
+    }
+
     TEST(Command, SegmentDash) {
         media::command::dash_segment("F:/Debug/NewYork_c1r0_qp22.mp4", 1000ms);
     }
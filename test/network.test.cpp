@@ -1,8 +1,25 @@
 #include "pch.h"
 #include <fmt/format.h>
 #include <re2/re2.h>
+#include "network/acceptor.h"
+#include "network/byte.range.h"
+#include "network/connector.h"
 #include "network/dash.manager.h"
 #include "network/net.h"
+#include "server/app.h"
+#include "server/server.hpp"
+#include <boost/asio/connect.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/read_until.hpp>
+#include <boost/asio/streambuf.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/beast/core/buffers_to_string.hpp>
+#include <folly/executors/InlineExecutor.h>
+#include <future>
+#include <list>
+#include <mutex>
+#include <numeric>
+#include <random>
 
 namespace net::test
 {
@@ -19,6 +36,742 @@ namespace net::test
         }
     }
 
+    TEST(DashManager, PrefetchWindowProfile) {
+        core::set_cpu_executor(3);
+        auto stream_time = [](unsigned window) {
+            auto manager = dash_manager{ "http://localhost:33666/Output/NewYork/5x3/NewYork.mpd" }.request_stream_index().get();
+            manager.prefetch_by(window, 64 * 1024 * 1024);
+            auto tile_streamer = manager.tile_streamer({ 0, 0 });
+            folly::stop_watch<std::chrono::milliseconds> watch;
+            auto segment_count = 0;
+            auto peak_buffered_size = int64_t{ 0 };
+            try {
+                while (segment_count < 20) {
+                    auto buffer_sequence = tile_streamer().get();
+                    EXPECT_GT(buffer_sequence.data.size(), 0);
+                    EXPECT_LE(manager.buffered_size(), 64 * 1024 * 1024 + window * buffer_sequence.data.size());
+                    if (window == 1) {
+                        // taken segment is released and nothing is requested ahead
+                        EXPECT_EQ(manager.buffered_size(), 0);
+                    }
+                    peak_buffered_size = std::max(peak_buffered_size, manager.buffered_size());
+                    std::this_thread::sleep_for(std::chrono::milliseconds{ 30 }); // decode
+                    segment_count++;
+                }
+            } catch (core::stream_drained_error) {}
+            EXPECT_GT(segment_count, 1);
+            fmt::print("window {} segment {} peak buffered {} time {} ms\n",
+                       window, segment_count, peak_buffered_size, watch.elapsed().count());
+            return peak_buffered_size;
+        };
+        EXPECT_EQ(stream_time(1), 0);
+        // segments requested ahead stay charged while consumer decodes
+        EXPECT_GT(stream_time(4), 0);
+    }
+
+    // relays every accepted connection to server, drop shuts down connections relayed so far
+    struct connection_relay final
+    {
+        using tcp = boost::asio::ip::tcp;
+
+        boost::asio::io_context context;
+        tcp::acceptor acceptor{ context, tcp::endpoint{ boost::asio::ip::address_v4::loopback(), 0 } };
+        std::mutex mutex;
+        std::list<std::pair<tcp::socket, tcp::socket>> connections;
+        std::vector<std::thread> relay_threads;
+        std::atomic<bool> stopping{ false };
+        std::thread accept_thread;
+
+        explicit connection_relay(uint16_t server_port)
+            : accept_thread{ [this, server_port] {
+                while (true) {
+                    tcp::socket client{ context };
+                    boost::system::error_code errc;
+                    acceptor.accept(client, errc);
+                    if (errc || stopping) {
+                        break;
+                    }
+                    std::lock_guard<std::mutex> lock{ mutex };
+                    auto& [accepted, server] = connections.emplace_back(std::move(client), tcp::socket{ context });
+                    server.connect({ boost::asio::ip::address_v4::loopback(), server_port }, errc);
+                    relay_threads.emplace_back(relay, std::ref(accepted), std::ref(server));
+                    relay_threads.emplace_back(relay, std::ref(server), std::ref(accepted));
+                }
+            } } {}
+
+        ~connection_relay() {
+            stopping = true;
+            tcp::socket wakeup{ context };
+            boost::system::error_code errc;
+            wakeup.connect(acceptor.local_endpoint(), errc);
+            accept_thread.join();
+            drop();
+            for (auto& relay_thread : relay_threads) {
+                relay_thread.join();
+            }
+        }
+
+        static void relay(tcp::socket& from, tcp::socket& to) {
+            std::array<char, 64 * 1024> buffer;
+            boost::system::error_code errc;
+            while (true) {
+                const auto size = from.read_some(boost::asio::buffer(buffer), errc);
+                if (errc) {
+                    break;
+                }
+                if (boost::asio::write(to, boost::asio::buffer(buffer, size), errc); errc) {
+                    break;
+                }
+            }
+            to.shutdown(tcp::socket::shutdown_send, errc);
+        }
+
+        uint16_t port() const {
+            return acceptor.local_endpoint().port();
+        }
+
+        void drop() {
+            std::lock_guard<std::mutex> lock{ mutex };
+            boost::system::error_code errc;
+            for (auto& [accepted, server] : connections) {
+                accepted.shutdown(tcp::socket::shutdown_both, errc);
+                server.shutdown(tcp::socket::shutdown_both, errc);
+            }
+        }
+    };
+
+    TEST(DashManager, ConnectionPoolProfile) {
+        core::set_cpu_executor(3);
+        app::server server{ 0, net::config_entry<std::string>("net.server.directories.root"), 1 };
+        std::thread server_thread{
+            [&server] {
+                server.establish_sessions(core::make_pool_executor(1, "ServerTest"));
+            }
+        };
+        const auto mpd_url = fmt::format("http://127.0.0.1:{}/Output/NewYork/5x3/NewYork.mpd", server.listen_port());
+        auto stream_time = [&server, &mpd_url](unsigned max_connections) {
+            const auto accept_count = server.accept_count();
+            auto manager = dash_manager{ mpd_url }.request_stream_index().get();
+            manager.connect_by(max_connections);
+            std::vector<folly::Function<folly::SemiFuture<buffer_sequence>()>> tile_streamers;
+            for (auto row = 0; row < manager.grid_size().row; ++row) {
+                for (auto col = 0; col < manager.grid_size().col; ++col) {
+                    tile_streamers.push_back(manager.tile_streamer({ col, row }));
+                }
+            }
+            folly::stop_watch<std::chrono::milliseconds> watch;
+            std::vector<folly::SemiFuture<buffer_sequence>> segments;
+            for (auto index = 0; index < 5; ++index) {
+                for (auto& tile_streamer : tile_streamers) {
+                    segments.push_back(tile_streamer());
+                }
+            }
+            auto segment_count = 0;
+            for (auto& segment : folly::collectAllSemiFuture(segments).get()) {
+                EXPECT_GT(segment.value().data.size(), 0);
+                segment_count++;
+            }
+            EXPECT_EQ(segment_count, 5 * manager.grid_size().col * manager.grid_size().row);
+            // index connection plus the pool, every tile request rides a pooled connection
+            EXPECT_EQ(server.accept_count() - accept_count, int64_t{ max_connections } + 1);
+            fmt::print("connection {} tile {} time {} ms\n",
+                       max_connections, tile_streamers.size(), watch.elapsed().count());
+        };
+        stream_time(15);
+        stream_time(4);
+        // one shared connection, a failed request or a dropped connection must not take
+        // down requests of other tiles
+        connection_relay relay{ server.listen_port() };
+        auto manager = dash_manager{
+            fmt::format("http://127.0.0.1:{}/Output/NewYork/5x3/NewYork.mpd", relay.port())
+        }.request_stream_index().get();
+        manager.connect_by(1);
+        auto drained_streamer = manager.tile_streamer({ 0, 0 });
+        auto other_streamer = manager.tile_streamer({ 1, 0 });
+        auto drained_count = 0;
+        while (drained_streamer().getTry().hasValue()) {
+            ASSERT_LT(++drained_count, 1000);
+        }
+        EXPECT_GT(drained_count, 0);
+        EXPECT_GT(other_streamer().get().data.size(), 0);
+        relay.drop();
+        // request already assigned to the dropped connection may fail, next one reconnects
+        other_streamer().getTry();
+        EXPECT_GT(other_streamer().get().data.size(), 0);
+        EXPECT_GT(manager.tile_streamer({ 2, 0 })().get().data.size(), 0);
+        server.cancel();
+        server_thread.join();
+    }
+
+    auto segment_target = [](int index) {
+        return fmt::format("/dash/tile1-576p-5000kbps_dash{}.m4s", index);
+    };
+
+    // relays one connection, client to server direction is delayed to emulate request latency
+    auto delay_forward = [](boost::asio::io_context& context, uint16_t server_port,
+                            std::chrono::milliseconds delay) {
+        auto acceptor = std::make_shared<boost::asio::ip::tcp::acceptor>(
+            context, boost::asio::ip::tcp::endpoint{ boost::asio::ip::address_v4::loopback(), 0 });
+        const auto forward_port = acceptor->local_endpoint().port();
+        std::thread forward_thread{
+            [&context, acceptor, server_port, delay] {
+                boost::asio::ip::tcp::socket client{ context };
+                boost::asio::ip::tcp::socket server{ context };
+                acceptor->accept(client);
+                server.connect({ boost::asio::ip::address_v4::loopback(), server_port });
+                std::thread response_thread{
+                    [&] {
+                        std::array<char, 64 * 1024> buffer;
+                        boost::system::error_code errc;
+                        while (true) {
+                            const auto size = server.read_some(boost::asio::buffer(buffer), errc);
+                            if (errc) {
+                                break;
+                            }
+                            if (boost::asio::write(client, boost::asio::buffer(buffer, size), errc); errc) {
+                                break;
+                            }
+                        }
+                        client.shutdown(boost::asio::socket_base::shutdown_send, errc);
+                    }
+                };
+                std::array<char, 4 * 1024> buffer;
+                boost::system::error_code errc;
+                while (true) {
+                    const auto size = client.read_some(boost::asio::buffer(buffer), errc);
+                    if (errc) {
+                        break;
+                    }
+                    std::this_thread::sleep_for(delay);
+                    if (boost::asio::write(server, boost::asio::buffer(buffer, size), errc); errc) {
+                        break;
+                    }
+                }
+                server.shutdown(boost::asio::socket_base::shutdown_send, errc);
+                response_thread.join();
+            }
+        };
+        return std::make_pair(forward_port, std::move(forward_thread));
+    };
+
+    auto pipeline_request_time = [](uint16_t port, size_t depth, int count) {
+        auto io_context = net::make_asio_pool(2);
+        client::connector<protocal::tcp> connector{ *io_context };
+        auto session = connector.establish_session<protocal::http>("127.0.0.1", std::to_string(port)).get();
+        session->pipeline_by(depth);
+        folly::stop_watch<std::chrono::milliseconds> watch;
+        std::mutex order_mutex;
+        std::vector<int> complete_order;
+        std::vector<folly::Future<multi_buffer>> responses;
+        for (auto index = 1; index <= count; ++index) {
+            responses.push_back(session->send_request_for<multi_buffer>(
+                                           net::make_http_request<empty_body>("localhost", segment_target(index)))
+                                       .via(&folly::InlineExecutor::instance())
+                                       .thenValue([&order_mutex, &complete_order, index](multi_buffer&& buffer) {
+                                           std::lock_guard<std::mutex> lock{ order_mutex };
+                                           complete_order.push_back(index);
+                                           return std::move(buffer);
+                                       }));
+        }
+        const auto root = net::config_entry<std::string>("net.server.directories.root");
+        auto index = 0;
+        for (auto& response : folly::collectAllSemiFuture(responses).get()) {
+            EXPECT_EQ(response.value().size(), std::filesystem::file_size(root + segment_target(++index)));
+        }
+        // pipelined responses are read off one connection in request order
+        std::vector<int> request_order(count);
+        std::iota(request_order.begin(), request_order.end(), 1);
+        EXPECT_EQ(complete_order, request_order);
+        return watch.elapsed();
+    };
+
+    TEST(Acceptor, ReusePortShardProfile) {
+        if (!server::acceptor<boost::asio::ip::tcp>::reuse_port_supported) {
+            GTEST_SKIP() << "reuse port unsupported";
+        }
+        constexpr auto shard_count = 4;
+        constexpr auto connection_count = 512;
+        std::vector<std::shared_ptr<boost::asio::io_context>> contexts;
+        std::vector<std::unique_ptr<server::acceptor<boost::asio::ip::tcp>>> acceptors;
+        for (auto index = 0; index < shard_count; ++index) {
+            contexts.push_back(net::make_asio_pool(1));
+            acceptors.push_back(std::make_unique<server::acceptor<boost::asio::ip::tcp>>(
+                index == 0 ? 0 : acceptors.front()->listen_port(), *contexts.back(), false, true));
+        }
+        const auto port = acceptors.front()->listen_port();
+        std::array<std::atomic<int>, shard_count> accept_counts{};
+        std::atomic<int> accept_total{ 0 };
+        folly::Baton<> all_accepted;
+        std::function<void(int)> accept_next = [&](int index) {
+            acceptors[index]->accept_socket()
+                            .via(&folly::InlineExecutor::instance())
+                            .thenValue([&, index](boost::asio::ip::tcp::socket&& socket) {
+                                accept_counts[index].fetch_add(1);
+                                if (accept_total.fetch_add(1) + 1 == connection_count) {
+                                    all_accepted.post();
+                                }
+                                accept_next(index);
+                            });
+        };
+        for (auto index = 0; index < shard_count; ++index) {
+            boost::asio::post(*contexts[index], [&accept_next, index] {
+                accept_next(index);
+            });
+        }
+        folly::stop_watch<std::chrono::milliseconds> watch;
+        boost::asio::io_context client_context;
+        for (auto index = 0; index < connection_count; ++index) {
+            boost::asio::ip::tcp::socket socket{ client_context };
+            socket.connect({ boost::asio::ip::make_address("127.0.0.1"), port });
+        }
+        EXPECT_TRUE(all_accepted.try_wait_for(std::chrono::seconds{ 10 }));
+        const auto elapsed = watch.elapsed();
+        for (auto index = 0; index < shard_count; ++index) {
+            fmt::print("shard {} accept {}\n", index, accept_counts[index].load());
+            EXPECT_GT(accept_counts[index].load(), 0);
+        }
+        fmt::print("shards {} connections {} elapsed {} ms\n", shard_count, accept_total.load(), elapsed.count());
+        // aborted accept completes before the signal posted after close
+        for (auto index = 0; index < shard_count; ++index) {
+            std::promise<void> closed;
+            boost::asio::post(*contexts[index], [&, index] {
+                acceptors[index]->close();
+                boost::asio::post(*contexts[index], [&closed] {
+                    closed.set_value();
+                });
+            });
+            closed.get_future().wait();
+        }
+    }
+
+    auto wait_until = [](auto&& predicate, std::chrono::milliseconds timeout = 5s) {
+        folly::stop_watch<std::chrono::milliseconds> watch;
+        while (!predicate() && watch.elapsed() < timeout) {
+            std::this_thread::sleep_for(10ms);
+        }
+        return predicate();
+    };
+
+    TEST(Server, PauseAcceptAtMaxSessions) {
+        const auto directory = std::filesystem::temp_directory_path() / "server_shard_test";
+        create_directories(directory);
+        // one shard so pause check runs after every registered session
+        app::server server{ 0, directory.string(), 1, 2 };
+        std::thread server_thread{
+            [&server] {
+                server.establish_sessions(core::make_pool_executor(1, "ServerTest"));
+            }
+        };
+        boost::asio::io_context client_context;
+        const boost::asio::ip::tcp::endpoint endpoint{ boost::asio::ip::address_v4::loopback(), server.listen_port() };
+        std::list<boost::asio::ip::tcp::socket> clients;
+        for (auto index = 0; index < 3; ++index) {
+            clients.emplace_back(client_context).connect(endpoint);
+        }
+        EXPECT_TRUE(wait_until([&server] {
+            return server.active_count() == 2;
+        }));
+        // third connection waits in listen backlog while accept is paused
+        std::this_thread::sleep_for(100ms);
+        EXPECT_EQ(server.accept_count(), 2);
+        clients.front().close();
+        EXPECT_TRUE(wait_until([&server] {
+            return server.accept_count() == 3;
+        }));
+        EXPECT_TRUE(wait_until([&server] {
+            return server.active_count() == 2;
+        }));
+        clients.clear();
+        EXPECT_TRUE(wait_until([&server] {
+            return server.active_count() == 0;
+        }));
+        server.cancel();
+        server_thread.join();
+        EXPECT_EQ(server.accept_count(), 3);
+    }
+
+    TEST(ClientSession, PipelineRequest) {
+        const auto root = net::config_entry<std::string>("net.server.directories.root");
+        auto io_context = net::make_asio_pool(2);
+        server::acceptor<boost::asio::ip::tcp> acceptor{ 0, *io_context };
+        auto server_session = acceptor.listen_session<protocal::http>(root);
+        auto client_time = std::async(std::launch::async, pipeline_request_time, acceptor.listen_port(), 4, 10);
+        auto session = std::move(server_session).get();
+        auto completion = session->process_requests();
+        EXPECT_GT(client_time.get().count(), 0);
+        std::move(completion).get();
+    }
+
+    TEST(ClientSession, StreamResponse) {
+        const auto root = net::config_entry<std::string>("net.server.directories.root");
+        auto io_context = net::make_asio_pool(2);
+        server::acceptor<boost::asio::ip::tcp> acceptor{ 0, *io_context };
+        auto server_session = acceptor.listen_session<protocal::http>(root);
+        auto client_work = std::async(std::launch::async, [&root, port = acceptor.listen_port()] {
+            auto client_context = net::make_asio_pool(2);
+            client::connector<protocal::tcp> connector{ *client_context };
+            auto session = connector.establish_session<protocal::http>("127.0.0.1", std::to_string(port)).get();
+            session->pipeline_by(2);
+            // streamed and buffered responses interleave on one connection
+            auto first_stream = session->send_request_stream(
+                net::make_http_request<empty_body>("localhost", segment_target(1)));
+            auto buffered = session->send_request_for<multi_buffer>(
+                net::make_http_request<empty_body>("localhost", segment_target(2)));
+            auto second_stream = session->send_request_stream(
+                net::make_http_request<empty_body>("localhost", segment_target(3)));
+            auto read_stream = [&root](folly::SemiFuture<std::shared_ptr<core::chunk_stream>>&& future, int index) {
+                folly::stop_watch<std::chrono::microseconds> watch;
+                auto stream = std::move(future).get();
+                const auto header_time = watch.elapsed();
+                std::array<char, 8 * 1024> buffer;
+                int64_t read_size = 0;
+                auto read_count = 0;
+                while (const auto size = stream->read(boost::asio::buffer(buffer))) {
+                    read_size += size;
+                    read_count++;
+                }
+                EXPECT_TRUE(stream->closed());
+                EXPECT_EQ(read_size, std::filesystem::file_size(root + segment_target(index)));
+                EXPECT_EQ(stream->content_size().value_or(read_size), read_size);
+                fmt::print("stream {} size {} read {} header {} us complete {} us\n",
+                           index, read_size, read_count, header_time.count(), watch.elapsed().count());
+            };
+            read_stream(std::move(first_stream), 1);
+            EXPECT_EQ(std::move(buffered).get().size(), std::filesystem::file_size(root + segment_target(2)));
+            read_stream(std::move(second_stream), 3);
+        });
+        auto session = std::move(server_session).get();
+        auto completion = session->process_requests();
+        client_work.get();
+        std::move(completion).get();
+    }
+
+    TEST(ClientSession, StreamDropMidBody) {
+        constexpr auto partial_size = 1024;
+        boost::asio::io_context server_context;
+        boost::asio::ip::tcp::acceptor acceptor{
+            server_context, boost::asio::ip::tcp::endpoint{ boost::asio::ip::address_v4::loopback(), 0 }
+        };
+        // answers first request with part of its body then drops the connection
+        std::thread server_thread{
+            [&acceptor, &server_context] {
+                boost::asio::ip::tcp::socket socket{ server_context };
+                acceptor.accept(socket);
+                boost::asio::streambuf request;
+                boost::asio::read_until(socket, request, "\r\n\r\n");
+                const auto response = "HTTP/1.1 200 OK\r\nContent-Length: 65536\r\n\r\n"s
+                    + std::string(partial_size, 'x');
+                boost::asio::write(socket, boost::asio::buffer(response));
+                boost::system::error_code errc;
+                socket.shutdown(boost::asio::socket_base::shutdown_send, errc);
+                std::array<char, 1024> buffer;
+                while (!errc) {
+                    socket.read_some(boost::asio::buffer(buffer), errc);
+                }
+            }
+        };
+        auto io_context = net::make_asio_pool(2);
+        client::connector<protocal::tcp> connector{ *io_context };
+        auto session = connector.establish_session<protocal::http>(
+            "127.0.0.1", std::to_string(acceptor.local_endpoint().port())).get();
+        session->pipeline_by(2);
+        auto streamed = session->send_request_stream(
+            net::make_http_request<empty_body>("localhost", segment_target(1)));
+        auto buffered = session->send_request_for<multi_buffer>(
+            net::make_http_request<empty_body>("localhost", segment_target(2)));
+        auto stream = std::move(streamed).get();
+        int64_t read_size = 0;
+        auto read_stream = [&] {
+            std::array<char, 8 * 1024> buffer;
+            while (const auto size = stream->read(boost::asio::buffer(buffer))) {
+                read_size += size;
+            }
+        };
+        EXPECT_THROW(read_stream(), core::bad_response_error);
+        EXPECT_EQ(read_size, partial_size);
+        EXPECT_THROW(std::move(buffered).get(), core::bad_response_error);
+        server_thread.join();
+    }
+
+    TEST(ClientSession, PipelineLatencyProfile) {
+        constexpr auto delay = std::chrono::milliseconds{ 20 };
+        const auto root = net::config_entry<std::string>("net.server.directories.root");
+        auto io_context = net::make_asio_pool(2);
+        server::acceptor<boost::asio::ip::tcp> acceptor{ 0, *io_context };
+        auto profile = [&](size_t depth) {
+            auto server_session = acceptor.listen_session<protocal::http>(root);
+            auto [forward_port, forward_thread] = delay_forward(*io_context, acceptor.listen_port(), delay);
+            auto client_time = std::async(std::launch::async, pipeline_request_time, forward_port, depth, 10);
+            auto session = std::move(server_session).get();
+            auto completion = session->process_requests();
+            const auto time = client_time.get();
+            std::move(completion).get();
+            forward_thread.join();
+            fmt::print("pipeline depth {} delay {} ms time {} ms\n", depth, delay.count(), time.count());
+            return time;
+        };
+        // timings are reported only, order and sizes are checked by pipeline_request_time
+        profile(1);
+        profile(8);
+    }
+
+    TEST(SegmentCache, EvictAndInvalidate) {
+        const auto directory = std::filesystem::temp_directory_path() / "segment_cache_test";
+        std::filesystem::remove_all(directory);
+        std::filesystem::create_directories(directory);
+        const auto segment_path = [&directory](int index) {
+            return directory / fmt::format("tile1_dash{}.m4s", index);
+        };
+        for (auto index = 0; index < 3; ++index) {
+            std::ofstream{ segment_path(index), std::ios::binary } << std::string(100, 'a' + index);
+        }
+        server::segment_cache cache{ 250, 200, std::chrono::milliseconds{ 0 } };
+        const auto first = cache.find(segment_path(0));
+        ASSERT_NE(first, nullptr);
+        EXPECT_EQ(cache.find(segment_path(0)), first);
+        EXPECT_EQ(cache.hit_count(), 1);
+        cache.find(segment_path(1));
+        cache.find(segment_path(2));
+        EXPECT_EQ(cache.evict_count(), 1);
+        EXPECT_EQ(cache.size(), 200);
+        // evicted segment stays readable by responses still holding it
+        EXPECT_EQ(first->front(), 'a');
+        EXPECT_EQ(cache.find(directory / "missing.m4s"), nullptr);
+        // rewrite within one mtime tick is still told apart by size
+        const auto write_time = std::filesystem::last_write_time(segment_path(2));
+        std::ofstream{ segment_path(2), std::ios::binary } << std::string(120, 'z');
+        std::filesystem::last_write_time(segment_path(2), write_time);
+        const auto rewritten = cache.find(segment_path(2));
+        ASSERT_NE(rewritten, nullptr);
+        EXPECT_EQ(rewritten->size(), 120);
+        EXPECT_EQ(rewritten->front(), 'z');
+        // resident lookup serves cached segments only and never loads a cold one
+        EXPECT_EQ(cache.find_resident(segment_path(2)), rewritten);
+        EXPECT_EQ(cache.find_resident(segment_path(0)), nullptr);
+        EXPECT_EQ(cache.find(segment_path(2)), rewritten);
+    }
+
+    TEST(SegmentStore, MapAndFind) {
+        const auto directory = std::filesystem::temp_directory_path() / "segment_store_test";
+        std::filesystem::remove_all(directory);
+        std::filesystem::create_directories(directory / "Output");
+        std::ofstream{ directory / "Output" / "tile1_dash1.m4s", std::ios::binary } << std::string(100, 'a');
+        std::ofstream{ directory / "Output" / "tile1_dash2.m4s", std::ios::binary };
+        std::ofstream{ directory / "Output" / "tile1.yuv", std::ios::binary } << std::string(100, 'y');
+        auto store = std::make_shared<server::segment_store>(directory);
+        EXPECT_EQ(store->file_count(), 1);
+        EXPECT_EQ(store->size(), 100);
+        // looked up by the path session concatenates from request target
+        auto target = std::filesystem::path{ directory }.concat("/Output/tile1_dash1.m4s");
+        auto mapped = store->find(target);
+        ASSERT_NE(mapped.owner, nullptr);
+        EXPECT_EQ(mapped.data, std::string(100, 'a'));
+        EXPECT_EQ(store->find(directory / "Output" / "tile1.yuv").owner, nullptr);
+        EXPECT_EQ(store->find(directory / "Output" / "tile1_dash2.m4s").owner, nullptr);
+        EXPECT_EQ(store->hit_count(), 1);
+        EXPECT_EQ(store->miss_count(), 2);
+        // released store leaves responses in flight readable
+        store.reset();
+        EXPECT_EQ(mapped.data.front(), 'a');
+        fmt::print("mapped {} bytes\n", mapped.data.size());
+    }
+
+    // serves one session per client with session args, each client works on its own connection,
+    // returns client results in client order after every server session completes
+    auto serve_clients = [](int client_count, auto client_work, auto... session_args) {
+        using result_type = decltype(client_work(std::declval<client::session<protocal::http>&>(), 0));
+        auto io_context = net::make_asio_pool(4);
+        server::acceptor<boost::asio::ip::tcp> acceptor{ 0, *io_context };
+        std::vector<server::session_ptr<protocal::http>> sessions;
+        std::vector<folly::SemiFuture<folly::Unit>> completions;
+        std::thread accept_thread{
+            [&] {
+                for (auto index = 0; index < client_count; ++index) {
+                    sessions.push_back(acceptor.listen_session<protocal::http>(session_args...).get());
+                    completions.push_back(sessions.back()->process_requests());
+                }
+            }
+        };
+        std::vector<std::future<result_type>> clients;
+        for (auto index = 0; index < client_count; ++index) {
+            clients.push_back(std::async(std::launch::async, [&client_work, index, port = acceptor.listen_port()] {
+                auto client_context = net::make_asio_pool(1);
+                client::connector<protocal::tcp> connector{ *client_context };
+                auto session = connector.establish_session<protocal::http>("127.0.0.1", std::to_string(port)).get();
+                return client_work(*session, index);
+            }));
+        }
+        std::vector<result_type> results;
+        for (auto& client : clients) {
+            results.push_back(client.get());
+        }
+        accept_thread.join();
+        for (auto& completion : completions) {
+            std::move(completion).get();
+        }
+        return results;
+    };
+
+    TEST(ServerSession, SegmentCacheLoadProfile) {
+        constexpr auto client_count = 16;
+        constexpr auto request_count = 200;
+        const auto root = net::config_entry<std::string>("net.server.directories.root");
+        // tile request trace, a few segments of the shared viewport take most requests
+        std::vector<int> trace(request_count);
+        std::mt19937 engine{ 17 };
+        std::geometric_distribution<int> popularity{ 0.3 };
+        std::generate(trace.begin(), trace.end(), [&] {
+            return 1 + std::min(popularity(engine), 9);
+        });
+        auto profile = [&](std::shared_ptr<server::segment_cache> cache) {
+            folly::stop_watch<std::chrono::microseconds> watch;
+            const auto client_latencies = serve_clients(
+                client_count,
+                [&trace](client::session<protocal::http>& session, int index) {
+                    std::vector<std::chrono::microseconds> latencies;
+                    for (auto offset = 0; offset < request_count; ++offset) {
+                        folly::stop_watch<std::chrono::microseconds> request_watch;
+                        const auto target = segment_target(trace[(offset + index) % request_count]);
+                        const auto response = session.send_request_for<multi_buffer>(
+                            net::make_http_request<empty_body>("localhost", target)).get();
+                        latencies.push_back(request_watch.elapsed());
+                        EXPECT_GT(response.size(), 0);
+                    }
+                    return latencies;
+                },
+                root, cache);
+            const auto elapsed = watch.elapsed();
+            std::vector<std::chrono::microseconds> latencies;
+            for (auto& latency : client_latencies) {
+                latencies.insert(latencies.end(), latency.begin(), latency.end());
+            }
+            std::sort(latencies.begin(), latencies.end());
+            const auto p99 = latencies[latencies.size() * 99 / 100];
+            fmt::print("cache {} clients {} requests/s {:.0f} p99 {} us\n",
+                       cache != nullptr, client_count,
+                       latencies.size() * 1e6 / elapsed.count(), p99.count());
+            return p99;
+        };
+        profile(nullptr);
+        const auto cache = std::make_shared<server::segment_cache>();
+        profile(cache);
+        fmt::print("cache hit {} miss {} size {}\n", cache->hit_count(), cache->miss_count(), cache->size());
+        EXPECT_GT(cache->hit_count(), cache->miss_count());
+    }
+
+    TEST(ServerSession, ZeroCopyFileProfile) {
+        constexpr auto client_count = 4;
+        constexpr auto request_count = 20;
+        const auto directory = std::filesystem::temp_directory_path() / "zero_copy_test";
+        std::filesystem::remove_all(directory);
+        std::filesystem::create_directories(directory);
+        // 8k tile segment sized, larger than any cached one, byte pattern catches misplaced chunks
+        std::string segment(32 * 1024 * 1024, '\0');
+        for (size_t index = 0; index < segment.size(); ++index) {
+            segment[index] = static_cast<char>(index % 251);
+        }
+        std::ofstream{ directory / "tile1_dash1.m4s", std::ios::binary } << segment;
+        auto profile = [&](server::file_transfer transfer) {
+            folly::stop_watch<std::chrono::milliseconds> watch;
+            const auto intact_counts = serve_clients(
+                client_count,
+                [&segment](client::session<protocal::http>& session, int) {
+                    auto intact_count = 0;
+                    for (auto offset = 0; offset < request_count; ++offset) {
+                        const auto response = session.send_request_for<multi_buffer>(
+                            net::make_http_request<empty_body>("localhost", "/tile1_dash1.m4s")).get();
+                        intact_count += boost::beast::buffers_to_string(response.data()) == segment;
+                    }
+                    return intact_count;
+                },
+                directory.generic_string(), std::shared_ptr<server::segment_cache>{}, transfer);
+            const auto elapsed = watch.elapsed();
+            for (const auto intact_count : intact_counts) {
+                EXPECT_EQ(intact_count, request_count);
+            }
+            const auto throughput = client_count * request_count * segment.size() / 1e6
+                / std::chrono::duration<double>(elapsed).count();
+            fmt::print("zero copy {} clients {} throughput {:.0f} MB/s\n",
+                       transfer == server::file_transfer::zero_copy, client_count, throughput);
+            return elapsed;
+        };
+        const auto buffered_time = profile(server::file_transfer::buffered);
+        const auto zero_copy_time = profile(server::file_transfer::zero_copy);
+        XLOG(INFO) << "buffered " << buffered_time.count() << "ms zero copy " << zero_copy_time.count() << "ms";
+    }
+
+    TEST(ByteRange, Parse) {
+        const auto ranges = parse_byte_ranges("bytes=0-99, -100, 950-", 1000);
+        ASSERT_TRUE(ranges.has_value());
+        ASSERT_EQ(ranges->size(), 3);
+        EXPECT_EQ(content_range(ranges->at(0), 1000), "bytes 0-99/1000");
+        EXPECT_EQ(content_range(ranges->at(1), 1000), "bytes 900-999/1000");
+        EXPECT_EQ(content_range(ranges->at(2), 1000), "bytes 950-999/1000");
+        EXPECT_EQ(parse_byte_ranges("bytes=0-99999", 1000)->front().length, 1000);
+        EXPECT_FALSE(parse_byte_ranges("bytes=1000-", 1000).has_value());
+        EXPECT_FALSE(parse_byte_ranges("bytes=-0", 1000).has_value());
+        EXPECT_EQ(content_range(std::nullopt, 1000), "bytes */1000");
+        // invalid sets are ignored and whole representation is sent
+        EXPECT_TRUE(parse_byte_ranges("bytes=5-2", 1000)->empty());
+        EXPECT_TRUE(parse_byte_ranges("items=0-1", 1000)->empty());
+        EXPECT_TRUE(parse_byte_ranges("bytes=0-1,x", 1000)->empty());
+    }
+
+    TEST(ServerSession, RangeRequest) {
+        const auto directory = std::filesystem::temp_directory_path() / "range_request_test";
+        std::filesystem::remove_all(directory);
+        std::filesystem::create_directories(directory);
+        std::string segment(4096, '\0');
+        for (auto index = 0; index < segment.size(); ++index) {
+            segment[index] = static_cast<char>(index % 251);
+        }
+        std::ofstream{ directory / "tile1.mp4", std::ios::binary } << segment;
+        auto io_context = net::make_asio_pool(2);
+        server::acceptor<boost::asio::ip::tcp> acceptor{ 0, *io_context };
+        auto server_session = std::async(std::launch::async, [&] {
+            return acceptor.listen_session<protocal::http>(directory.generic_string()).get();
+        });
+        auto client_context = net::make_asio_pool(1);
+        client::connector<protocal::tcp> connector{ *client_context };
+        auto session = connector.establish_session<protocal::http>(
+            "127.0.0.1", std::to_string(acceptor.listen_port())).get();
+        auto completion = server_session.get()->process_requests();
+        auto range_request = [&session](std::string range) {
+            auto request = net::make_http_request<empty_body>("localhost", "/tile1.mp4");
+            request.set(boost::beast::http::field::range, range);
+            auto response = session->send_request(std::move(request)).get();
+            return std::make_pair(boost::beast::buffers_to_string(response.body().data()), std::move(response));
+        };
+        {
+            const auto [body, response] = range_request("bytes=100-199");
+            EXPECT_EQ(response.result(), boost::beast::http::status::partial_content);
+            EXPECT_EQ(response[boost::beast::http::field::content_range], "bytes 100-199/4096");
+            EXPECT_EQ(body, segment.substr(100, 100));
+        }
+        {
+            // sidx addressed subsegments fetched in one round trip
+            const auto [body, response] = range_request("bytes=0-9,-10");
+            EXPECT_EQ(response.result(), boost::beast::http::status::partial_content);
+            const auto content_type = std::string{ response[boost::beast::http::field::content_type] };
+            ASSERT_EQ(content_type.rfind("multipart/byteranges; boundary=", 0), 0);
+            const auto boundary = content_type.substr(content_type.find('=') + 1);
+            EXPECT_NE(body.find("Content-Type: video/mp4\r\nContent-Range: bytes 0-9/4096\r\n\r\n"
+                                + segment.substr(0, 10)), std::string::npos);
+            EXPECT_NE(body.find("Content-Type: video/mp4\r\nContent-Range: bytes 4086-4095/4096\r\n\r\n"
+                                + segment.substr(4086)), std::string::npos);
+            EXPECT_EQ(body.substr(body.size() - boundary.size() - 6), "--" + boundary + "--\r\n");
+        }
+        {
+            const auto [body, response] = range_request("bytes=5-2");
+            EXPECT_EQ(response.result(), boost::beast::http::status::ok);
+            EXPECT_EQ(response[boost::beast::http::field::accept_ranges], "bytes");
+            EXPECT_EQ(body, segment);
+        }
+        EXPECT_ANY_THROW(range_request("bytes=4096-"));
+        std::move(completion).get();
+        fmt::print("range requests served\n");
+    }
+
     TEST(DashManager, PathRegex) {
         auto path = "tile9-576p-1500kbps_dash$Number$.m4s"s;
         auto path_regex = [](std::string& path, auto index) {
@@ -29,7 +29,6 @@ namespace Assets.Gallery.Scripts
             public static float FrameUpdateExpectTime { get; set; } = 0f;
             public static float FrameUpdateElapsedTime { get; set; } = 0f;
             public static float FrameUpdateLastElapsedTime { get; set; } = 0f;
-            public static TileStream[] DecodePendingTileStreams { get; set; } = Enumerable.Empty<TileStream>().ToArray();
             public static int UpdatePendingCount { get; set; } = 0;
 
             private static readonly Tracer Trace = new Tracer();
@@ -147,37 +147,25 @@ namespace Assets.Gallery.Scripts
             {
                 try
                 {
-                    while (true)
+                    var updateResults = new int[tileStreamList.Count];
+                    while (!cancelToken.IsCancellationRequested)
                     {
-                        RenderState.DecodePendingTileStreams = tileStreamList.ToArray();
-                        while (RenderState.DecodePendingTileStreams.Any() && !cancelToken.IsCancellationRequested)
+                        // assembled frames are scheduled by timestamp, all tiles update together
+                        var updateCount = Native.Dash.PollClockUpdate(updateResults, updateResults.Length);
+                        if (updateCount < 0)
                         {
-                            var endOfStream = false;
-                            var readyTileStreams = RenderState.DecodePendingTileStreams
-                                .TakeWhile(
-                                    tileStream =>
-                                    {
-                                        var updateResult = Native.Dash.PollTilePtrUpdate(
-                                            tileStream.Instance, RenderState.FrameDecodeIndex,
-                                            RenderState.DecodeBatchIndex);
-                                        endOfStream |= (updateResult < 0);
-                                        return updateResult > 0;
-                                    })
-                                .ToArray();
-                            if (endOfStream)
-                            {
-                                Assert.AreEqual(0, readyTileStreams.Length);
-                                readyTileCollection.CompleteAdding();
-                                throw new RuntimeException("End of Stream");
-                            }
+                            readyTileCollection.CompleteAdding();
+                            throw new RuntimeException("End of Stream");
+                        }
 
-                            if (readyTileStreams.Length <= 0) continue;
-                            RenderState.DecodeBatchIndex++;
-                            readyTileCollection.Add(readyTileStreams, cancelToken);
-                            RenderState.DecodePendingTileStreams =
-                                RenderState.DecodePendingTileStreams.Except(readyTileStreams).ToArray();
+                        if (updateCount == 0)
+                        {
+                            Thread.Sleep(1);
+                            continue;
                         }
 
+                        RenderState.DecodeBatchIndex++;
+                        readyTileCollection.Add(tileStreamList.ToArray(), cancelToken);
                         RenderState.FrameDecodeIndex++;
                     }
                 }
@@ -64,6 +64,16 @@ namespace Assets.Gallery.Scripts
             [DllImport("gallery", EntryPoint = "_nativeDashTilePtrPollUpdate", CallingConvention = CallingConvention.StdCall)]
             internal static extern int PollTilePtrUpdate(IntPtr instance, long frameIndex, long batchIndex);
 
+            [DllImport("gallery", EntryPoint = "_nativeDashTilePtrPollUpdateBatch", CallingConvention = CallingConvention.StdCall)]
+            internal static extern int PollTilePtrUpdateBatch(IntPtr[] instances, [Out] int[] results, int count,
+                long frameIndex, long batchIndex);
+
+            [DllImport("gallery", EntryPoint = "_nativeDashFramePollUpdate", CallingConvention = CallingConvention.StdCall)]
+            internal static extern int PollFrameUpdate(long frameIndex, ref long assembledIndex);
+
+            [DllImport("gallery", EntryPoint = "_nativeDashClockPollUpdate", CallingConvention = CallingConvention.StdCall)]
+            internal static extern int PollClockUpdate([Out] int[] results, int count);
+
             [DllImport("gallery", EntryPoint = "_nativeDashCreateTileStream", CallingConvention = CallingConvention.StdCall)]
             internal static extern IntPtr CreateTileStream(int col, int row, int index,
                 IntPtr texY, IntPtr texU, IntPtr texV);